@@ -0,0 +1,200 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+#include "stats.h"
+
+using namespace std;
+
+// When Inventory hands its changes to the autosaver: once this many are
+// unsaved, or once the oldest unsaved one is interval old.
+struct AutosaveOptions {
+    size_t changes = 10000;
+    chrono::milliseconds interval{5000};
+};
+
+struct AutosaveStatus {
+    uint64_t saves = 0;
+    uint64_t failures = 0;
+    // Saves replaced by a newer one before the worker got to them.
+    uint64_t superseded = 0;
+    // Wall time of the last and the slowest save.
+    double lastSeconds = 0;
+    double maxSeconds = 0;
+    // From the oldest change a save covered until that save was on disk.
+    double lastLagSeconds = 0;
+    double maxLagSeconds = 0;
+    // Changes handed over but not on disk yet.
+    size_t pendingChanges = 0;
+    string lastError;
+};
+
+// Writes saves to one file on a background thread, via a temp file and
+// rename so the file is always a complete save. A save is a function that
+// writes the contents to a stream; Inventory passes one holding an
+// InventoryView, which it takes in O(1) (pages are copied only as the
+// inventory writes to them), so the foreground never waits for the disk.
+//
+// At most one save is in flight and one pending; a newer save replaces the
+// pending one. A pending save is written at its due time, or at once when
+// the autosaver stops.
+class Autosaver {
+public:
+    using Save = function<bool(ostream&)>;
+    using Clock = chrono::steady_clock;
+
+private:
+    string filename;
+    mutable mutex lock;
+    condition_variable wake;
+    bool stopping = false;
+    bool hasPending = false;
+    // hasPending or a save being written; read without the lock.
+    atomic<bool> working{false};
+    Save pending;
+    size_t pendingChanges = 0;
+    size_t writingChanges = 0;
+    Clock::time_point pendingOldest;
+    Clock::time_point pendingDue;
+    AutosaveStatus current;
+    thread worker;
+
+    bool write(const Save& save, string& error) {
+        OpTimer timer(StatOp::Autosave);
+        string temporary = filename + ".tmp";
+        ofstream file(temporary, ios::binary);
+        if (!file.is_open()) {
+            timer.miss();
+            error = "could not open " + temporary + ": " + strerror(errno);
+            return false;
+        }
+        bool ok = save(file);
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(file.tellp()))));
+        file.close();
+        if (!ok || !file) {
+            timer.miss();
+            error = "could not write " + temporary;
+            remove(temporary.c_str());
+            return false;
+        }
+        if (rename(temporary.c_str(), filename.c_str()) != 0) {
+            timer.miss();
+            error = "could not rename " + temporary + ": " + strerror(errno);
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void run() {
+        unique_lock<mutex> guard(lock);
+        while (hasPending || !stopping) {
+            if (!hasPending) {
+                wake.wait(guard);
+                continue;
+            }
+            if (!stopping && Clock::now() < pendingDue) {
+                wake.wait_until(guard, pendingDue);
+                continue;
+            }
+            Save save = move(pending);
+            pending = nullptr;
+            Clock::time_point oldest = pendingOldest;
+            hasPending = false;
+            writingChanges = pendingChanges;
+            pendingChanges = 0;
+            guard.unlock();
+
+            string error;
+            Clock::time_point start = Clock::now();
+            bool ok = write(save, error);
+            // Let go of what the save holds (a view's pages) before anything
+            // else, so the inventory stops copying them.
+            save = nullptr;
+            Clock::time_point end = Clock::now();
+
+            guard.lock();
+            writingChanges = 0;
+            if (ok) {
+                current.saves++;
+                current.lastSeconds = chrono::duration<double>(end - start).count();
+                current.maxSeconds = max(current.maxSeconds, current.lastSeconds);
+                current.lastLagSeconds = chrono::duration<double>(end - oldest).count();
+                current.maxLagSeconds = max(current.maxLagSeconds, current.lastLagSeconds);
+            } else {
+                current.failures++;
+                current.lastError = error;
+            }
+            if (!hasPending) working.store(false, memory_order_release);
+        }
+    }
+
+public:
+    explicit Autosaver(string filename) : filename(move(filename)) {
+        worker = thread([this] { run(); });
+    }
+
+    Autosaver(const Autosaver&) = delete;
+    Autosaver& operator=(const Autosaver&) = delete;
+
+    ~Autosaver() { stop(); }
+
+    // Writes whatever is pending, then stops the thread. status() still
+    // works afterwards; submit() does not.
+    void stop() {
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    const string& file() const { return filename; }
+
+    // Queues save, which holds changes made since oldest, to be written at
+    // due (or straight away if due has passed).
+    void submit(Save save, size_t changes, Clock::time_point oldest, Clock::time_point due) {
+        {
+            lock_guard<mutex> guard(lock);
+            if (hasPending) {
+                current.superseded++;
+                oldest = min(oldest, pendingOldest);
+                due = min(due, pendingDue);
+            }
+            pending = move(save);
+            pendingChanges += changes;
+            pendingOldest = oldest;
+            pendingDue = due;
+            hasPending = true;
+            working.store(true, memory_order_relaxed);
+        }
+        wake.notify_one();
+    }
+
+    // A save is pending or being written. Each submit takes a view the
+    // inventory then copies pages away from, so callers wait for this to
+    // clear rather than replace a pending save.
+    bool busy() const { return working.load(memory_order_acquire); }
+
+    AutosaveStatus status() const {
+        lock_guard<mutex> guard(lock);
+        AutosaveStatus s = current;
+        s.pendingChanges = pendingChanges + writingChanges;
+        return s;
+    }
+};
+
+#endif
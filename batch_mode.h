@@ -0,0 +1,405 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include "inventory.h"
+
+using namespace std;
+
+// streambuf over a file descriptor with one large buffer, flushed only when
+// full or on flush(). Replaces a flush per line with a write per megabyte.
+class OutputBuffer : public streambuf {
+private:
+    int fd;
+    vector<char> buffer;
+
+    bool drain() {
+        const char* p = pbase();
+        size_t left = size_t(pptr() - pbase());
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            left -= size_t(n);
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return true;
+    }
+
+protected:
+    int overflow(int c) override {
+        if (!drain()) return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *pptr() = char(c);
+            pbump(1);
+        }
+        return 0;
+    }
+
+    streamsize xsputn(const char* s, streamsize n) override {
+        if (n > epptr() - pptr()) {
+            if (!drain()) return 0;
+            if (n > epptr() - pptr()) {
+                // Larger than the whole buffer: write it straight through.
+                streamsize done = 0;
+                while (done < n) {
+                    ssize_t w = ::write(fd, s + done, size_t(n - done));
+                    if (w < 0) {
+                        if (errno == EINTR) continue;
+                        return done;
+                    }
+                    done += w;
+                }
+                return n;
+            }
+        }
+        memcpy(pptr(), s, size_t(n));
+        pbump(int(n));
+        return n;
+    }
+
+    int sync() override { return drain() ? 0 : -1; }
+
+public:
+    explicit OutputBuffer(int fd, size_t capacity = size_t(1) << 20) : fd(fd), buffer(capacity) {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    ~OutputBuffer() { drain(); }
+};
+
+// Runs one command per line, without prompts:
+//
+//   add <id>,<name>,<category>,<price>,<quantity>,<margin>
+//   update <id>,<name>,<category>,<price>,<quantity>,<margin>
+//   remove <id>
+//   adjust <id>,<delta>       adds delta (negative: sold) to the quantity
+//   setprice <id>,<price> | setmargin <id>,<margin>
+//   find <id>                 prints id,name,category,price,quantity,margin
+//   print | totals | categories | memory
+//   print <n>                 page n (from 1) of the print listing, 20 per page
+//   export <format> <file>    writes every product as csv, jsonl or text
+//   reconcile                 recomputes totals from scratch and shows the drift
+//   range <low>,<high>        lists products priced low..high
+//   top <n>                   lists the n products with the highest stock value
+//   percentiles               price and stock value percentiles
+//   category <name>           lists the products in one category
+//   reorder <id>,<threshold>  id is low stock while its quantity is below
+//                             threshold; -1 clears it
+//   reordercategory <name>,<threshold>
+//                             the same for every product in a category that
+//                             has no threshold of its own
+//   low [<n>]                 products below their threshold, furthest first
+//   query <query>             filters, groups and totals products, e.g.
+//                             query select category, count, avg(price)
+//                               where quantity < 10 group by category
+//                               order by count desc limit 5
+//                             (see Query for the whole syntax)
+//   search <text>             first 20 products whose names match text
+//   searchpage <n> <text>     page n (from 1) of the same results
+//   save <file> | load <file> | snapshot <file> | restore <file> | compact
+//   merge <sum|last|error> <file> <file>...
+//                             replaces the contents with the files merged by id
+//   diff <before> <after> [<report>]
+//                             lists products added, removed and changed from
+//                             file before to file after (- for the inventory
+//                             itself), or writes them as CSV to report
+//   stats                     per-operation latencies and counters so far
+//   stats <file>              writes the same as JSON
+//   autosave <file>           saves to file in the background from now on
+//   autosave                  how the autosaves are going
+//   history <id>              every recorded change of a product (--history)
+//   asof <time>               inventory totals as of time
+//   asof <time> <id>          a product's values as of time; time is
+//                             YYYY-MM-DD[THH:MM[:SS]], @<epoch seconds> or now
+//
+// With autosave on, due changes are handed over after each command.
+// Products crossing a reorder threshold are reported as it happens.
+//
+// Runs of adjust lines are gathered and applied together with
+// Inventory::applyMovements when the run ends or another command comes.
+//
+// Blank lines and lines starting with '#' are skipped. Inventory's own
+// messages go to out as usual; with quiet set, only errors and the output of
+// find/print/totals/categories/category/memory/reconcile/range/top/percentiles,
+// low, query, search, diff, stats, autosave, history and asof, and reorder alerts,
+// are written.
+class BatchRunner {
+private:
+    Inventory& inventory;
+    ostream& out;
+    bool quiet;
+    size_t commands = 0;
+    size_t failures = 0;
+    vector<StockMovement> movements;
+
+    void fail(size_t line, const char* message) {
+        failures++;
+        out << "Error on line " << line << ": " << message << '\n';
+    }
+
+    static bool parseId(const string& args, int& id) {
+        return parseIntField(args.data(), args.data() + args.size(), id);
+    }
+
+    void flushMovements() {
+        if (movements.empty()) return;
+        failures += movements.size() - inventory.applyMovements(movements);
+        movements.clear();
+    }
+
+    void run(size_t lineNumber, const string& command, const string& args) {
+        commands++;
+        if (command == "adjust") {
+            size_t comma = args.find(',');
+            StockMovement movement;
+            if (comma == string::npos || !parseIntField(args.data(), args.data() + comma, movement.id)
+                || !parseIntField(args.data() + comma + 1, args.data() + args.size(), movement.delta)) {
+                fail(lineNumber, "expected <id>,<delta>");
+                return;
+            }
+            movements.push_back(movement);
+            return;
+        }
+        flushMovements();
+        if (command == "add" || command == "update") {
+            CsvFields row;
+            if (!parseCsvLine(args.data(), args.data() + args.size(), row)) {
+                fail(lineNumber, "expected <id>,<name>,<category>,<price>,<quantity>,<margin>");
+                return;
+            }
+            // Inventory copies what it keeps, so the fields can view args.
+            string_view name(row.name, row.nameLength);
+            string_view category(row.category, row.categoryLength);
+            bool ok = command == "add"
+                ? inventory.addProduct(Product(row.id, name, category, row.price, row.quantity, row.margin))
+                : inventory.updateProduct(row.id, name, category, row.price, row.quantity, row.margin);
+            if (!ok) failures++;
+        } else if (command == "remove" || command == "find") {
+            int id;
+            if (!parseId(args, id)) {
+                fail(lineNumber, "expected a product id");
+                return;
+            }
+            if (command == "remove") {
+                if (!inventory.removeProduct(id)) failures++;
+                return;
+            }
+            bool found = inventory.findProduct(id, [this](const Product& p) {
+                out << p.getId() << ',' << p.getName() << ',' << p.getCategory() << ','
+                    << p.getPrice() << ',' << p.getQuantity() << ',' << p.getMargin() << '\n';
+            });
+            if (!found) out << "Product " << id << " not found.\n";
+        } else if (command == "setprice" || command == "setmargin") {
+            size_t comma = args.find(',');
+            int id;
+            double value;
+            if (comma == string::npos || !parseIntField(args.data(), args.data() + comma, id)
+                || !parseDoubleField(args.data() + comma + 1, args.data() + args.size(), value)) {
+                fail(lineNumber, command == "setprice" ? "expected <id>,<price>" : "expected <id>,<margin>");
+                return;
+            }
+            bool ok = command == "setprice" ? inventory.setPrice(id, value) : inventory.setMargin(id, value);
+            if (!ok) failures++;
+        } else if (command == "print") {
+            if (args.empty()) {
+                inventory.printProducts();
+                return;
+            }
+            int page;
+            if (!parseId(args, page) || page < 1) {
+                fail(lineNumber, "expected a page number");
+                return;
+            }
+            if (!inventory.printProductPage(size_t(page - 1))) failures++;
+        } else if (command == "export") {
+            size_t space = args.find_first_of(" \t");
+            ExportFormat format;
+            if (space == string::npos || !parseExportFormat(string_view(args).substr(0, space), format)) {
+                fail(lineNumber, "expected <csv|jsonl|text> <file>");
+                return;
+            }
+            if (!inventory.exportToFile(args.substr(args.find_first_not_of(" \t", space)), format)) failures++;
+        } else if (command == "totals") {
+            out << "Total Inventory Value: Rs." << inventory.getTotalRevenue() << '\n'
+                << "Estimated Profit: Rs." << inventory.getTotalProfit() << '\n';
+        } else if (command == "save" || command == "load" || command == "snapshot" || command == "restore") {
+            if (args.empty()) {
+                fail(lineNumber, "expected a file name");
+                return;
+            }
+            bool ok = command == "save" ? inventory.saveInventoryToFile(args)
+                : command == "load" ? inventory.loadInventoryFromFile(args)
+                : command == "snapshot" ? inventory.saveSnapshot(args)
+                : inventory.loadSnapshot(args);
+            if (!ok) failures++;
+        } else if (command == "categories") {
+            inventory.printCategoryReport();
+        } else if (command == "category") {
+            inventory.printCategory(args);
+        } else if (command == "range") {
+            size_t comma = args.find(',');
+            double low, high;
+            if (comma == string::npos || !parseDoubleField(args.data(), args.data() + comma, low)
+                || !parseDoubleField(args.data() + comma + 1, args.data() + args.size(), high)) {
+                fail(lineNumber, "expected <low>,<high>");
+                return;
+            }
+            inventory.printPriceRange(low, high);
+        } else if (command == "top") {
+            int n;
+            if (!parseId(args, n) || n < 0) {
+                fail(lineNumber, "expected a product count");
+                return;
+            }
+            inventory.printTopByValue(size_t(n));
+        } else if (command == "reorder" || command == "reordercategory") {
+            size_t comma = args.rfind(',');
+            int threshold;
+            if (comma == string::npos || !parseIntField(args.data() + comma + 1, args.data() + args.size(), threshold)) {
+                fail(lineNumber, command == "reorder" ? "expected <id>,<threshold>" : "expected <category>,<threshold>");
+                return;
+            }
+            if (command == "reordercategory") {
+                inventory.setCategoryReorderThreshold(args.substr(0, comma), threshold);
+                return;
+            }
+            int id;
+            if (!parseIntField(args.data(), args.data() + comma, id)) {
+                fail(lineNumber, "expected <id>,<threshold>");
+                return;
+            }
+            if (!inventory.setReorderThreshold(id, threshold)) failures++;
+        } else if (command == "low") {
+            int n = INT_MAX;
+            if (!args.empty() && (!parseId(args, n) || n < 0)) {
+                fail(lineNumber, "expected a product count");
+                return;
+            }
+            inventory.printLowStock(size_t(n));
+        } else if (command == "search") {
+            inventory.printNameSearch(args, 0);
+        } else if (command == "searchpage") {
+            size_t space = args.find_first_of(" \t");
+            int page;
+            if (space == string::npos || !parseIntField(args.data(), args.data() + space, page) || page < 1) {
+                fail(lineNumber, "expected <page> <text>");
+                return;
+            }
+            inventory.printNameSearch(string_view(args).substr(args.find_first_not_of(" \t", space)), size_t(page - 1));
+        } else if (command == "percentiles") {
+            inventory.printPercentiles();
+        } else if (command == "query") {
+            if (!inventory.runQuery(args)) failures++;
+        } else if (command == "reconcile") {
+            inventory.reconcileTotals();
+        } else if (command == "memory") {
+            inventory.printMemoryUsage();
+        } else if (command == "merge") {
+            vector<string> words;
+            for (size_t start = 0; (start = args.find_first_not_of(" \t", start)) != string::npos;) {
+                size_t end = args.find_first_of(" \t", start);
+                words.push_back(args.substr(start, end - start));
+                start = end;
+            }
+            MergePolicy policy;
+            if (words.size() < 2 || !parseMergePolicy(words[0], policy)) {
+                fail(lineNumber, "expected <sum|last|error> <file>...");
+                return;
+            }
+            words.erase(words.begin());
+            if (!inventory.mergeInventoryFiles(words, policy)) failures++;
+        } else if (command == "diff") {
+            vector<string> words;
+            for (size_t start = 0; (start = args.find_first_not_of(" \t", start)) != string::npos;) {
+                size_t end = args.find_first_of(" \t", start);
+                words.push_back(args.substr(start, end - start));
+                start = end;
+            }
+            if (words.size() < 2 || words.size() > 3 || words[1] == "-") {
+                fail(lineNumber, "expected <before|-> <after> [<report>]");
+                return;
+            }
+            if (!inventory.diffInventory(words[0] == "-" ? "" : words[0], words[1], words.size() > 2 ? words[2] : "")) {
+                failures++;
+            }
+        } else if (command == "stats") {
+            if (args.empty()) inventory.printStats();
+            else if (!inventory.writeStats(args)) failures++;
+        } else if (command == "history") {
+            int id;
+            if (!parseId(args, id)) {
+                fail(lineNumber, "expected a product id");
+                return;
+            }
+            if (!inventory.printProductHistory(id)) failures++;
+        } else if (command == "asof") {
+            // The time may itself hold a space, so the id is the last word
+            // only if it parses as one and what is left is a time.
+            size_t space = args.find_last_of(" \t");
+            int64_t time;
+            int id;
+            if (space != string::npos && parseIntField(args.data() + space + 1, args.data() + args.size(), id)
+                && parseHistoryTime(string_view(args).substr(0, args.find_last_not_of(" \t", space) + 1), time)) {
+                if (!inventory.printProductAsOf(id, time)) failures++;
+            } else if (parseHistoryTime(args, time)) {
+                if (!inventory.printTotalsAsOf(time)) failures++;
+            } else {
+                fail(lineNumber, "expected <time> [<id>]");
+            }
+        } else if (command == "autosave") {
+            if (args.empty()) inventory.printAutosaveStatus();
+            else if (!inventory.startAutosave(args)) failures++;
+        } else if (command == "compact") {
+            if (!inventory.compactLog()) fail(lineNumber, "no log is open");
+        } else {
+            commands--;
+            fail(lineNumber, "unknown command");
+        }
+    }
+
+public:
+    BatchRunner(Inventory& inventory, ostream& out, bool quiet)
+        : inventory(inventory), out(out), quiet(quiet) {}
+
+    size_t commandCount() const { return commands; }
+    size_t failureCount() const { return failures; }
+
+    void run(istream& in) {
+        inventory.setOutput(out);
+        inventory.setQuiet(quiet);
+        string line, command, args;
+        size_t lineNumber = 0;
+        while (getline(in, line)) {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == string::npos || line[start] == '#') continue;
+            size_t end = line.find_last_not_of(" \t\r");
+            size_t space = line.find_first_of(" \t", start);
+            if (space == string::npos || space > end) {
+                command.assign(line, start, end - start + 1);
+                args.clear();
+            } else {
+                command.assign(line, start, space - start);
+                size_t argStart = line.find_first_not_of(" \t", space);
+                args.assign(line, argStart, end - argStart + 1);
+            }
+            run(lineNumber, command, args);
+            inventory.pollAutosave();
+        }
+        flushMovements();
+        inventory.commitLog();
+        out.flush();
+    }
+};
+
+#endif
@@ -0,0 +1,626 @@
+// Inventory benchmark suite.
+//
+//   g++ -std=c++17 -O2 -o benchmark benchmark.cpp
+//   ./benchmark [--sizes=10000,1000000,10000000] [--backends=auto,dense,hash,ordered,vector,concurrent]
+//               [--dists=sequential,shuffled,sparse,clustered] [--threads=1,2,4,8,16]
+//               [--allocators=pool,default] [--cache-mb=64] [--seed=42] [--out=results.jsonl]
+//
+// Every measurement is written as one JSON object per line (to stdout unless
+// --out is given), so runs can be diffed between backends and commits. The
+// "vector" backend is the linear-scan Inventory from main.cpp and is only run
+// for sizes up to --vector-max because its add/find/remove are O(n). The forced
+// "dense" backend is skipped for the sparse distribution, where its slot table
+// would span the whole int range. The "concurrent" backend is ConcurrentInventory
+// under a 90% read / 10% update mix, once per --threads count (op "mixed_t<N>").
+// Only the "ordered" backend allocates index nodes, so it alone runs once per
+// --allocators entry; the rest use the pool. The "disk" backend, run only when
+// named in --backends, is DiskInventory with a --cache-mb page cache; its
+// "page_cache" lines give the cache's hit rate after each phase.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <thread>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "inventory.h"
+#include "concurrent_inventory.h"
+#include "disk_inventory.h"
+
+using namespace std;
+
+// Same algorithms as the Inventory in main.cpp, without the console output.
+class VectorInventory {
+private:
+    vector<Product> products;
+    // Products only view their strings; main.cpp's copies live here.
+    StringArena strings;
+
+public:
+    bool addProduct(Product product) {
+        for (auto& p : products) {
+            if (p.getId() == product.getId()) return false;
+        }
+        product.setName(strings.store(product.getName()));
+        product.setCategory(strings.store(product.getCategory()));
+        products.push_back(product);
+        return true;
+    }
+
+    Product* findProduct(int id) {
+        for (auto& product : products) {
+            if (product.getId() == id) return &product;
+        }
+        return nullptr;
+    }
+
+    bool removeProduct(int id) {
+        auto it = remove_if(products.begin(), products.end(),
+                            [id](Product& p) { return p.getId() == id; });
+        if (it == products.end()) return false;
+        products.erase(it, products.end());
+        return true;
+    }
+};
+
+class NullBuffer : public streambuf {
+protected:
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+    int overflow(int c) override { return c; }
+};
+
+struct Options {
+    vector<size_t> sizes = {10000, 1000000, 10000000};
+    vector<string> backends = {"auto", "dense", "hash", "ordered", "vector", "concurrent"};
+    vector<string> dists = {"sequential", "shuffled", "sparse", "clustered"};
+    vector<size_t> threads = {1, 2, 4, 8, 16};
+    vector<string> allocators = {"pool", "default"};
+    size_t vectorMax = 20000;
+    size_t cacheMb = 64;
+    unsigned long long seed = 42;
+    string out;
+};
+
+struct Run {
+    string backend;
+    string activeBackend;
+    string dist;
+    size_t n;
+    string allocator = "pool";
+};
+
+static vector<string> splitList(const string& value) {
+    vector<string> items;
+    stringstream ss(value);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Resets the kernel's peak-RSS watermark so each run reports its own peak.
+static void resetPeakRss() {
+    ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs.is_open()) clearRefs << "5";
+}
+
+static long peakRssKb() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return stol(line.substr(6));
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static vector<int> generateIds(const string& dist, size_t n, mt19937_64& rng) {
+    vector<int> ids;
+    ids.reserve(n);
+    if (dist == "sparse") {
+        // Uniform over the whole positive int range, no duplicates.
+        uniform_int_distribution<int> pick(1, INT_MAX);
+        while (ids.size() < n) {
+            while (ids.size() < n) ids.push_back(pick(rng));
+            sort(ids.begin(), ids.end());
+            ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        }
+        shuffle(ids.begin(), ids.end(), rng);
+    } else if (dist == "clustered") {
+        // Runs of 1000 consecutive SKUs per supplier, suppliers spread apart.
+        const size_t run = 1000;
+        size_t suppliers = (n + run - 1) / run;
+        vector<int> starts;
+        for (size_t s = 0; s < suppliers; s++) starts.push_back(int(s) * 4096 + 1);
+        shuffle(starts.begin(), starts.end(), rng);
+        for (int start : starts) {
+            for (size_t i = 0; i < run && ids.size() < n; i++) ids.push_back(start + int(i));
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) ids.push_back(int(i) + 1);
+        if (dist == "shuffled") shuffle(ids.begin(), ids.end(), rng);
+    }
+    return ids;
+}
+
+static const char* const categories[] = {
+    "Grocery", "Stationery", "Electronics", "Hardware", "Toys", "Clothing", "Books", "Kitchen",
+};
+
+// The product's name views name, which must outlive its use.
+static Product makeProduct(int id, string& name, int quantityBump = 0) {
+    name = "Item " + to_string(id);
+    return Product(id, name, categories[id % 8],
+                   1 + (id % 1000) * 0.25, id % 500 + quantityBump, 5 + id % 40);
+}
+
+class Reporter {
+private:
+    ostream& out;
+
+public:
+    explicit Reporter(ostream& out) : out(out) {}
+
+    void report(const Run& run, const string& op, size_t ops, double seconds, size_t bytes = 0) {
+        out << "{\"bench\":\"inventory\",\"backend\":\"" << run.backend
+            << "\",\"active_backend\":\"" << run.activeBackend
+            << "\",\"allocator\":\"" << run.allocator
+            << "\",\"dist\":\"" << run.dist << "\",\"n\":" << run.n
+            << ",\"op\":\"" << op << "\",\"ops\":" << ops
+            << ",\"seconds\":" << seconds
+            << ",\"ns_per_op\":" << (ops ? seconds * 1e9 / ops : 0)
+            << ",\"ops_per_sec\":" << (seconds > 0 ? ops / seconds : 0);
+        if (bytes) {
+            out << ",\"bytes\":" << bytes << ",\"mb_per_sec\":" << (seconds > 0 ? bytes / seconds / 1e6 : 0);
+        }
+        out << ",\"peak_rss_kb\":" << peakRssKb() << "}\n";
+        out.flush();
+    }
+
+    void reportNodes(const Run& run, const string& op, const NodeMemoryStats& nodes) {
+        out << "{\"bench\":\"inventory\",\"backend\":\"" << run.backend
+            << "\",\"active_backend\":\"" << run.activeBackend
+            << "\",\"allocator\":\"" << run.allocator
+            << "\",\"dist\":\"" << run.dist << "\",\"n\":" << run.n
+            << ",\"op\":\"" << op << "\",\"node_requests\":" << nodes.requests
+            << ",\"live_nodes\":" << nodes.liveBlocks << ",\"heap_allocations\":" << nodes.systemAllocations
+            << ",\"held_bytes\":" << nodes.heldBytes << ",\"fragmentation\":" << nodes.fragmentation() << "}\n";
+        out.flush();
+    }
+
+    // Cumulative cache counts at the end of phase op.
+    void reportCache(const Run& run, const string& op, const PageCacheStats& cache) {
+        out << "{\"bench\":\"inventory\",\"backend\":\"" << run.backend
+            << "\",\"active_backend\":\"" << run.activeBackend
+            << "\",\"allocator\":\"" << run.allocator
+            << "\",\"dist\":\"" << run.dist << "\",\"n\":" << run.n
+            << ",\"op\":\"page_cache\",\"after\":\"" << op << "\",\"hits\":" << cache.hits
+            << ",\"misses\":" << cache.misses << ",\"hit_rate\":" << cache.hitRate()
+            << ",\"evictions\":" << cache.evictions << ",\"writebacks\":" << cache.writebacks
+            << ",\"peak_rss_kb\":" << peakRssKb() << "}\n";
+        out.flush();
+    }
+};
+
+template <typename Body>
+static double timeIt(Body body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static size_t fileSize(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+    return file.is_open() ? size_t(file.tellg()) : 0;
+}
+
+// Defeats dead-code elimination of lookups.
+static volatile long long sink;
+
+static void benchInventory(const Run& base, const vector<int>& ids, const vector<int>& probe,
+                           Reporter& reporter) {
+    Run run = base;
+    IndexBackend backend = parseIndexBackend(run.backend);
+    NodeAllocator allocator = NodeAllocator::Pool;
+    parseNodeAllocator(run.allocator, allocator);
+    string path = "bench_inventory_" + to_string(getpid()) + ".csv";
+    size_t n = ids.size();
+
+    Inventory inventory(backend, allocator);
+    inventory.setQuiet(true);
+    double t = timeIt([&] {
+        string name;
+        for (int id : ids) inventory.addProduct(makeProduct(id, name));
+    });
+    run.activeBackend = indexBackendName(inventory.backend());
+    reporter.report(run, "add", n, t);
+
+    t = timeIt([&] {
+        long long sum = 0;
+        for (int id : probe) inventory.findProduct(id, [&sum](const Product& p) { sum += p.getQuantity(); });
+        sink = sum;
+    });
+    reporter.report(run, "find_hit", n, t);
+
+    t = timeIt([&] {
+        long long misses = 0;
+        for (size_t i = 0; i < n; i++) misses += !inventory.findProduct(-1 - int(i), [](const Product&) {});
+        sink = misses;
+    });
+    reporter.report(run, "find_miss", n, t);
+
+    t = timeIt([&] {
+        string name;
+        for (int id : probe) {
+            Product p = makeProduct(id, name, 1);
+            inventory.updateProduct(id, p.getName(), p.getCategory(), p.getPrice(), p.getQuantity(), p.getMargin());
+        }
+    });
+    reporter.report(run, "update", n, t);
+
+    t = timeIt([&] {
+        for (int id : probe) inventory.adjustQuantity(id, 1);
+    });
+    reporter.report(run, "adjust_quantity", n, t);
+
+    // Sales in batches of 64K, in arrival (random id) order.
+    vector<StockMovement> movements;
+    t = timeIt([&] {
+        for (size_t i = 0; i < probe.size(); i += 65536) {
+            movements.clear();
+            for (size_t j = i; j < min(probe.size(), i + 65536); j++) movements.push_back({probe[j], -1});
+            inventory.applyMovements(movements);
+        }
+    });
+    reporter.report(run, "apply_movements", n, t);
+
+    // A view costs O(1) to take; the first write to each page afterwards
+    // copies it, which update_viewed pays for.
+    InventoryView view;
+    t = timeIt([&] { view = inventory.view(); });
+    reporter.report(run, "view", 1, t);
+    t = timeIt([&] {
+        string name;
+        for (int id : probe) {
+            Product p = makeProduct(id, name, 2);
+            inventory.updateProduct(id, p.getName(), p.getCategory(), p.getPrice(), p.getQuantity(), p.getMargin());
+        }
+    });
+    reporter.report(run, "update_viewed", n, t);
+    view = InventoryView();
+
+    NullBuffer nullBuffer;
+    ostream nullStream(&nullBuffer);
+    inventory.setOutput(nullStream);
+    t = timeIt([&] { inventory.columnStore(); });
+    reporter.report(run, "columns_build", n, t);
+    // Full scans of the columns: a grouped aggregate, a filtered one, and a
+    // filtered listing ordered by value.
+    t = timeIt([&] {
+        inventory.runQuery("select category, count, sum(value), avg(price), min(margin), max(quantity) "
+                           "group by category");
+    });
+    reporter.report(run, "query_group", n, t);
+    t = timeIt([&] {
+        inventory.runQuery("select count, sum(value) where category = Toys and price > 100 and quantity < 250");
+    });
+    reporter.report(run, "query_filter", n, t);
+    t = timeIt([&] { inventory.runQuery("where margin >= 40 order by value desc limit 10"); });
+    reporter.report(run, "query_top", n, t);
+    t = timeIt([&] { inventory.reconcileTotals(); });
+    reporter.report(run, "reconcile", n, t, n * (sizeof(double) * 2 + sizeof(int32_t) + sizeof(uint32_t)));
+    t = timeIt([&] {
+        inventory.priceIndex();
+        inventory.valueIndex();
+    });
+    reporter.report(run, "order_index_build", n, t);
+    // 1000 price windows of width 1 (about n / 1000 products each).
+    t = timeIt([&] {
+        long long found = 0;
+        for (int i = 0; i < 1000; i++) {
+            inventory.priceIndex().forRange(1 + i * 0.25, 1.9 + i * 0.25, [&found](double, int) { found++; });
+        }
+        sink = found;
+    });
+    reporter.report(run, "price_range_x1000", 1000, t);
+    t = timeIt([&] {
+        long long sum = 0;
+        for (int i = 0; i < 1000; i++) inventory.valueIndex().forTop(100, [&sum](double, int id) { sum += id; });
+        sink = sum;
+    });
+    reporter.report(run, "top100_by_value", 1000, t);
+    t = timeIt([&] { sink = inventory.nameIndex().size(); });
+    reporter.report(run, "name_index_build", n, t);
+    // Prefix, substring and misspelt queries, a page of 20 each.
+    vector<string> queries;
+    for (int i = 0; i < 1000; i++) {
+        int id = ids[size_t(i) * ids.size() / 1000];
+        queries.push_back(i % 3 == 0 ? "item " + to_string(id / 10)
+                          : i % 3 == 1 ? to_string(id).substr(1)
+                          : "itme " + to_string(id));
+    }
+    t = timeIt([&] {
+        vector<NameMatch> page;
+        long long found = 0;
+        for (const string& query : queries) {
+            inventory.nameIndex().search(query, 0, 20, page);
+            found += page.size();
+        }
+        sink = found;
+    });
+    reporter.report(run, "name_search_x1000", 1000, t);
+    inventory.setOutput(cout);
+
+    t = timeIt([&] { inventory.saveInventoryToFile(path); });
+    size_t bytes = fileSize(path);
+    reporter.report(run, "save", n, t, bytes);
+
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+    t = timeIt([&] { inventory.printProducts(); });
+    cout.rdbuf(saved);
+    reporter.report(run, "print", n, t);
+
+    for (ExportFormat format : {ExportFormat::Csv, ExportFormat::JsonLines}) {
+        t = timeIt([&] { inventory.exportToFile(path, format); });
+        reporter.report(run, format == ExportFormat::Csv ? "export_csv" : "export_jsonl", n, t, fileSize(path));
+    }
+    inventory.saveInventoryToFile(path);
+
+    Inventory loaded(backend, allocator);
+    loaded.setQuiet(true);
+    t = timeIt([&] { loaded.loadInventoryFromFile(path); });
+    reporter.report(run, "load", n, t, bytes);
+    // A second load replaces everything the first one built.
+    t = timeIt([&] { loaded.loadInventoryFromFile(path); });
+    reporter.report(run, "reload", n, t, bytes);
+    remove(path.c_str());
+
+    reporter.reportNodes(run, "index_nodes", inventory.nodeStats());
+    t = timeIt([&] {
+        for (int id : probe) inventory.removeProduct(id);
+    });
+    reporter.report(run, "remove", n, t);
+}
+
+static void benchVector(const Run& base, const vector<int>& ids, const vector<int>& probe,
+                        Reporter& reporter) {
+    Run run = base;
+    run.activeBackend = "vector";
+    size_t n = ids.size();
+
+    VectorInventory inventory;
+    double t = timeIt([&] {
+        string name;
+        for (int id : ids) inventory.addProduct(makeProduct(id, name));
+    });
+    reporter.report(run, "add", n, t);
+
+    t = timeIt([&] {
+        long long sum = 0;
+        for (int id : probe) sum += inventory.findProduct(id)->getQuantity();
+        sink = sum;
+    });
+    reporter.report(run, "find_hit", n, t);
+
+    t = timeIt([&] {
+        long long misses = 0;
+        for (size_t i = 0; i < n; i++) misses += inventory.findProduct(-1 - int(i)) == nullptr;
+        sink = misses;
+    });
+    reporter.report(run, "find_miss", n, t);
+
+    t = timeIt([&] {
+        for (int id : probe) inventory.removeProduct(id);
+    });
+    reporter.report(run, "remove", n, t);
+}
+
+static void benchDisk(const Run& base, const vector<int>& ids, const vector<int>& probe, size_t cacheMb,
+                      Reporter& reporter) {
+    Run run = base;
+    run.activeBackend = "disk/" + to_string(cacheMb) + "MB";
+    string path = "bench_inventory_" + to_string(getpid());
+    size_t n = ids.size();
+    remove((path + ".db").c_str());
+
+    DiskInventory inventory(cacheMb << 20);
+    inventory.setQuiet(true);
+    inventory.open(path + ".db");
+    double t = timeIt([&] {
+        string name;
+        for (int id : ids) inventory.addProduct(makeProduct(id, name));
+    });
+    reporter.report(run, "add", n, t);
+    reporter.reportCache(run, "add", inventory.cacheStats());
+
+    t = timeIt([&] {
+        long long sum = 0;
+        for (int id : probe) sum += inventory.findProduct(id)->getQuantity();
+        sink = sum;
+    });
+    reporter.report(run, "find_hit", n, t);
+    reporter.reportCache(run, "find_hit", inventory.cacheStats());
+
+    t = timeIt([&] {
+        long long misses = 0;
+        for (size_t i = 0; i < n; i++) misses += inventory.findProduct(-1 - int(i)) == nullptr;
+        sink = misses;
+    });
+    reporter.report(run, "find_miss", n, t);
+
+    t = timeIt([&] {
+        string name;
+        for (int id : probe) {
+            Product p = makeProduct(id, name, 1);
+            inventory.updateProduct(id, p.getName(), p.getCategory(), p.getPrice(), p.getQuantity(), p.getMargin());
+        }
+    });
+    reporter.report(run, "update", n, t);
+
+    t = timeIt([&] {
+        for (int id : probe) inventory.adjustQuantity(id, 1);
+    });
+    reporter.report(run, "adjust_quantity", n, t);
+
+    vector<StockMovement> movements;
+    t = timeIt([&] {
+        for (size_t i = 0; i < probe.size(); i += 65536) {
+            movements.clear();
+            for (size_t j = i; j < min(probe.size(), i + 65536); j++) movements.push_back({probe[j], -1});
+            inventory.applyMovements(movements);
+        }
+    });
+    reporter.report(run, "apply_movements", n, t);
+    reporter.reportCache(run, "apply_movements", inventory.cacheStats());
+
+    t = timeIt([&] { inventory.flush(); });
+    reporter.report(run, "flush", n, t);
+
+    t = timeIt([&] { inventory.saveInventoryToFile(path + ".csv"); });
+    size_t bytes = fileSize(path + ".csv");
+    reporter.report(run, "save", n, t, bytes);
+
+    t = timeIt([&] { inventory.loadInventoryFromFile(path + ".csv"); });
+    reporter.report(run, "load", n, t, bytes);
+    remove((path + ".csv").c_str());
+
+    t = timeIt([&] {
+        for (int id : probe) inventory.removeProduct(id);
+    });
+    reporter.report(run, "remove", n, t);
+    reporter.reportCache(run, "remove", inventory.cacheStats());
+    inventory.close();
+    remove((path + ".db").c_str());
+}
+
+static void benchConcurrent(const Run& base, const vector<int>& ids, const vector<int>& probe,
+                            const vector<size_t>& threadCounts, Reporter& reporter) {
+    Run run = base;
+    size_t n = ids.size();
+    ConcurrentInventory inventory;
+    run.activeBackend = "concurrent/" + to_string(inventory.shardCount());
+    double t = timeIt([&] {
+        string name;
+        for (int id : ids) inventory.addProduct(makeProduct(id, name));
+    });
+    reporter.report(run, "add", n, t);
+
+    // Each thread works through its own stretch of probe; every tenth op is
+    // an update, the rest are reads.
+    for (size_t threads : threadCounts) {
+        // Workers store their sums apart; sink takes the total after the join.
+        vector<long long> sums(threads);
+        t = timeIt([&] {
+            vector<thread> workers;
+            for (size_t w = 0; w < threads; w++) {
+                workers.emplace_back([&, w] {
+                    string name;
+                    long long sum = 0;
+                    size_t begin = n * w / threads, end = n * (w + 1) / threads;
+                    for (size_t i = begin; i < end; i++) {
+                        int id = probe[i];
+                        if (i % 10 == 0) {
+                            Product p = makeProduct(id, name, int(i & 1));
+                            inventory.updateProduct(id, p.getName(), p.getCategory(), p.getPrice(),
+                                                    p.getQuantity(), p.getMargin());
+                        } else {
+                            inventory.readProduct(id, [&sum](const Product& p) { sum += p.getQuantity(); });
+                        }
+                    }
+                    sums[w] = sum;
+                });
+            }
+            for (thread& worker : workers) worker.join();
+        });
+        long long total = 0;
+        for (long long sum : sums) total += sum;
+        sink = total;
+        reporter.report(run, "mixed_t" + to_string(threads), n, t);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--sizes") {
+            options.sizes.clear();
+            for (const string& s : splitList(value)) options.sizes.push_back(stoull(s));
+        } else if (key == "--backends") {
+            options.backends = splitList(value);
+        } else if (key == "--dists") {
+            options.dists = splitList(value);
+        } else if (key == "--threads") {
+            options.threads.clear();
+            for (const string& s : splitList(value)) options.threads.push_back(stoull(s));
+        } else if (key == "--vector-max") {
+            options.vectorMax = stoull(value);
+        } else if (key == "--allocators") {
+            options.allocators = splitList(value);
+        } else if (key == "--cache-mb") {
+            options.cacheMb = max<size_t>(1, stoull(value));
+        } else if (key == "--seed") {
+            options.seed = stoull(value);
+        } else if (key == "--out") {
+            options.out = value;
+        } else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file.is_open()) {
+            cerr << "Error opening " << options.out << endl;
+            return 1;
+        }
+    }
+    Reporter reporter(options.out.empty() ? cout : file);
+
+    for (size_t n : options.sizes) {
+        for (const string& dist : options.dists) {
+            // Same seed per (size, dist) so every backend sees identical ids.
+            mt19937_64 rng(options.seed ^ (n * 1000003) ^ hash<string>()(dist));
+            vector<int> ids = generateIds(dist, n, rng);
+            vector<int> probe = ids;
+            shuffle(probe.begin(), probe.end(), rng);
+
+            for (const string& backend : options.backends) {
+                Run run{backend, backend, dist, n};
+                resetPeakRss();
+                if (backend == "vector") {
+                    if (n <= options.vectorMax) benchVector(run, ids, probe, reporter);
+                } else if (backend == "disk") {
+                    benchDisk(run, ids, probe, options.cacheMb, reporter);
+                } else if (backend == "concurrent") {
+                    benchConcurrent(run, ids, probe, options.threads, reporter);
+                } else if (backend == "dense" && dist == "sparse") {
+                    continue;
+                } else if (backend == "ordered") {
+                    for (const string& allocator : options.allocators) {
+                        run.allocator = allocator;
+                        resetPeakRss();
+                        benchInventory(run, ids, probe, reporter);
+                    }
+                } else {
+                    benchInventory(run, ids, probe, reporter);
+                }
+            }
+        }
+    }
+    return 0;
+}
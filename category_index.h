@@ -0,0 +1,106 @@
+#ifndef CATEGORY_INDEX_H
+#define CATEGORY_INDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "product.h"
+
+using namespace std;
+
+struct CategoryStats {
+    double revenue = 0;
+    double profit = 0;
+    size_t products = 0;
+    long long units = 0;
+    // Product ids, in no particular order.
+    vector<int> members;
+};
+
+// category -> products secondary index, keyed by category dictionary code.
+// Each category keeps running revenue/profit/count totals adjusted on every
+// change, the same way Inventory keeps its global totals, so category
+// totals are O(1) and listing a category is O(k).
+class CategoryIndex {
+private:
+    vector<CategoryStats> categories;
+    // Where each id sits in its category's members vector, for O(1) removal.
+    unordered_map<int, size_t> position;
+    size_t nonEmpty = 0;
+
+public:
+    void add(const Product& product) {
+        uint32_t code = product.getCategoryCode();
+        if (code >= categories.size()) categories.resize(code + 1);
+        CategoryStats& stats = categories[code];
+        double revenue = product.getPrice() * product.getQuantity();
+        stats.revenue += revenue;
+        stats.profit += revenue * (product.getMargin() / 100);
+        if (stats.products++ == 0) nonEmpty++;
+        stats.units += product.getQuantity();
+        position[product.getId()] = stats.members.size();
+        stats.members.push_back(product.getId());
+    }
+
+    // product must hold the values it was added (or last updated) with.
+    void remove(const Product& product) {
+        CategoryStats& stats = categories[product.getCategoryCode()];
+        double revenue = product.getPrice() * product.getQuantity();
+        stats.revenue -= revenue;
+        stats.profit -= revenue * (product.getMargin() / 100);
+        stats.units -= product.getQuantity();
+        if (--stats.products == 0) {
+            // Start the next product in this category from exact zeros.
+            stats = CategoryStats();
+            nonEmpty--;
+        }
+
+        auto pos = position.find(product.getId());
+        if (!stats.members.empty()) {
+            size_t index = pos->second;
+            int moved = stats.members.back();
+            stats.members[index] = moved;
+            position[moved] = index;
+            stats.members.pop_back();
+        }
+        position.erase(pos);
+    }
+
+    // A member's price, quantity or margin changed; its category did not.
+    void adjust(uint32_t code, double revenue, double profit, long long units) {
+        CategoryStats& stats = categories[code];
+        stats.revenue += revenue;
+        stats.profit += profit;
+        stats.units += units;
+    }
+
+    void clear() {
+        categories.clear();
+        position.clear();
+        nonEmpty = 0;
+    }
+
+    // Stats for a category code, or nullptr if it has no products.
+    const CategoryStats* find(uint32_t code) const {
+        return code < categories.size() && categories[code].products > 0 ? &categories[code] : nullptr;
+    }
+
+    // Replaces a category's running totals with recomputed ones.
+    void setTotals(uint32_t code, double revenue, double profit) {
+        if (code >= categories.size() || categories[code].products == 0) return;
+        categories[code].revenue = revenue;
+        categories[code].profit = profit;
+    }
+
+    size_t size() const { return nonEmpty; }
+
+    // Visits (code, stats) for every non-empty category.
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (size_t code = 0; code < categories.size(); code++) {
+            if (categories[code].products > 0) visit(uint32_t(code), categories[code]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef CONCURRENT_INVENTORY_H
+#define CONCURRENT_INVENTORY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include "inventory.h"
+
+using namespace std;
+
+// A product with its own copies of the strings, safe to keep after the
+// lock it was read under is released.
+struct ProductRecord {
+    int id = 0;
+    string name;
+    string category;
+    double price = 0;
+    int quantity = 0;
+    double margin = 0;
+
+    ProductRecord() {}
+    explicit ProductRecord(const Product& product)
+        : id(product.getId()), name(product.getName()), category(product.getCategory()),
+          price(product.getPrice()), quantity(product.getQuantity()), margin(product.getMargin()) {}
+};
+
+// Inventory for many threads at once. Ids are hashed onto independent
+// shards, each an ordinary Inventory behind a reader/writer lock, so
+// operations on different shards never contend and readers of one shard
+// share its lock. Each shard keeps its own revenue/profit totals and the
+// global totals are their sum, combined on read.
+//
+// Shards are quiet and discard their messages; results are reported only
+// through return values. size() and the totals lock one shard at a time, so
+// under concurrent writes they are not a single point-in-time view.
+class ConcurrentInventory {
+private:
+    // Own cache lines so one shard's lock traffic doesn't slow its neighbours.
+    struct alignas(64) Shard {
+        mutable shared_mutex lock;
+        // An ostream without a buffer drops everything written to it.
+        ostream discard{nullptr};
+        Inventory inventory;
+
+        Shard(IndexBackend backend, NodeAllocator allocator) : inventory(backend, allocator) {
+            inventory.setQuiet(true);
+            inventory.setOutput(discard);
+        }
+    };
+
+    vector<unique_ptr<Shard>> shards;
+
+    size_t shardIndex(int id) const {
+        // Fibonacci hashing, so runs of consecutive ids spread over every shard.
+        return size_t((uint64_t(uint32_t(id)) * 0x9E3779B97F4A7C15ull) >> 32) & (shards.size() - 1);
+    }
+
+    Shard& shardOf(int id) const { return *shards[shardIndex(id)]; }
+
+    // Splits rows by shard and replaces every shard's contents in parallel.
+    void replaceAll(const vector<Product>& rows) {
+        vector<vector<Product>> parts(shards.size());
+        for (const Product& product : rows) parts[shardIndex(product.getId())].push_back(product);
+        size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), shards.size());
+        vector<thread> threads;
+        for (size_t w = 0; w < workers; w++) {
+            threads.emplace_back([this, &parts, w, workers] {
+                for (size_t i = w; i < shards.size(); i += workers) {
+                    unique_lock<shared_mutex> lock(shards[i]->lock);
+                    shards[i]->inventory.replaceProducts(parts[i]);
+                }
+            });
+        }
+        for (thread& t : threads) t.join();
+    }
+
+public:
+    // shardCount is rounded up to a power of two; 0 picks 4 per hardware
+    // thread, which keeps collisions rare while every thread is writing.
+    explicit ConcurrentInventory(size_t shardCount = 0, IndexBackend backend = IndexBackend::Auto,
+                                 NodeAllocator allocator = NodeAllocator::Pool) {
+        if (shardCount == 0) shardCount = 4 * max(1u, thread::hardware_concurrency());
+        size_t count = 1;
+        while (count < shardCount) count *= 2;
+        for (size_t i = 0; i < count; i++) shards.emplace_back(new Shard(backend, allocator));
+    }
+
+    size_t shardCount() const { return shards.size(); }
+
+    bool addProduct(const Product& product) {
+        Shard& shard = shardOf(product.getId());
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.addProduct(product);
+    }
+
+    bool removeProduct(int id) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.removeProduct(id);
+    }
+
+    bool updateProduct(int id, string_view name, string_view category, double price, int quantity, double margin) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.updateProduct(id, name, category, price, quantity, margin);
+    }
+
+    bool adjustQuantity(int id, int delta) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.adjustQuantity(id, delta);
+    }
+
+    bool setPrice(int id, double price) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.setPrice(id, price);
+    }
+
+    bool setMargin(int id, double margin) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.setMargin(id, margin);
+    }
+
+    // Splits movements by shard and applies each part under one lock; see
+    // Inventory::applyMovements. Returns how many were applied.
+    size_t applyMovements(const vector<StockMovement>& movements) {
+        vector<vector<StockMovement>> parts(shards.size());
+        for (const StockMovement& movement : movements) parts[shardIndex(movement.id)].push_back(movement);
+        size_t applied = 0;
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (parts[i].empty()) continue;
+            unique_lock<shared_mutex> lock(shards[i]->lock);
+            applied += shards[i]->inventory.applyMovements(parts[i]);
+        }
+        return applied;
+    }
+
+    // Copy of the product, or nullopt.
+    optional<ProductRecord> findProduct(int id) const {
+        optional<ProductRecord> found;
+        readProduct(id, [&found](const Product& product) { found.emplace(product); });
+        return found;
+    }
+
+    // Calls visit(const Product&) under the shard's read lock and returns
+    // false if id is absent. Cheaper than findProduct when only a few fields
+    // are needed; the Product must not escape visit.
+    template <typename Visitor>
+    bool readProduct(int id, Visitor visit) const {
+        Shard& shard = shardOf(id);
+        shared_lock<shared_mutex> lock(shard.lock);
+        return shard.inventory.readProduct(id, visit);
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> lock(shard->lock);
+            total += shard->inventory.size();
+        }
+        return total;
+    }
+
+    double getTotalRevenue() const {
+        double total = 0;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> lock(shard->lock);
+            total += shard->inventory.getTotalRevenue();
+        }
+        return total;
+    }
+
+    double getTotalProfit() const {
+        double total = 0;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> lock(shard->lock);
+            total += shard->inventory.getTotalProfit();
+        }
+        return total;
+    }
+
+    // Parses filename once, then loads the shards in parallel.
+    bool loadInventoryFromFile(const string& filename) {
+        OpTimer timer(StatOp::Load);
+        CsvLoadResult result;
+        if (!CsvLoader::load(filename, result)) {
+            timer.miss();
+            return false;
+        }
+        Stats::count(StatCounter::BytesRead, result.file ? result.file->size() : 0);
+        Stats::count(StatCounter::LoadRejects, result.rejectedLines.size());
+        replaceAll(result.products);
+        return true;
+    }
+
+    // Inventory::mergeInventoryFiles, then the shards are loaded in
+    // parallel. Returns false (changing nothing) on a missing file or any
+    // conflict the policy refuses.
+    bool mergeInventoryFiles(const vector<string>& filenames, MergePolicy policy) {
+        OpTimer timer(StatOp::Merge);
+        CsvMergeResult result;
+        if (!CsvMerger::merge(filenames, policy, result) || result.conflictCount > 0) {
+            timer.miss();
+            return false;
+        }
+        for (const CsvLoadResult& file : result.files) {
+            Stats::count(StatCounter::BytesRead, file.file ? file.file->size() : 0);
+            Stats::count(StatCounter::LoadRejects, file.rejectedLines.size());
+        }
+        replaceAll(result.products);
+        return true;
+    }
+
+    // Writes the same format as Inventory::saveInventoryToFile, in id order.
+    // Every shard stays read-locked until the file is written, so the file
+    // is one consistent state; writers wait meanwhile.
+    bool saveInventoryToFile(const string& filename) const {
+        OpTimer timer(StatOp::Save);
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            timer.miss();
+            return false;
+        }
+        vector<shared_lock<shared_mutex>> locks;
+        vector<Product> rows;
+        for (const auto& shard : shards) {
+            locks.emplace_back(shard->lock);
+            shard->inventory.forEachProduct([&rows](const Product& product) { rows.push_back(product); });
+        }
+        sort(rows.begin(), rows.end(), [](const Product& a, const Product& b) { return a.getId() < b.getId(); });
+        ProductExporter exporter(file, ExportFormat::Csv);
+        for (const Product& row : rows) exporter.add(row);
+        bool ok = exporter.finish();
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(file.tellp()))));
+        file.close();
+        if (ok && file) return true;
+        timer.miss();
+        return false;
+    }
+};
+
+#endif
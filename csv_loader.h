@@ -0,0 +1,161 @@
+#ifndef CSV_LOADER_H
+#define CSV_LOADER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include "product.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Parses one numeric field the way stoi/stod did in the old loader: leading
+// whitespace is skipped, an optional sign is accepted and anything after the
+// number is ignored. Unlike stoi, out-of-range values reject the line instead
+// of throwing.
+inline bool parseIntField(const char* begin, const char* end, int& value) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) begin++;
+    if (begin < end && *begin == '+') begin++;
+    return from_chars(begin, end, value).ec == errc();
+}
+
+inline bool parseDoubleField(const char* begin, const char* end, double& value) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) begin++;
+    if (begin < end && *begin == '+') begin++;
+    return from_chars(begin, end, value).ec == errc();
+}
+
+// One saveInventoryToFile line, split in place: name and category point into
+// the caller's buffer and nothing is allocated.
+struct CsvFields {
+    int id;
+    const char* name;
+    size_t nameLength;
+    const char* category;
+    size_t categoryLength;
+    double price;
+    int quantity;
+    double margin;
+};
+
+inline bool parseCsvLine(const char* begin, const char* end, CsvFields& row) {
+    if (end > begin && end[-1] == '\r') end--;
+    const char* fields[6];
+    const char* fieldEnds[6];
+    const char* p = begin;
+    for (int f = 0; f < 6; f++) {
+        if (p > end) return false;
+        const char* comma = static_cast<const char*>(memchr(p, ',', size_t(end - p)));
+        const char* stop = comma ? comma : end;
+        fields[f] = p;
+        fieldEnds[f] = stop;
+        p = stop + 1;
+    }
+    row.name = fields[1];
+    row.nameLength = size_t(fieldEnds[1] - fields[1]);
+    row.category = fields[2];
+    row.categoryLength = size_t(fieldEnds[2] - fields[2]);
+    return parseIntField(fields[0], fieldEnds[0], row.id)
+        && parseDoubleField(fields[3], fieldEnds[3], row.price)
+        && parseIntField(fields[4], fieldEnds[4], row.quantity)
+        && parseDoubleField(fields[5], fieldEnds[5], row.margin);
+}
+
+struct CsvLoadResult {
+    // Names and categories view this mapping, so it lives as long as the
+    // result does.
+    unique_ptr<MappedFile> file;
+    vector<Product> products;
+    // 1-based line numbers that could not be parsed, in file order.
+    vector<size_t> rejectedLines;
+    size_t lines = 0;
+};
+
+// Memory-maps a saveInventoryToFile-format file and parses it on several
+// threads. The file is cut into chunks at newline boundaries; each thread
+// parses its chunks into its own vector and the results are concatenated in
+// file order, so "later line wins" still holds for duplicate ids. Parsed
+// products view the mapped file directly; nothing is allocated per field.
+class CsvLoader {
+private:
+    static constexpr size_t minChunkBytes = size_t(1) << 20;
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        vector<Product> products;
+        vector<size_t> rejectedLines;
+        size_t lines = 0;
+    };
+
+    static void parseChunk(Chunk& chunk) {
+        const char* p = chunk.begin;
+        CsvFields row;
+        while (p < chunk.end) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', size_t(chunk.end - p)));
+            const char* lineEnd = newline ? newline : chunk.end;
+            chunk.lines++;
+            if (parseCsvLine(p, lineEnd, row)) {
+                chunk.products.emplace_back(row.id, string_view(row.name, row.nameLength),
+                                            string_view(row.category, row.categoryLength),
+                                            row.price, row.quantity, row.margin);
+            } else {
+                chunk.rejectedLines.push_back(chunk.lines);
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+public:
+    static bool load(const string& filename, CsvLoadResult& result, unsigned threads = 0) {
+        unique_ptr<MappedFile> file(new MappedFile());
+        if (!file->open(filename, true)) return false;
+        const char* data = file->data();
+        size_t size = file->size();
+
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        size_t chunkCount = min<size_t>(threads, max<size_t>(1, size / minChunkBytes));
+        vector<Chunk> chunks(chunkCount);
+        const char* start = data;
+        for (size_t c = 0; c < chunkCount; c++) {
+            const char* stop = data + size * (c + 1) / chunkCount;
+            if (c + 1 < chunkCount) {
+                const char* newline = static_cast<const char*>(memchr(stop, '\n', size_t(data + size - stop)));
+                stop = newline ? newline + 1 : data + size;
+            }
+            if (stop < start) stop = start;
+            chunks[c].begin = start;
+            chunks[c].end = stop;
+            start = stop;
+        }
+
+        if (chunkCount == 1) {
+            parseChunk(chunks[0]);
+        } else {
+            vector<thread> workers;
+            for (Chunk& chunk : chunks) workers.emplace_back(parseChunk, ref(chunk));
+            for (thread& worker : workers) worker.join();
+        }
+
+        size_t total = 0;
+        for (const Chunk& chunk : chunks) total += chunk.products.size();
+        result.products.clear();
+        result.products.reserve(total);
+        result.rejectedLines.clear();
+        result.lines = 0;
+        for (Chunk& chunk : chunks) {
+            for (Product& product : chunk.products) result.products.push_back(move(product));
+            for (size_t line : chunk.rejectedLines) result.rejectedLines.push_back(result.lines + line);
+            result.lines += chunk.lines;
+            vector<Product>().swap(chunk.products);
+        }
+        result.file = move(file);
+        return true;
+    }
+};
+
+#endif
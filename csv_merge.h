@@ -0,0 +1,265 @@
+#ifndef CSV_MERGE_H
+#define CSV_MERGE_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include "csv_loader.h"
+
+using namespace std;
+
+// What to do when an id is in more than one file.
+//   Sum:      add up the quantities; everything else comes from the last file
+//   LastWins: the row from the last file replaces the earlier ones
+//   Error:    refuse the merge
+enum class MergePolicy { Sum, LastWins, Error };
+
+inline bool parseMergePolicy(const string& name, MergePolicy& policy) {
+    if (name == "sum") policy = MergePolicy::Sum;
+    else if (name == "last") policy = MergePolicy::LastWins;
+    else if (name == "error") policy = MergePolicy::Error;
+    else return false;
+    return true;
+}
+
+inline const char* mergePolicyName(MergePolicy policy) {
+    switch (policy) {
+        case MergePolicy::Sum: return "sum";
+        case MergePolicy::LastWins: return "last";
+        default: return "error";
+    }
+}
+
+// An id the policy could not merge: in two files under Error, or with a
+// summed quantity that does not fit an int under Sum.
+struct MergeConflict {
+    int id;
+    size_t firstFile;
+    size_t secondFile;
+    bool overflow;
+};
+
+struct CsvMergeResult {
+    // One per input file, in argument order; products still view them.
+    vector<CsvLoadResult> files;
+    // Index of the first file that could not be opened, if any.
+    size_t failedFile = SIZE_MAX;
+    // The merged rows, sorted by id with no duplicates.
+    vector<Product> products;
+    // Ids in more than one file.
+    size_t sharedIds = 0;
+    // The first maxConflicts conflicts, by id, and how many there were.
+    static constexpr size_t maxConflicts = 10;
+    vector<MergeConflict> conflicts;
+    size_t conflictCount = 0;
+};
+
+// Loads several saveInventoryToFile-format files and merges them by id.
+// Each file is first resolved on its own the way loadInventoryFromFile
+// does (a later line wins), then the files are merged in argument order
+// under the policy.
+//
+// Files are parsed concurrently, one per worker, or each on several
+// workers when there are fewer files than threads; each is sorted by id as
+// it is parsed. The merge is split into id ranges (from a sample of every
+// file), and each worker k-way merges its range across all files, so the
+// combined rows come out sorted and ready for ProductIndex::bulkLoad.
+class CsvMerger {
+private:
+    struct Part {
+        int low;
+        int high;
+        bool last;
+        vector<Product> products;
+        vector<MergeConflict> conflicts;
+        size_t conflictCount = 0;
+        size_t sharedIds = 0;
+    };
+
+    static void sortKeepLast(vector<Product>& rows) {
+        auto byId = [](const Product& a, const Product& b) { return a.getId() < b.getId(); };
+        if (!is_sorted(rows.begin(), rows.end(), byId)) stable_sort(rows.begin(), rows.end(), byId);
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (i + 1 < rows.size() && rows[i + 1].getId() == rows[i].getId()) continue;
+            if (kept != i) rows[kept] = rows[i];
+            kept++;
+        }
+        rows.resize(kept);
+    }
+
+    // Replaces the smallest key of a min-heap and restores the heap.
+    static void replaceTop(vector<uint64_t>& heap, uint64_t value) {
+        size_t size = heap.size(), i = 0;
+        for (size_t child; (child = 2 * i + 1) < size; i = child) {
+            if (child + 1 < size && heap[child + 1] < heap[child]) child++;
+            if (value <= heap[child]) break;
+            heap[i] = heap[child];
+        }
+        heap[i] = value;
+    }
+
+    static void conflict(Part& part, const MergeConflict& c) {
+        if (part.conflicts.size() < CsvMergeResult::maxConflicts) part.conflicts.push_back(c);
+        part.conflictCount++;
+    }
+
+    // Merges the rows with ids in [low, high), or from low on for the last part.
+    static void mergePart(const vector<CsvLoadResult>& files, MergePolicy policy, Part& part) {
+        struct Cursor {
+            const Product* at;
+            const Product* end;
+            size_t file;
+        };
+        auto byId = [](const Product& p, int id) { return p.getId() < id; };
+        vector<Cursor> cursors;
+        size_t total = 0;
+        for (size_t f = 0; f < files.size(); f++) {
+            const vector<Product>& rows = files[f].products;
+            const Product* rowsEnd = rows.data() + rows.size();
+            const Product* begin = lower_bound(rows.data(), rowsEnd, part.low, byId);
+            const Product* end = part.last ? rowsEnd : lower_bound(begin, rowsEnd, part.high, byId);
+            if (begin == end) continue;
+            cursors.push_back({begin, end, f});
+            total += size_t(end - begin);
+        }
+        part.products.reserve(total);
+
+        // Min-heap of (id, cursor) packed so that plain integer order is
+        // smallest id first, then file order (cursors are in file order).
+        auto key = [&cursors](size_t c) {
+            return uint64_t(uint32_t(cursors[c].at->getId()) ^ 0x80000000u) << 32 | c;
+        };
+        vector<uint64_t> heap;
+        for (size_t c = 0; c < cursors.size(); c++) heap.push_back(key(c));
+        make_heap(heap.begin(), heap.end(), greater<uint64_t>());
+
+        // The rows for one id, in file order.
+        vector<Cursor*> group;
+        while (!heap.empty()) {
+            uint64_t top = heap.front() >> 32;
+            group.clear();
+            do {
+                size_t c = uint32_t(heap.front());
+                group.push_back(&cursors[c]);
+                // From here on the group's row is at[-1]. Ids are unique
+                // within a file, so the cursor's next key sorts after this
+                // group and it can go straight back in.
+                Cursor& cursor = cursors[c];
+                if (++cursor.at != cursor.end) {
+                    // With many files the reads interleave too many streams
+                    // for the hardware prefetcher; ask for the row after.
+                    if (cursor.end - cursor.at > 1) __builtin_prefetch(cursor.at + 1);
+                    replaceTop(heap, key(c));
+                } else {
+                    uint64_t moved = heap.back();
+                    heap.pop_back();
+                    if (!heap.empty()) replaceTop(heap, moved);
+                }
+            } while (!heap.empty() && heap.front() >> 32 == top);
+            const Product& last = group.back()->at[-1];
+            int id = last.getId();
+            if (group.size() > 1) part.sharedIds++;
+            if (group.size() == 1 || policy == MergePolicy::LastWins) {
+                part.products.push_back(last);
+            } else if (policy == MergePolicy::Sum) {
+                long long quantity = 0;
+                for (const Cursor* cursor : group) quantity += cursor->at[-1].getQuantity();
+                if (quantity > INT_MAX || quantity < INT_MIN) {
+                    conflict(part, {id, group.front()->file, group.back()->file, true});
+                } else {
+                    part.products.push_back(last);
+                    part.products.back().setQuantity(int(quantity));
+                }
+            } else {
+                conflict(part, {id, group[0]->file, group[1]->file, false});
+            }
+        }
+    }
+
+public:
+    // Returns false, with failedFile set, if a file cannot be opened. Any
+    // conflicts are left in result for the caller to report; products are
+    // only meaningful when there are none.
+    static bool merge(const vector<string>& filenames, MergePolicy policy, CsvMergeResult& result,
+                      unsigned threads = 0) {
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        size_t count = filenames.size();
+        result = CsvMergeResult();
+        result.files.resize(count);
+        if (count == 0) return true;
+
+        // Parse and sort, one file at a time per worker.
+        size_t workers = min<size_t>(threads, count);
+        unsigned perFile = unsigned(max<size_t>(1, threads / count));
+        atomic<size_t> next{0};
+        vector<char> opened(count, 0);
+        auto parse = [&] {
+            for (size_t f; (f = next.fetch_add(1)) < count;) {
+                if (!CsvLoader::load(filenames[f], result.files[f], perFile)) continue;
+                sortKeepLast(result.files[f].products);
+                opened[f] = 1;
+            }
+        };
+        vector<thread> pool;
+        for (size_t w = 1; w < workers; w++) pool.emplace_back(parse);
+        parse();
+        for (thread& t : pool) t.join();
+        pool.clear();
+        for (size_t f = 0; f < count; f++) {
+            if (!opened[f]) {
+                result.failedFile = f;
+                return false;
+            }
+        }
+
+        // Cut the id range into one part per worker at the quantiles of an
+        // even sample of every row.
+        size_t rows = 0;
+        for (const CsvLoadResult& file : result.files) rows += file.products.size();
+        if (rows == 0) return true;
+        size_t step = max<size_t>(1, rows / 4096);
+        vector<int> sample;
+        for (const CsvLoadResult& file : result.files) {
+            for (size_t i = 0; i < file.products.size(); i += step) sample.push_back(file.products[i].getId());
+        }
+        sort(sample.begin(), sample.end());
+        size_t partCount = min<size_t>(threads, max<size_t>(1, rows / 65536));
+        vector<Part> parts;
+        int low = INT_MIN;
+        for (size_t p = 1; p < partCount; p++) {
+            int high = sample[sample.size() * p / partCount];
+            if (high <= low) continue;
+            parts.push_back({low, high, false, {}, {}, 0, 0});
+            low = high;
+        }
+        parts.push_back({low, INT_MAX, true, {}, {}, 0, 0});
+
+        for (size_t p = 1; p < parts.size(); p++) {
+            pool.emplace_back(mergePart, cref(result.files), policy, ref(parts[p]));
+        }
+        mergePart(result.files, policy, parts[0]);
+        for (thread& t : pool) t.join();
+
+        size_t total = 0;
+        for (const Part& part : parts) total += part.products.size();
+        result.products.reserve(total);
+        for (Part& part : parts) {
+            result.products.insert(result.products.end(), part.products.begin(), part.products.end());
+            vector<Product>().swap(part.products);
+            result.sharedIds += part.sharedIds;
+            result.conflictCount += part.conflictCount;
+            for (const MergeConflict& c : part.conflicts) {
+                if (result.conflicts.size() < CsvMergeResult::maxConflicts) result.conflicts.push_back(c);
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,922 @@
+#ifndef DISK_INVENTORY_H
+#define DISK_INVENTORY_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include "page_cache.h"
+#include "inventory.h"
+
+using namespace std;
+
+// An inventory kept in a file of 4 KB pages rather than in memory, for
+// catalogs larger than RAM. Only the pages in its PageCache are in memory,
+// so memory use is set by the cache size, not the catalog size.
+//
+// Page 0 is the header. An id index, a B+tree, maps each id to the record
+// page and slot holding the product; its leaves are chained in id order.
+// Record pages are slotted: the slot array grows up from the page header,
+// the records down from the end, and a record keeps its slot when its page
+// is compacted. A new record goes on the page being filled, then on a page
+// that removals have freed a quarter of, then on a new page.
+//
+// Changes reach the file as the cache writes pages back, and all of them
+// on flush() or close(). The header says whether the file was closed (or
+// flushed) since it last changed; nothing more is done for crash recovery.
+//
+// Operations and messages follow Inventory's. The secondary indexes, the
+// log, views and history are not available on disk.
+class DiskInventory {
+private:
+    static constexpr size_t pageSize = PageCache::pageSize;
+    enum PageKind : uint16_t { LeafPage = 1, InnerPage = 2, RecordPage = 3 };
+
+    // Header page: magic, page size, then the Header fields.
+    static constexpr char magic[8] = "EKDISK1";
+
+    // Leaf: kind, count, next leaf, then the ids, record pages and slots.
+    static constexpr uint32_t leafCapacity = 408;
+    static constexpr size_t leafKeys = 8;
+    static constexpr size_t leafPages = leafKeys + 4 * leafCapacity;
+    static constexpr size_t leafSlots = leafPages + 4 * leafCapacity;
+
+    // Inner: kind, count of ids, then the ids and count + 1 children. Child
+    // i holds the ids from id i - 1 up to (not including) id i.
+    static constexpr uint32_t innerCapacity = 510;
+    static constexpr size_t innerKeys = 8;
+    static constexpr size_t innerChildren = innerKeys + 4 * innerCapacity;
+
+    // Record page: kind, slot count, start of the records, bytes of live
+    // records, then the slot array (record offsets, 0 for a free slot).
+    // Record: id, quantity, price, margin, name and category lengths, then
+    // the name and category bytes.
+    static constexpr size_t recordHeader = 8;
+    static constexpr size_t recordFixed = 28;
+    static constexpr size_t maxRecordText = pageSize - recordHeader - 2 - recordFixed;
+    static constexpr size_t maxReusePages = 1024;
+
+    struct Header {
+        uint32_t root = 0;
+        // Levels in the id index; 1 when the root is a leaf.
+        uint32_t height = 0;
+        uint32_t firstLeaf = 0;
+        // Record page new records go on; 0 for none.
+        uint32_t fillPage = 0;
+        uint32_t clean = 1;
+        uint64_t count = 0;
+        double totalRevenue = 0;
+        double totalProfit = 0;
+    };
+
+    // An inner page passed on the way down, and which child was taken.
+    struct PathStep {
+        uint32_t page;
+        uint32_t child;
+    };
+
+    // Where an id's index entry and record are.
+    struct Location {
+        uint32_t leaf;
+        uint32_t index;
+        uint32_t page;
+        uint16_t slot;
+    };
+
+    PageCache cache;
+    size_t cacheBytes;
+    string filename;
+    Header header;
+    // Record pages with room, besides fillPage; forgotten on close. Bit n
+    // of reuseListed is set while page n is in the list.
+    vector<uint32_t> reusePages;
+    vector<bool> reuseListed;
+    vector<PathStep> path;
+    // What findProduct returns, with its own copies of the strings.
+    Product found;
+    string foundName;
+    string foundCategory;
+    bool quiet = false;
+    ostream* out = &cout;
+
+    template <typename T>
+    static T get(const char* page, size_t offset) {
+        T value;
+        memcpy(&value, page + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    static void put(char* page, size_t offset, T value) {
+        memcpy(page + offset, &value, sizeof(T));
+    }
+
+    static uint32_t countOf(const char* page) { return get<uint16_t>(page, 2); }
+
+    static uint32_t lowerBound(const char* page, size_t keys, uint32_t n, int id) {
+        uint32_t lo = 0, hi = n;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (get<int32_t>(page, keys + 4 * mid) < id) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    static uint32_t upperBound(const char* page, size_t keys, uint32_t n, int id) {
+        uint32_t lo = 0, hi = n;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (get<int32_t>(page, keys + 4 * mid) <= id) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    static size_t recordBytes(string_view name, string_view category) {
+        return recordFixed + name.size() + category.size();
+    }
+
+    // The product in slot of a record page, viewing the page's bytes.
+    static Product readRecord(const char* page, uint16_t slot) {
+        const char* r = page + get<uint16_t>(page, recordHeader + 2 * size_t(slot));
+        uint16_t nameLength = get<uint16_t>(r, 24);
+        uint16_t categoryLength = get<uint16_t>(r, 26);
+        return Product(get<int32_t>(r, 0), string_view(r + recordFixed, nameLength),
+                       string_view(r + recordFixed + nameLength, categoryLength), get<double>(r, 8),
+                       get<int32_t>(r, 4), get<double>(r, 16));
+    }
+
+    static size_t recordSize(const char* record) {
+        return recordFixed + get<uint16_t>(record, 24) + get<uint16_t>(record, 26);
+    }
+
+    static void writeValues(char* record, const Product& product) {
+        put<int32_t>(record, 4, product.getQuantity());
+        put<double>(record, 8, product.getPrice());
+        put<double>(record, 16, product.getMargin());
+    }
+
+    static void writeRecord(char* record, const Product& product) {
+        put<int32_t>(record, 0, product.getId());
+        writeValues(record, product);
+        put<uint16_t>(record, 24, uint16_t(product.getName().size()));
+        put<uint16_t>(record, 26, uint16_t(product.getCategory().size()));
+        memcpy(record + recordFixed, product.getName().data(), product.getName().size());
+        memcpy(record + recordFixed + product.getName().size(), product.getCategory().data(),
+               product.getCategory().size());
+    }
+
+    // Bytes a record page could take, counting a new slot, once compacted.
+    static size_t roomIn(const char* page) {
+        size_t used = recordHeader + 2 * (size_t(countOf(page)) + 1) + get<uint16_t>(page, 6);
+        return used < pageSize ? pageSize - used : 0;
+    }
+
+    // Moves the live records together at the end of the page.
+    static void compact(char* page) {
+        char moved[pageSize];
+        size_t end = pageSize;
+        uint32_t slots = countOf(page);
+        for (uint32_t s = 0; s < slots; s++) {
+            uint16_t offset = get<uint16_t>(page, recordHeader + 2 * size_t(s));
+            if (offset == 0) continue;
+            size_t size = recordSize(page + offset);
+            end -= size;
+            memcpy(moved + end, page + offset, size);
+            put<uint16_t>(page, recordHeader + 2 * size_t(s), uint16_t(end));
+        }
+        memcpy(page + end, moved + end, pageSize - end);
+        put<uint16_t>(page, 4, uint16_t(end));
+    }
+
+    void added(const Product& product) {
+        double revenue = product.getPrice() * product.getQuantity();
+        header.totalRevenue += revenue;
+        header.totalProfit += revenue * (product.getMargin() / 100);
+    }
+
+    void removed(const Product& product) {
+        double revenue = product.getPrice() * product.getQuantity();
+        header.totalRevenue -= revenue;
+        header.totalProfit -= revenue * (product.getMargin() / 100);
+    }
+
+    void writeHeader() {
+        PageCache::Ref ref = cache.fetch(0);
+        char* p = ref.edit();
+        memcpy(p, magic, sizeof(magic));
+        put<uint32_t>(p, 8, uint32_t(pageSize));
+        put<uint32_t>(p, 12, header.root);
+        put<uint32_t>(p, 16, header.height);
+        put<uint32_t>(p, 20, header.firstLeaf);
+        put<uint32_t>(p, 24, header.fillPage);
+        put<uint32_t>(p, 28, header.clean);
+        put<uint64_t>(p, 32, header.count);
+        put<double>(p, 40, header.totalRevenue);
+        put<double>(p, 48, header.totalProfit);
+    }
+
+    bool readHeader() {
+        PageCache::Ref ref = cache.fetch(0);
+        const char* p = ref.data();
+        if (memcmp(p, magic, sizeof(magic)) != 0 || get<uint32_t>(p, 8) != pageSize) return false;
+        header.root = get<uint32_t>(p, 12);
+        header.height = get<uint32_t>(p, 16);
+        header.firstLeaf = get<uint32_t>(p, 20);
+        header.fillPage = get<uint32_t>(p, 24);
+        header.clean = get<uint32_t>(p, 28);
+        header.count = get<uint64_t>(p, 32);
+        header.totalRevenue = get<double>(p, 40);
+        header.totalProfit = get<double>(p, 48);
+        return header.root < cache.pages() && header.height > 0;
+    }
+
+    // Lays out an empty inventory: the header and one empty leaf. clean
+    // for a new file, which has nothing to lose; a reload into it is
+    // mid-change.
+    void format(bool clean) {
+        header = Header();
+        reusePages.clear();
+        reuseListed.clear();
+        cache.allocate();
+        PageCache::Ref leaf = cache.allocate();
+        put<uint16_t>(leaf.edit(), 0, LeafPage);
+        put<uint32_t>(leaf.edit(), 4, PageCache::noPage);
+        header.root = header.firstLeaf = leaf.page();
+        header.height = 1;
+        header.clean = clean ? 1 : 0;
+        writeHeader();
+    }
+
+    // Called before each change: the first one after a flush marks the
+    // file as changed, on disk, before any changed page can get there.
+    void touch() {
+        if (!header.clean) return;
+        header.clean = 0;
+        writeHeader();
+        cache.flush();
+    }
+
+    // The leaf that would hold id, recording the inner pages on the way in
+    // path when asked.
+    uint32_t descend(int id, bool record) {
+        if (record) path.clear();
+        uint32_t page = header.root;
+        for (uint32_t level = 1; level < header.height; level++) {
+            PageCache::Ref ref = cache.fetch(page);
+            const char* p = ref.data();
+            uint32_t child = upperBound(p, innerKeys, countOf(p), id);
+            if (record) path.push_back({page, child});
+            page = get<uint32_t>(p, innerChildren + 4 * size_t(child));
+        }
+        return page;
+    }
+
+    // Finds id's leaf and its entry there (or where it would go).
+    bool locate(int id, Location& at, bool record = false) {
+        at.leaf = descend(id, record);
+        PageCache::Ref ref = cache.fetch(at.leaf);
+        const char* p = ref.data();
+        uint32_t n = countOf(p);
+        at.index = lowerBound(p, leafKeys, n, id);
+        if (at.index == n || get<int32_t>(p, leafKeys + 4 * size_t(at.index)) != id) return false;
+        at.page = get<uint32_t>(p, leafPages + 4 * size_t(at.index));
+        at.slot = get<uint16_t>(p, leafSlots + 2 * size_t(at.index));
+        return true;
+    }
+
+    static void setEntry(char* leaf, uint32_t i, int id, uint32_t page, uint16_t slot) {
+        put<int32_t>(leaf, leafKeys + 4 * size_t(i), id);
+        put<uint32_t>(leaf, leafPages + 4 * size_t(i), page);
+        put<uint16_t>(leaf, leafSlots + 2 * size_t(i), slot);
+    }
+
+    // Moves entries [from, n) of a leaf by shift places.
+    static void shiftEntries(char* leaf, uint32_t from, uint32_t n, int shift) {
+        size_t count = n - from;
+        memmove(leaf + leafKeys + 4 * (size_t(from) + shift), leaf + leafKeys + 4 * size_t(from), 4 * count);
+        memmove(leaf + leafPages + 4 * (size_t(from) + shift), leaf + leafPages + 4 * size_t(from), 4 * count);
+        memmove(leaf + leafSlots + 2 * (size_t(from) + shift), leaf + leafSlots + 2 * size_t(from), 2 * count);
+    }
+
+    // Adds id's entry at at (from a locate() that recorded the path),
+    // splitting full pages up to the root. A page split at its end, as
+    // ascending ids do, is left full rather than half full.
+    void insertEntry(const Location& at, int id, uint32_t recordPage, uint16_t slot) {
+        PageCache::Ref ref = cache.fetch(at.leaf);
+        char* p = ref.edit();
+        uint32_t n = countOf(p);
+        if (n < leafCapacity) {
+            shiftEntries(p, at.index, n, 1);
+            setEntry(p, at.index, id, recordPage, slot);
+            put<uint16_t>(p, 2, uint16_t(n + 1));
+            return;
+        }
+        bool appending = at.index == n && get<uint32_t>(p, 4) == PageCache::noPage;
+        uint32_t total = n + 1;
+        uint32_t keep = appending ? n : total / 2;
+        PageCache::Ref right = cache.allocate();
+        char* r = right.edit();
+        put<uint16_t>(r, 0, LeafPage);
+        put<uint32_t>(r, 4, get<uint32_t>(p, 4));
+        put<uint32_t>(p, 4, right.page());
+        // Entry i of the leaf with the new one in place.
+        auto entry = [&](uint32_t i, int& key, uint32_t& page, uint16_t& s) {
+            if (i == at.index) {
+                key = id;
+                page = recordPage;
+                s = slot;
+                return;
+            }
+            uint32_t j = i < at.index ? i : i - 1;
+            key = get<int32_t>(p, leafKeys + 4 * size_t(j));
+            page = get<uint32_t>(p, leafPages + 4 * size_t(j));
+            s = get<uint16_t>(p, leafSlots + 2 * size_t(j));
+        };
+        for (uint32_t i = keep; i < total; i++) {
+            int key;
+            uint32_t page;
+            uint16_t s;
+            entry(i, key, page, s);
+            setEntry(r, i - keep, key, page, s);
+        }
+        if (at.index < keep) {
+            shiftEntries(p, at.index, keep - 1, 1);
+            setEntry(p, at.index, id, recordPage, slot);
+        }
+        put<uint16_t>(p, 2, uint16_t(keep));
+        put<uint16_t>(r, 2, uint16_t(total - keep));
+        int separator = get<int32_t>(r, leafKeys);
+        uint32_t rightPage = right.page();
+        ref.release();
+        right.release();
+        insertSeparator(separator, rightPage, appending);
+    }
+
+    // Adds (separator, child) to the parents along path, right of the child
+    // that was split.
+    void insertSeparator(int separator, uint32_t child, bool appending) {
+        vector<int32_t> keys;
+        vector<uint32_t> children;
+        while (!path.empty()) {
+            PathStep step = path.back();
+            path.pop_back();
+            PageCache::Ref ref = cache.fetch(step.page);
+            char* p = ref.edit();
+            uint32_t n = countOf(p);
+            keys.resize(n);
+            children.resize(n + 1);
+            memcpy(keys.data(), p + innerKeys, 4 * size_t(n));
+            memcpy(children.data(), p + innerChildren, 4 * size_t(n + 1));
+            keys.insert(keys.begin() + step.child, separator);
+            children.insert(children.begin() + step.child + 1, child);
+            if (n < innerCapacity) {
+                memcpy(p + innerKeys, keys.data(), 4 * keys.size());
+                memcpy(p + innerChildren, children.data(), 4 * children.size());
+                put<uint16_t>(p, 2, uint16_t(n + 1));
+                return;
+            }
+            // Key mid moves up; the left page keeps the keys before it.
+            uint32_t total = n + 1;
+            uint32_t mid = appending ? total - 1 : total / 2;
+            PageCache::Ref right = cache.allocate();
+            char* r = right.edit();
+            put<uint16_t>(r, 0, InnerPage);
+            put<uint16_t>(r, 2, uint16_t(total - mid - 1));
+            memcpy(r + innerKeys, keys.data() + mid + 1, 4 * size_t(total - mid - 1));
+            memcpy(r + innerChildren, children.data() + mid + 1, 4 * size_t(total - mid));
+            put<uint16_t>(p, 2, uint16_t(mid));
+            memcpy(p + innerKeys, keys.data(), 4 * size_t(mid));
+            memcpy(p + innerChildren, children.data(), 4 * size_t(mid + 1));
+            separator = keys[mid];
+            child = right.page();
+        }
+        PageCache::Ref root = cache.allocate();
+        char* p = root.edit();
+        put<uint16_t>(p, 0, InnerPage);
+        put<uint16_t>(p, 2, 1);
+        put<int32_t>(p, innerKeys, separator);
+        put<uint32_t>(p, innerChildren, header.root);
+        put<uint32_t>(p, innerChildren + 4, child);
+        header.root = root.page();
+        header.height++;
+    }
+
+    // Puts a record on ref's page if there is room.
+    static bool placeRecord(PageCache::Ref& ref, const Product& product, size_t size, uint16_t& slot) {
+        if (roomIn(ref.data()) < size) return false;
+        char* p = ref.edit();
+        uint32_t slots = countOf(p);
+        uint32_t s = 0;
+        while (s < slots && get<uint16_t>(p, recordHeader + 2 * size_t(s)) != 0) s++;
+        size_t slotEnd = recordHeader + 2 * size_t(s == slots ? slots + 1 : slots);
+        if (get<uint16_t>(p, 4) < slotEnd + size) compact(p);
+        uint16_t offset = uint16_t(get<uint16_t>(p, 4) - size);
+        writeRecord(p + offset, product);
+        put<uint16_t>(p, recordHeader + 2 * size_t(s), offset);
+        put<uint16_t>(p, 4, offset);
+        put<uint16_t>(p, 6, uint16_t(get<uint16_t>(p, 6) + size));
+        if (s == slots) put<uint16_t>(p, 2, uint16_t(slots + 1));
+        slot = uint16_t(s);
+        return true;
+    }
+
+    // Stores product's record; says where.
+    void storeRecord(const Product& product, uint32_t& page, uint16_t& slot) {
+        size_t size = recordBytes(product.getName(), product.getCategory());
+        if (header.fillPage != 0) {
+            PageCache::Ref ref = cache.fetch(header.fillPage);
+            if (placeRecord(ref, product, size, slot)) {
+                page = header.fillPage;
+                return;
+            }
+        }
+        while (!reusePages.empty()) {
+            PageCache::Ref ref = cache.fetch(reusePages.back());
+            if (placeRecord(ref, product, size, slot)) {
+                page = reusePages.back();
+                return;
+            }
+            reuseListed[reusePages.back()] = false;
+            reusePages.pop_back();
+        }
+        PageCache::Ref ref = cache.allocate();
+        char* p = ref.edit();
+        put<uint16_t>(p, 0, RecordPage);
+        put<uint16_t>(p, 4, uint16_t(pageSize));
+        header.fillPage = page = ref.page();
+        placeRecord(ref, product, size, slot);
+    }
+
+    void freeRecord(uint32_t page, uint16_t slot) {
+        PageCache::Ref ref = cache.fetch(page);
+        char* p = ref.edit();
+        size_t before = roomIn(p);
+        size_t offset = recordHeader + 2 * size_t(slot);
+        put<uint16_t>(p, 6, uint16_t(get<uint16_t>(p, 6) - recordSize(p + get<uint16_t>(p, offset))));
+        put<uint16_t>(p, offset, 0);
+        uint32_t slots = countOf(p);
+        while (slots > 0 && get<uint16_t>(p, recordHeader + 2 * size_t(slots - 1)) == 0) slots--;
+        put<uint16_t>(p, 2, uint16_t(slots));
+        // Listed as it crosses the mark, unless it still is from last time.
+        size_t mark = pageSize / 4;
+        if (page != header.fillPage && before < mark && roomIn(p) >= mark && reusePages.size() < maxReusePages) {
+            if (page >= reuseListed.size()) reuseListed.resize(size_t(page) + 1);
+            if (!reuseListed[page]) {
+                reuseListed[page] = true;
+                reusePages.push_back(page);
+            }
+        }
+    }
+
+    bool fits(const Product& product) {
+        if (product.getName().size() + product.getCategory().size() <= maxRecordText) return true;
+        *out << "Name and category are too long to store (" << maxRecordText << " bytes at most).\n";
+        return false;
+    }
+
+    // Runs change on a copy of id's product and writes back its price,
+    // quantity and margin. False if id is absent.
+    template <typename Change>
+    bool changeValues(int id, Change change) {
+        Location at;
+        if (!locate(id, at)) return false;
+        touch();
+        PageCache::Ref ref = cache.fetch(at.page);
+        char* p = ref.edit();
+        Product product = readRecord(p, at.slot);
+        removed(product);
+        change(product);
+        added(product);
+        writeValues(p + get<uint16_t>(p, recordHeader + 2 * size_t(at.slot)), product);
+        return true;
+    }
+
+    // Reads id's quantity without going through the find stats.
+    bool quantityOf(int id, int& quantity) {
+        Location at;
+        if (!locate(id, at)) return false;
+        PageCache::Ref ref = cache.fetch(at.page);
+        quantity = readRecord(ref.data(), at.slot).getQuantity();
+        return true;
+    }
+
+    bool reportUpdate(OpTimer& timer, bool found) {
+        if (!found) {
+            timer.miss();
+            *out << "ID does not exist.\n";
+        } else if (!quiet) {
+            *out << "Product updated successfully.\n";
+        }
+        return found;
+    }
+
+    // Adds product, or replaces the one with its id; no messages.
+    void upsert(const Product& product) {
+        Location at;
+        if (locate(product.getId(), at, true)) {
+            replace(at, product);
+            return;
+        }
+        uint32_t page;
+        uint16_t slot;
+        storeRecord(product, page, slot);
+        insertEntry(at, product.getId(), page, slot);
+        added(product);
+        header.count++;
+    }
+
+    void replace(const Location& at, const Product& product) {
+        PageCache::Ref ref = cache.fetch(at.page);
+        Product current = readRecord(ref.data(), at.slot);
+        removed(current);
+        added(product);
+        if (current.getName().size() == product.getName().size()
+            && current.getCategory().size() == product.getCategory().size()) {
+            char* p = ref.edit();
+            writeRecord(p + get<uint16_t>(p, recordHeader + 2 * size_t(at.slot)), product);
+            return;
+        }
+        ref.release();
+        freeRecord(at.page, at.slot);
+        uint32_t page;
+        uint16_t slot;
+        storeRecord(product, page, slot);
+        PageCache::Ref leaf = cache.fetch(at.leaf);
+        char* p = leaf.edit();
+        put<uint32_t>(p, leafPages + 4 * size_t(at.index), page);
+        put<uint16_t>(p, leafSlots + 2 * size_t(at.index), slot);
+    }
+
+    // Formats every product in id order into stream, a buffer at a time.
+    bool writeProducts(ostream& stream, ExportFormat format) {
+        TextBuffer text;
+        forEachProduct([&](const Product& product) {
+            formatProduct(text, product, format);
+            if (text.size() >= (size_t(1) << 16)) {
+                stream.write(text.data(), streamsize(text.size()));
+                text.clear();
+            }
+        });
+        stream.write(text.data(), streamsize(text.size()));
+        return bool(stream);
+    }
+
+    bool reportFailure(OpTimer& timer) {
+        if (!cache.failed()) return true;
+        timer.miss();
+        *out << "Error: " << cache.error() << '\n';
+        return false;
+    }
+
+public:
+    // cacheBytes of pages are cached; at least 16 pages.
+    explicit DiskInventory(size_t cacheBytes = size_t(64) << 20) : cacheBytes(cacheBytes) {}
+    DiskInventory(const DiskInventory&) = delete;
+    DiskInventory& operator=(const DiskInventory&) = delete;
+    ~DiskInventory() { close(); }
+
+    void setQuiet(bool quiet) { this->quiet = quiet; }
+    void setOutput(ostream& stream) { out = &stream; }
+    size_t size() const { return size_t(header.count); }
+    double getTotalRevenue() const { return header.totalRevenue; }
+    double getTotalProfit() const { return header.totalProfit; }
+    const PageCacheStats& cacheStats() const { return cache.stats(); }
+    bool isOpen() const { return cache.isOpen(); }
+
+    // Opens the inventory in file, creating it if it is missing or empty.
+    bool open(const string& file) {
+        close();
+        if (!cache.open(file, cacheBytes / pageSize)) {
+            *out << "Error: " << cache.error() << '\n';
+            return false;
+        }
+        filename = file;
+        header = Header();
+        reusePages.clear();
+        reuseListed.clear();
+        if (cache.pages() == 0) {
+            format(true);
+            cache.flush();
+        } else if (!readHeader()) {
+            *out << "Error: " << file << " is not a disk inventory.\n";
+            cache.close();
+            return false;
+        } else if (!header.clean) {
+            *out << "Warning: " << file << " was not closed cleanly; recent changes may be missing "
+                 << "or only partly there.\n";
+        }
+        if (!quiet) *out << "Opened " << file << ": " << size() << " products.\n";
+        return true;
+    }
+
+    // Writes every changed page and marks the file clean.
+    bool flush() {
+        if (!cache.isOpen()) return true;
+        header.clean = 1;
+        writeHeader();
+        if (cache.flush()) return true;
+        *out << "Error: " << cache.error() << '\n';
+        return false;
+    }
+
+    bool close() {
+        if (!cache.isOpen()) return true;
+        bool ok = flush();
+        cache.close();
+        return ok;
+    }
+
+    bool addProduct(Product product) {
+        OpTimer timer(StatOp::Add);
+        Location at;
+        if (locate(product.getId(), at, true)) {
+            timer.miss();
+            *out << "Id already exists.\n";
+            return false;
+        }
+        if (!fits(product)) {
+            timer.miss();
+            return false;
+        }
+        touch();
+        uint32_t page;
+        uint16_t slot;
+        storeRecord(product, page, slot);
+        insertEntry(at, product.getId(), page, slot);
+        added(product);
+        header.count++;
+        if (!reportFailure(timer)) return false;
+        if (!quiet) *out << "Product added successfully.\n";
+        return true;
+    }
+
+    bool removeProduct(int id) {
+        OpTimer timer(StatOp::Remove);
+        Location at;
+        if (!locate(id, at)) {
+            timer.miss();
+            *out << "Id does not exist.\n";
+            return false;
+        }
+        touch();
+        {
+            PageCache::Ref ref = cache.fetch(at.page);
+            removed(readRecord(ref.data(), at.slot));
+        }
+        freeRecord(at.page, at.slot);
+        PageCache::Ref leaf = cache.fetch(at.leaf);
+        char* p = leaf.edit();
+        uint32_t n = countOf(p);
+        shiftEntries(p, at.index + 1, n, -1);
+        put<uint16_t>(p, 2, uint16_t(n - 1));
+        header.count--;
+        if (!reportFailure(timer)) return false;
+        if (!quiet) *out << "Product removed successfully.\n";
+        return true;
+    }
+
+    // Unlike Inventory's, the product is a copy, valid until the next call.
+    const Product* findProduct(int id) {
+        OpTimer timer(StatOp::Find);
+        Location at;
+        if (!locate(id, at)) {
+            timer.miss();
+            return nullptr;
+        }
+        PageCache::Ref ref = cache.fetch(at.page);
+        Product product = readRecord(ref.data(), at.slot);
+        foundName.assign(product.getName());
+        foundCategory.assign(product.getCategory());
+        found = Product(id, foundName, foundCategory, product.getPrice(), product.getQuantity(), product.getMargin());
+        return &found;
+    }
+
+    // Calls visit with id's product, viewing the cached page; no copy.
+    template <typename Visitor>
+    bool readProduct(int id, Visitor visit) {
+        OpTimer timer(StatOp::Read);
+        Location at;
+        if (!locate(id, at)) {
+            timer.miss();
+            return false;
+        }
+        PageCache::Ref ref = cache.fetch(at.page);
+        visit(readRecord(ref.data(), at.slot));
+        return true;
+    }
+
+    bool updateProduct(int id, string_view name, string_view category, double price, int quantity, double margin) {
+        OpTimer timer(StatOp::Update);
+        Product product(id, name, category, price, quantity, margin);
+        Location at;
+        if (!locate(id, at)) return reportUpdate(timer, false);
+        if (!fits(product)) {
+            timer.miss();
+            return false;
+        }
+        touch();
+        replace(at, product);
+        if (!reportFailure(timer)) return false;
+        return reportUpdate(timer, true);
+    }
+
+    bool adjustQuantity(int id, int delta) {
+        OpTimer timer(StatOp::AdjustQuantity);
+        int quantity;
+        bool found = quantityOf(id, quantity);
+        if (found && !quantityFits(quantity, delta)) {
+            timer.miss();
+            *out << "Quantity out of range.\n";
+            return false;
+        }
+        return reportUpdate(timer, found && changeValues(id, [delta](Product& product) { product.setQuantity(product.getQuantity() + delta); }));
+    }
+
+    bool setPrice(int id, double price) {
+        OpTimer timer(StatOp::SetPrice);
+        return reportUpdate(timer, changeValues(id, [price](Product& product) { product.setPrice(price); }));
+    }
+
+    bool setMargin(int id, double margin) {
+        OpTimer timer(StatOp::SetMargin);
+        return reportUpdate(timer, changeValues(id, [margin](Product& product) { product.setMargin(margin); }));
+    }
+
+    // As Inventory::applyMovements. Sorting by id walks the index leaves in
+    // order, so each is read in once.
+    size_t applyMovements(vector<StockMovement>& movements) {
+        OpTimer timer(StatOp::ApplyMovements);
+        sortMovements(movements);
+        size_t applied = 0;
+        for (size_t i = 0, next; i < movements.size(); i = next) {
+            int id = movements[i].id;
+            long long delta = 0;
+            for (next = i; next < movements.size() && movements[next].id == id; next++) delta += movements[next].delta;
+            int quantity;
+            if (!quantityOf(id, quantity)) {
+                *out << "ID " << id << " does not exist.\n";
+            } else if (!quantityFits(quantity, delta)) {
+                *out << "ID " << id << " quantity out of range.\n";
+            } else {
+                changeValues(id, [delta](Product& product) { product.setQuantity(int(product.getQuantity() + delta)); });
+                applied += next - i;
+            }
+        }
+        Stats::count(StatCounter::MovementsApplied, applied);
+        if (applied < movements.size()) {
+            timer.miss();
+            Stats::count(StatCounter::MovementsSkipped, movements.size() - applied);
+        }
+        return applied;
+    }
+
+    // Visits every product in ascending id order. The product views the
+    // cached page and is only valid during the call, which must not change
+    // the inventory.
+    template <typename Visitor>
+    void forEachProduct(Visitor visit) {
+        for (uint32_t leafPage = header.firstLeaf; leafPage != PageCache::noPage;) {
+            PageCache::Ref leaf = cache.fetch(leafPage);
+            const char* p = leaf.data();
+            uint32_t n = countOf(p);
+            for (uint32_t i = 0; i < n; i++) {
+                PageCache::Ref record = cache.fetch(get<uint32_t>(p, leafPages + 4 * size_t(i)));
+                visit(readRecord(record.data(), get<uint16_t>(p, leafSlots + 2 * size_t(i))));
+            }
+            leafPage = get<uint32_t>(p, 4);
+        }
+    }
+
+    void printProducts() {
+        OpTimer timer(StatOp::Print);
+        if (size() == 0) {
+            *out << "No products in inventory.\n";
+        } else {
+            writeProducts(*out, ExportFormat::Text);
+        }
+        *out << "Total Inventory Value: Rs." << header.totalRevenue << '\n';
+        *out << "Estimated Profit: Rs." << header.totalProfit << '\n';
+    }
+
+    bool exportToFile(const string& file, ExportFormat format) {
+        OpTimer timer(StatOp::Export);
+        ofstream stream(file, ios::binary);
+        if (!stream.is_open()) {
+            timer.miss();
+            *out << "Error opening " << file << " for writing.\n";
+            return false;
+        }
+        bool ok = writeProducts(stream, format);
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(stream.tellp()))));
+        stream.close();
+        if (!ok || !stream) {
+            timer.miss();
+            *out << "Error writing " << file << '\n';
+            return false;
+        }
+        if (!quiet) *out << "Exported " << size() << " products.\n";
+        return true;
+    }
+
+    bool saveInventoryToFile(const string& file) {
+        OpTimer timer(StatOp::Save);
+        ofstream stream(file, ios::binary);
+        if (!stream.is_open()) {
+            timer.miss();
+            *out << "Error opening file for saving.\n";
+            return false;
+        }
+        bool ok = writeProducts(stream, ExportFormat::Csv);
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(stream.tellp()))));
+        stream.close();
+        if (!ok || !stream) {
+            timer.miss();
+            *out << "Error writing " << file << '\n';
+            return false;
+        }
+        if (!quiet) *out << "Inventory saved to file.\n";
+        return true;
+    }
+
+    // Replaces the contents with a saveInventoryToFile-format file, read a
+    // block at a time so it may be larger than memory. Later lines win for
+    // a repeated id. Files in id order, as saved, fill the index pages.
+    bool loadInventoryFromFile(const string& file) {
+        OpTimer timer(StatOp::Load);
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            timer.miss();
+            *out << "Error: Could not open file " << file << '\n';
+            return false;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        cache.truncate();
+        format(false);
+        cache.flush();
+        vector<char> buffer(size_t(1) << 20);
+        size_t held = 0;
+        size_t line = 0;
+        uint64_t bytes = 0;
+        size_t rejects = 0;
+        CsvFields row;
+        auto parse = [&](const char* begin, const char* end) {
+            line++;
+            if (!parseCsvLine(begin, end, row) || row.nameLength + row.categoryLength > maxRecordText) {
+                rejects++;
+                *out << "Invalid data in file, skipping line " << line << ".\n";
+                return;
+            }
+            upsert(Product(row.id, string_view(row.name, row.nameLength), string_view(row.category, row.categoryLength),
+                           row.price, row.quantity, row.margin));
+        };
+        for (;;) {
+            if (held == buffer.size()) buffer.resize(buffer.size() * 2);
+            ssize_t n = ::read(fd, buffer.data() + held, buffer.size() - held);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            bytes += uint64_t(n);
+            held += size_t(n);
+            const char* p = buffer.data();
+            const char* end = p + held;
+            while (const char* newline = static_cast<const char*>(memchr(p, '\n', size_t(end - p)))) {
+                parse(p, newline);
+                p = newline + 1;
+            }
+            held = size_t(end - p);
+            memmove(buffer.data(), p, held);
+        }
+        if (held > 0) parse(buffer.data(), buffer.data() + held);
+        ::close(fd);
+        Stats::count(StatCounter::BytesRead, bytes);
+        Stats::count(StatCounter::LoadRejects, rejects);
+        if (!reportFailure(timer)) return false;
+        if (!quiet) *out << "Inventory loaded from file.\n";
+        return true;
+    }
+
+    void printCacheStats() const {
+        const PageCacheStats& stats = cache.stats();
+        *out << "Page cache: " << cache.frameCount() << " pages of " << pageSize / 1024 << " KB, "
+             << cache.residentPages() << " in use, " << cache.dirtyPages() << " dirty\n";
+        *out << "Hits: " << stats.hits << ", misses: " << stats.misses << " (hit rate " << stats.hitRate() * 100
+             << "%)\n";
+        *out << "Evictions: " << stats.evictions << ", pages written back: " << stats.writebacks << '\n';
+    }
+
+    void printMemoryUsage() const {
+        OpTimer timer(StatOp::MemoryUsage);
+        const double mb = 1024.0 * 1024.0;
+        *out << "Products: " << size() << " in " << filename << ", " << cache.pages() << " pages ("
+             << double(cache.pages()) * pageSize / mb << " MB)\n";
+        *out << "Cache memory: " << cache.memoryBytes() / mb << " MB at most\n";
+        printCacheStats();
+    }
+};
+
+#endif
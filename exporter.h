@@ -0,0 +1,293 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "product.h"
+
+using namespace std;
+
+enum class ExportFormat {
+    Csv,        // saveInventoryToFile / loadInventoryFromFile lines
+    JsonLines,  // one JSON object per product
+    Text        // the printProducts layout
+};
+
+inline bool parseExportFormat(string_view name, ExportFormat& format) {
+    if (name == "csv") format = ExportFormat::Csv;
+    else if (name == "jsonl" || name == "json") format = ExportFormat::JsonLines;
+    else if (name == "text") format = ExportFormat::Text;
+    else return false;
+    return true;
+}
+
+// Append-only byte buffer that formats numbers in place with to_chars: no
+// locale, no stream state, and no allocation once it has grown to size.
+class TextBuffer {
+private:
+    vector<char> bytes;
+    size_t used = 0;
+
+    char* reserve(size_t n) {
+        if (used + n > bytes.size()) bytes.resize(max(bytes.size() * 2, used + n));
+        return bytes.data() + used;
+    }
+
+public:
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return used; }
+    void clear() { used = 0; }
+
+    void append(char c) {
+        *reserve(1) = c;
+        used++;
+    }
+
+    void append(string_view text) {
+        memcpy(reserve(text.size()), text.data(), text.size());
+        used += text.size();
+    }
+
+    void appendInt(long long value) {
+        char* p = reserve(24);
+        used = size_t(to_chars(p, p + 24, value).ptr - bytes.data());
+    }
+
+    // What ostream << value prints by default (printf's %g with 6
+    // significant digits), so these files match the ones written before.
+    void appendDouble(double value) {
+        char* p = reserve(32);
+        used = size_t(to_chars(p, p + 32, value, chars_format::general, 6).ptr - bytes.data());
+    }
+
+    // The shortest text that reads back as exactly value.
+    void appendExactDouble(double value) {
+        char* p = reserve(32);
+        used = size_t(to_chars(p, p + 32, value).ptr - bytes.data());
+    }
+};
+
+inline void appendJsonString(TextBuffer& out, string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out.append('"');
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        uint8_t c = uint8_t(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out.append(text.substr(run, i - run));
+        run = i + 1;
+        out.append('\\');
+        switch (c) {
+            case '"': out.append('"'); break;
+            case '\\': out.append('\\'); break;
+            case '\n': out.append('n'); break;
+            case '\r': out.append('r'); break;
+            case '\t': out.append('t'); break;
+            default:
+                out.append("u00");
+                out.append(hex[c >> 4]);
+                out.append(hex[c & 15]);
+        }
+    }
+    out.append(text.substr(run));
+    out.append('"');
+}
+
+// JSON has no inf or nan.
+inline void appendJsonNumber(TextBuffer& out, double value) {
+    if (isfinite(value)) out.appendExactDouble(value);
+    else out.append("null");
+}
+
+inline void formatProduct(TextBuffer& out, const Product& product, ExportFormat format) {
+    switch (format) {
+        case ExportFormat::Csv:
+            out.appendInt(product.getId());
+            out.append(',');
+            out.append(product.getName());
+            out.append(',');
+            out.append(product.getCategory());
+            out.append(',');
+            out.appendDouble(product.getPrice());
+            out.append(',');
+            out.appendInt(product.getQuantity());
+            out.append(',');
+            out.appendDouble(product.getMargin());
+            out.append('\n');
+            break;
+        case ExportFormat::JsonLines:
+            out.append("{\"id\":");
+            out.appendInt(product.getId());
+            out.append(",\"name\":");
+            appendJsonString(out, product.getName());
+            out.append(",\"category\":");
+            appendJsonString(out, product.getCategory());
+            out.append(",\"price\":");
+            appendJsonNumber(out, product.getPrice());
+            out.append(",\"quantity\":");
+            out.appendInt(product.getQuantity());
+            out.append(",\"margin\":");
+            appendJsonNumber(out, product.getMargin());
+            out.append("}\n");
+            break;
+        case ExportFormat::Text:
+            out.append("-------------------------------------------\nID: ");
+            out.appendInt(product.getId());
+            out.append("\nName: ");
+            out.append(product.getName());
+            out.append("\nCategory: ");
+            out.append(product.getCategory());
+            out.append("\nPrice: $");
+            out.appendDouble(product.getPrice());
+            out.append("\nQuantity: ");
+            out.appendInt(product.getQuantity());
+            out.append("\nMargin: ");
+            out.appendDouble(product.getMargin());
+            out.append("%\n-------------------------------------------\n");
+            break;
+    }
+}
+
+// Writes products to a stream in one of the export formats, in the order
+// they are added. Rows are gathered into chunks; worker threads format
+// whole chunks into their own buffers and a writer thread hands the
+// buffers to the stream in chunk order, one write() each. A ring of 2 x
+// workers chunks bounds memory and keeps the caller, the formatters and
+// the writer busy at once.
+//
+// Products are copied into the chunk, so their own storage may change
+// after add() returns, but the strings they view must stay put until
+// finish() returns. Exports of a chunk or less never start a thread.
+class ProductExporter {
+public:
+    static constexpr size_t chunkRows = 16384;
+
+private:
+    enum class ChunkState { Free, Filled, Formatted };
+
+    struct Chunk {
+        vector<Product> rows;
+        TextBuffer text;
+        ChunkState state = ChunkState::Free;
+    };
+
+    ostream& out;
+    ExportFormat format;
+    size_t workerCount;
+    vector<Chunk> ring;
+    size_t submitted = 0;  // chunks handed to the workers
+    size_t claimed = 0;    // chunks a worker has started on
+    size_t written = 0;    // chunks written out
+    size_t rowCount = 0;
+    bool closing = false;
+    mutex lock;
+    condition_variable changed;
+    vector<thread> threads;
+
+    Chunk& current() { return ring[submitted % ring.size()]; }
+
+    void formatChunk(Chunk& chunk) {
+        chunk.text.clear();
+        for (const Product& product : chunk.rows) formatProduct(chunk.text, product, format);
+    }
+
+    void work() {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            changed.wait(guard, [this] { return claimed < submitted || closing; });
+            if (claimed == submitted) return;
+            Chunk& chunk = ring[claimed++ % ring.size()];
+            guard.unlock();
+            formatChunk(chunk);
+            guard.lock();
+            chunk.state = ChunkState::Formatted;
+            changed.notify_all();
+        }
+    }
+
+    void writeOut() {
+        unique_lock<mutex> guard(lock);
+        for (;;) {
+            Chunk* chunk = &ring[written % ring.size()];
+            changed.wait(guard, [&] { return chunk->state == ChunkState::Formatted || (closing && written == submitted); });
+            if (chunk->state != ChunkState::Formatted) return;
+            guard.unlock();
+            out.write(chunk->text.data(), streamsize(chunk->text.size()));
+            guard.lock();
+            chunk->rows.clear();
+            chunk->state = ChunkState::Free;
+            written++;
+            changed.notify_all();
+        }
+    }
+
+    void submit() {
+        if (threads.empty()) {
+            for (size_t i = 0; i < workerCount; i++) threads.emplace_back(&ProductExporter::work, this);
+            threads.emplace_back(&ProductExporter::writeOut, this);
+        }
+        unique_lock<mutex> guard(lock);
+        current().state = ChunkState::Filled;
+        submitted++;
+        changed.notify_all();
+        changed.wait(guard, [this] { return current().state == ChunkState::Free; });
+    }
+
+public:
+    // workers 0 uses one per hardware thread.
+    ProductExporter(ostream& out, ExportFormat format, size_t workers = 0)
+        : out(out), format(format), workerCount(workers ? workers : max(1u, thread::hardware_concurrency())),
+          ring(2 * workerCount) {}
+
+    ProductExporter(const ProductExporter&) = delete;
+    ProductExporter& operator=(const ProductExporter&) = delete;
+    ~ProductExporter() { finish(); }
+
+    size_t rows() const { return rowCount; }
+
+    void add(const Product& product) {
+        Chunk& chunk = current();
+        if (chunk.rows.capacity() == 0) chunk.rows.reserve(chunkRows);
+        chunk.rows.push_back(product);
+        rowCount++;
+        if (chunk.rows.size() == chunkRows) submit();
+    }
+
+    // Writes whatever is left and waits for the threads; returns whether
+    // the stream took everything.
+    bool finish() {
+        Chunk& last = current();
+        if (threads.empty()) {
+            if (!last.rows.empty()) {
+                formatChunk(last);
+                out.write(last.text.data(), streamsize(last.text.size()));
+                last.rows.clear();
+            }
+            return bool(out);
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            if (!last.rows.empty()) {
+                last.state = ChunkState::Filled;
+                submitted++;
+            }
+            closing = true;
+        }
+        changed.notify_all();
+        for (thread& t : threads) t.join();
+        threads.clear();
+        return bool(out);
+    }
+};
+
+#endif
@@ -0,0 +1,669 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <climits>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "product.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+#include "wal.h"
+
+using namespace std;
+
+// History times are milliseconds since the Unix epoch. Every change reads
+// the clock, so where there is one this is the coarse clock: accurate to a
+// kernel tick (a few ms) and several times cheaper to read.
+inline int64_t historyClock() {
+#ifdef CLOCK_REALTIME_COARSE
+    timespec now;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &now) == 0) return int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+#endif
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Local time as "YYYY-MM-DD HH:MM:SS.mmm".
+inline string formatHistoryTime(int64_t time) {
+    time_t seconds = time_t(time / 1000 - (time % 1000 < 0));
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[40];
+    size_t n = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(text + n, sizeof(text) - n, ".%03d", int((time % 1000 + 1000) % 1000));
+    return text;
+}
+
+// Accepts "now", "@<seconds since the epoch>", or local time as
+// "YYYY-MM-DD" (the start of the day), "YYYY-MM-DD HH:MM" or
+// "YYYY-MM-DD HH:MM:SS", with 'T' or a space between date and time.
+inline bool parseHistoryTime(string_view text, int64_t& time) {
+    if (text == "now") {
+        time = historyClock();
+        return true;
+    }
+    string s(text);
+    if (!s.empty() && s[0] == '@') {
+        char* end;
+        long long seconds = strtoll(s.c_str() + 1, &end, 10);
+        if (end == s.c_str() + 1 || *end) return false;
+        time = seconds * 1000;
+        return true;
+    }
+    struct tm local;
+    memset(&local, 0, sizeof(local));
+    int consumed = 0;
+    if (sscanf(s.c_str(), "%d-%d-%d%n", &local.tm_year, &local.tm_mon, &local.tm_mday, &consumed) != 3) return false;
+    if (size_t(consumed) < s.size()) {
+        char separator = s[size_t(consumed)];
+        int more = 0;
+        if ((separator != 'T' && separator != ' ')
+            || sscanf(s.c_str() + consumed + 1, "%d:%d%n", &local.tm_hour, &local.tm_min, &more) != 2) {
+            return false;
+        }
+        consumed += 1 + more;
+        if (size_t(consumed) < s.size()) {
+            if (sscanf(s.c_str() + consumed, ":%d%n", &local.tm_sec, &more) != 1) return false;
+            consumed += more;
+        }
+        if (size_t(consumed) != s.size()) return false;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    time_t seconds = mktime(&local);
+    if (seconds == time_t(-1)) return false;
+    time = int64_t(seconds) * 1000;
+    return true;
+}
+
+// A product's price, quantity and margin at one point in time.
+struct HistoryPoint {
+    int64_t time = 0;
+    bool exists = false;
+    int quantity = 0;
+    double price = 0;
+    double margin = 0;
+};
+
+struct TotalsPoint {
+    int64_t time = 0;
+    double totalRevenue = 0;
+    double totalProfit = 0;
+};
+
+// Price, quantity and margin history of every product, plus the inventory
+// totals, with as-of queries. Name and category changes are not recorded.
+//
+// Each product has a series of changes, each record encoded against the
+// one before it:
+//
+//   flags | zigzag varint(time delta-of-delta)
+//         [| zigzag varint(quantity delta)] [| price] [| margin]
+//
+// A changed double is XORed with the previous value and written as the
+// varint count of trailing zero bits, then the varint of the rest, so a
+// price moving by a round amount takes two or three bytes. The totals are
+// a series of the same kind, one record per millisecond that had changes.
+//
+// Every 32 records (64 for the totals) a checkpoint keeps the decoder's
+// state. An as-of query is a binary search over the checkpoints plus
+// decoding at most one checkpoint's worth of records.
+//
+// Opened on a file, the store also appends every change there, staged in
+// memory and written as one block per commit:
+//
+//   "EKHIST1\0", then blocks of uint32 length | uint32 crc32(payload) | payload
+//   payload = zigzag varint(time delta-of-delta) | zigzag varint(id delta)
+//             | flags and values as above
+//
+// Opening replays the file into memory; a torn last block is cut off, as
+// with the write-ahead log.
+class HistoryStore {
+private:
+    static constexpr char magic[8] = {'E', 'K', 'H', 'I', 'S', 'T', '1', '\0'};
+    static constexpr uint32_t productCheckpointEvery = 32;
+    static constexpr uint32_t totalsCheckpointEvery = 64;
+    // Commit on our own once this much is staged.
+    static constexpr size_t maxStaged = size_t(1) << 20;
+
+    enum : uint8_t { Exists = 1, QuantityChanged = 2, PriceChanged = 4, MarginChanged = 8 };
+
+    static uint64_t zigzag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+    static int64_t unzigzag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+
+    static uint64_t bitsOf(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static double doubleOf(uint64_t bits) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Readers for the file, which may be torn or damaged.
+    static bool getVarintChecked(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end) return false;
+            uint8_t byte = *p++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Delta-of-delta timestamps.
+    struct TimeCoder {
+        int64_t time = 0;
+        int64_t delta = 0;
+
+        void put(vector<uint8_t>& out, int64_t next) {
+            int64_t nextDelta = next - time;
+            putVarint(out, zigzag(nextDelta - delta));
+            delta = nextDelta;
+            time = next;
+        }
+
+        template <typename Get>
+        bool get(Get getNext) {
+            uint64_t value;
+            if (!getNext(value)) return false;
+            delta += unzigzag(value);
+            time += delta;
+            return true;
+        }
+    };
+
+    // Price and margin as bits, so unchanged values compare exactly.
+    struct Values {
+        uint64_t price = 0;
+        uint64_t margin = 0;
+        int quantity = 0;
+        bool exists = false;
+
+        double revenue() const { return exists ? doubleOf(price) * quantity : 0; }
+        double profit() const { return revenue() * (doubleOf(margin) / 100); }
+    };
+
+    static void putDouble(vector<uint8_t>& out, uint64_t before, uint64_t after) {
+        uint64_t x = before ^ after;
+        int zeros = x ? __builtin_ctzll(x) : 64;
+        putVarint(out, uint64_t(zeros));
+        if (x) putVarint(out, x >> zeros);
+    }
+
+    template <typename Get>
+    static bool getDouble(Get getNext, uint64_t& value) {
+        uint64_t zeros, rest;
+        if (!getNext(zeros) || zeros > 64) return false;
+        if (zeros == 64) return true;
+        if (!getNext(rest)) return false;
+        value ^= rest << zeros;
+        return true;
+    }
+
+    static uint8_t flagsFor(const Values& before, const Values& after) {
+        uint8_t flags = after.exists ? Exists : 0;
+        if (!after.exists) return flags;
+        if (after.quantity != before.quantity) flags |= QuantityChanged;
+        if (after.price != before.price) flags |= PriceChanged;
+        if (after.margin != before.margin) flags |= MarginChanged;
+        return flags;
+    }
+
+    static void putValues(vector<uint8_t>& out, uint8_t flags, const Values& before, const Values& after) {
+        if (flags & QuantityChanged) putVarint(out, zigzag(int64_t(after.quantity) - before.quantity));
+        if (flags & PriceChanged) putDouble(out, before.price, after.price);
+        if (flags & MarginChanged) putDouble(out, before.margin, after.margin);
+    }
+
+    template <typename Get>
+    static bool getValues(Get getNext, uint8_t flags, Values& values) {
+        values.exists = flags & Exists;
+        uint64_t value;
+        if (flags & QuantityChanged) {
+            if (!getNext(value)) return false;
+            int64_t quantity = int64_t(values.quantity) + unzigzag(value);
+            if (quantity < INT_MIN || quantity > INT_MAX) return false;
+            values.quantity = int(quantity);
+        }
+        if ((flags & PriceChanged) && !getDouble(getNext, values.price)) return false;
+        if ((flags & MarginChanged) && !getDouble(getNext, values.margin)) return false;
+        return true;
+    }
+
+    struct ProductCheckpoint {
+        TimeCoder clock;
+        uint32_t offset;
+        Values values;
+    };
+
+    // What a change touches comes first, to share a cache line.
+    struct Series {
+        vector<uint8_t> bytes;
+        // The state after the last record, to encode the next against.
+        TimeCoder clock;
+        Values values;
+        uint32_t records = 0;
+        // The state before the record at offset, for every
+        // productCheckpointEvery-th record after the first.
+        vector<ProductCheckpoint> checkpoints;
+    };
+
+    struct TotalsCheckpoint {
+        TimeCoder clock;
+        uint32_t offset;
+        uint64_t revenue;
+        uint64_t profit;
+    };
+
+    struct Change {
+        int64_t time;
+        int id;
+        Values after;
+    };
+
+    unordered_map<int, Series> series;
+    size_t changes = 0;
+    static constexpr size_t foldEvery = 65536;
+    vector<Change> queued;
+    bool replaying = false;
+
+    // Totals series. The current millisecond's totals stay open until a
+    // later change, so a burst of changes takes one record.
+    vector<uint8_t> totalsBytes;
+    vector<TotalsCheckpoint> totalsCheckpoints;
+    TimeCoder totalsClock;
+    uint64_t totalsRevenue = 0;
+    uint64_t totalsProfit = 0;
+    size_t totalsRecords = 0;
+    bool hasOpenTotals = false;
+    TotalsPoint openTotals;
+    double revenue = 0;
+    double profit = 0;
+
+    // Latest time so far; times never go backwards, even if the clock does.
+    int64_t lastTime = INT64_MIN;
+
+    // The file, when open.
+    int fd = -1;
+    vector<uint8_t> staged;
+    TimeCoder fileClock;
+    int fileId = 0;
+
+    void flushTotals() {
+        if (!hasOpenTotals) return;
+        if (totalsRecords > 0 && totalsRecords % totalsCheckpointEvery == 0) {
+            totalsCheckpoints.push_back({totalsClock, uint32_t(totalsBytes.size()), totalsRevenue, totalsProfit});
+        }
+        totalsClock.put(totalsBytes, openTotals.time);
+        uint64_t revenueBits = bitsOf(openTotals.totalRevenue), profitBits = bitsOf(openTotals.totalProfit);
+        putDouble(totalsBytes, totalsRevenue, revenueBits);
+        putDouble(totalsBytes, totalsProfit, profitBits);
+        totalsRevenue = revenueBits;
+        totalsProfit = profitBits;
+        totalsRecords++;
+        hasOpenTotals = false;
+    }
+
+    // Records id's new values at time. Changes are queued and folded into
+    // the series in batches, sorted by id, so the series are walked in
+    // order instead of at random.
+    void apply(int64_t time, int id, const Values& after) {
+        lastTime = max(time, lastTime);
+        queued.push_back({lastTime, id, after});
+        if (queued.size() >= foldEvery && !replaying) fold();
+    }
+
+    // Encodes the queued changes: into the product series in id order, then
+    // into the totals and the file in the order they came. A change to
+    // nothing is dropped.
+    void fold() {
+        if (queued.empty()) return;
+        size_t n = queued.size();
+        vector<uint64_t> order(n);
+        for (size_t i = 0; i < n; i++) order[i] = uint64_t(uint32_t(queued[i].id) ^ 0x80000000u) << 32 | i;
+        sort(order.begin(), order.end());
+
+        const uint8_t dropped = 0xFF;
+        vector<Values> before(n);
+        vector<uint8_t> flags(n, dropped);
+        Series* s = nullptr;
+        for (size_t k = 0; k < n; k++) {
+            size_t i = uint32_t(order[k]);
+            const Change& change = queued[i];
+            if (!s || k == 0 || queued[uint32_t(order[k - 1])].id != change.id) {
+                auto it = series.find(change.id);
+                if (it == series.end() && change.after.exists) {
+                    it = series.emplace(change.id, Series()).first;
+                    it->second.bytes.reserve(16);
+                }
+                s = it == series.end() ? nullptr : &it->second;
+            }
+            if (!s) continue;
+            uint8_t f = flagsFor(s->values, change.after);
+            if ((f == Exists && s->values.exists) || (!change.after.exists && !s->values.exists)) continue;
+            before[i] = s->values;
+            flags[i] = f;
+            if (s->records > 0 && s->records % productCheckpointEvery == 0) {
+                s->checkpoints.push_back({s->clock, uint32_t(s->bytes.size()), s->values});
+            }
+            s->bytes.push_back(f);
+            s->clock.put(s->bytes, change.time);
+            putValues(s->bytes, f, s->values, change.after);
+            // Keep the old values on removal; a later add encodes against them.
+            Values next = change.after.exists ? change.after : s->values;
+            next.exists = change.after.exists;
+            s->values = next;
+            s->records++;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (flags[i] == dropped) continue;
+            const Change& change = queued[i];
+            if (fd >= 0) {
+                fileClock.put(staged, change.time);
+                putVarint(staged, zigzag(int64_t(change.id) - fileId));
+                fileId = change.id;
+                staged.push_back(flags[i]);
+                putValues(staged, flags[i], before[i], change.after);
+            }
+            revenue += change.after.revenue() - before[i].revenue();
+            profit += change.after.profit() - before[i].profit();
+            if (hasOpenTotals && change.time > openTotals.time) flushTotals();
+            openTotals = {change.time, revenue, profit};
+            hasOpenTotals = true;
+            changes++;
+        }
+        queued.clear();
+        if (staged.size() >= maxStaged) commit();
+    }
+
+    static Values valuesOf(const Product& product) {
+        Values values;
+        values.exists = true;
+        values.quantity = product.getQuantity();
+        values.price = bitsOf(product.getPrice());
+        values.margin = bitsOf(product.getMargin());
+        return values;
+    }
+
+    static HistoryPoint pointOf(int64_t time, const Values& values) {
+        HistoryPoint point;
+        point.time = time;
+        point.exists = values.exists;
+        point.quantity = values.quantity;
+        point.price = doubleOf(values.price);
+        point.margin = doubleOf(values.margin);
+        return point;
+    }
+
+    bool writeAll(const uint8_t* p, size_t left) {
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            left -= size_t(n);
+        }
+        return true;
+    }
+
+    // Replays path into memory. Returns false if it is not a history file.
+    bool replay(const string& path) {
+        MappedFile file;
+        if (!file.open(path, true)) return errno == ENOENT;
+        if (file.size() == 0) return true;
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(file.data());
+        const uint8_t* end = begin + file.size();
+        if (file.size() < sizeof(magic) || memcmp(begin, magic, sizeof(magic)) != 0) return false;
+        const uint8_t* p = begin + sizeof(magic);
+        replaying = true;
+        // The latest values of the ids in the block, which the queue may
+        // not have folded into their series yet.
+        unordered_map<int, Values> latest;
+        while (size_t(end - p) >= 8) {
+            uint32_t length, crc;
+            memcpy(&length, p, 4);
+            memcpy(&crc, p + 4, 4);
+            if (size_t(end - p - 8) < length) break;
+            const uint8_t* q = p + 8;
+            const uint8_t* blockEnd = q + length;
+            if (crc32(q, length) != crc) break;
+            auto getNext = [&q, blockEnd](uint64_t& value) { return getVarintChecked(q, blockEnd, value); };
+            TimeCoder clock = fileClock;
+            int id = fileId;
+            bool ok = true;
+            while (ok && q < blockEnd) {
+                uint64_t idDelta;
+                ok = clock.get(getNext) && getNext(idDelta) && q < blockEnd;
+                if (!ok) break;
+                id = int(int64_t(id) + unzigzag(idDelta));
+                uint8_t flags = *q++;
+                auto known = latest.find(id);
+                if (known == latest.end()) {
+                    auto it = series.find(id);
+                    known = latest.emplace(id, it == series.end() ? Values() : it->second.values).first;
+                }
+                ok = getValues(getNext, flags, known->second);
+                if (ok) apply(clock.time, id, known->second);
+            }
+            // CRC-checked blocks only fail to decode if written by something
+            // else; stop there like at a torn block.
+            if (!ok) {
+                queued.clear();
+                break;
+            }
+            fold();
+            latest.clear();
+            fileClock = clock;
+            fileId = id;
+            p = blockEnd;
+        }
+        replaying = false;
+        if (p != end) {
+            size_t good = size_t(p - begin);
+            file.close();
+            if (::truncate(path.c_str(), off_t(good)) != 0) return false;
+        }
+        return true;
+    }
+
+public:
+    HistoryStore() {}
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+    ~HistoryStore() { close(); }
+
+    // Loads the history in path, if any, and appends to it from now on.
+    bool open(const string& path) {
+        close();
+        if (!replay(path)) return false;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (st.st_size == 0 && !writeAll(reinterpret_cast<const uint8_t*>(magic), sizeof(magic)))) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Writes the changes staged since the last commit as one block.
+    bool commit() {
+        fold();
+        if (fd < 0 || staged.empty()) return true;
+        uint32_t length = uint32_t(staged.size());
+        uint32_t crc = crc32(staged.data(), staged.size());
+        uint8_t header[8];
+        memcpy(header, &length, 4);
+        memcpy(header + 4, &crc, 4);
+        bool ok = writeAll(header, sizeof(header)) && writeAll(staged.data(), staged.size());
+        staged.clear();
+        return ok;
+    }
+
+    void close() {
+        if (fd < 0) return;
+        commit();
+        fdatasync(fd);
+        ::close(fd);
+        fd = -1;
+    }
+
+    void record(int64_t time, const Product& product) { apply(time, product.getId(), valuesOf(product)); }
+
+    void recordRemove(int64_t time, int id) { apply(time, id, Values()); }
+
+    // Records the inventory as a whole: forEach(visit) must call visit with
+    // every product. Products that changed are recorded and those no longer
+    // there are recorded as removed; the rest cost nothing.
+    template <typename ForEach>
+    void recordAll(int64_t time, ForEach forEach) {
+        fold();
+        unordered_set<int> present;
+        forEach([&](const Product& product) {
+            present.insert(product.getId());
+            record(time, product);
+        });
+        vector<int> gone;
+        for (const auto& entry : series) {
+            if (entry.second.values.exists && !present.count(entry.first)) gone.push_back(entry.first);
+        }
+        sort(gone.begin(), gone.end());
+        for (int id : gone) recordRemove(time, id);
+    }
+
+    // id's values as of time (exists is false if it did not exist then).
+    HistoryPoint productAt(int id, int64_t time) {
+        fold();
+        auto it = series.find(id);
+        if (it == series.end()) return HistoryPoint();
+        const Series& s = it->second;
+        auto checkpoint = upper_bound(s.checkpoints.begin(), s.checkpoints.end(), time,
+                                      [](int64_t t, const ProductCheckpoint& c) { return t < c.clock.time; });
+        TimeCoder clock;
+        Values values;
+        const uint8_t* p = s.bytes.data();
+        if (checkpoint != s.checkpoints.begin()) {
+            --checkpoint;
+            clock = checkpoint->clock;
+            values = checkpoint->values;
+            p += checkpoint->offset;
+        }
+        const uint8_t* end = s.bytes.data() + s.bytes.size();
+        int64_t at = clock.time;
+        auto getNext = [&p](uint64_t& value) { p = getVarint(p, value); return true; };
+        while (p < end) {
+            uint8_t flags = *p++;
+            clock.get(getNext);
+            if (clock.time > time) break;
+            getValues(getNext, flags, values);
+            at = clock.time;
+        }
+        return pointOf(at, values);
+    }
+
+    // Every recorded change of id from..to (inclusive), oldest first; each
+    // point holds the values after the change.
+    vector<HistoryPoint> productHistory(int id, int64_t from = INT64_MIN, int64_t to = INT64_MAX) {
+        fold();
+        vector<HistoryPoint> points;
+        auto it = series.find(id);
+        if (it == series.end()) return points;
+        const Series& s = it->second;
+        auto checkpoint = lower_bound(s.checkpoints.begin(), s.checkpoints.end(), from,
+                                      [](const ProductCheckpoint& c, int64_t t) { return c.clock.time < t; });
+        TimeCoder clock;
+        Values values;
+        const uint8_t* p = s.bytes.data();
+        if (checkpoint != s.checkpoints.begin()) {
+            --checkpoint;
+            clock = checkpoint->clock;
+            values = checkpoint->values;
+            p += checkpoint->offset;
+        }
+        const uint8_t* end = s.bytes.data() + s.bytes.size();
+        auto getNext = [&p](uint64_t& value) { p = getVarint(p, value); return true; };
+        while (p < end) {
+            uint8_t flags = *p++;
+            clock.get(getNext);
+            if (clock.time > to) break;
+            getValues(getNext, flags, values);
+            if (clock.time >= from) points.push_back(pointOf(clock.time, values));
+        }
+        return points;
+    }
+
+    // Inventory totals as of time (zero before the first change). time in
+    // the result is when they last changed.
+    TotalsPoint totalsAt(int64_t time) {
+        fold();
+        if (hasOpenTotals && openTotals.time <= time) return openTotals;
+        auto checkpoint = upper_bound(totalsCheckpoints.begin(), totalsCheckpoints.end(), time,
+                                      [](int64_t t, const TotalsCheckpoint& c) { return t < c.clock.time; });
+        TimeCoder clock;
+        uint64_t revenueBits = 0, profitBits = 0;
+        const uint8_t* p = totalsBytes.data();
+        if (checkpoint != totalsCheckpoints.begin()) {
+            --checkpoint;
+            clock = checkpoint->clock;
+            revenueBits = checkpoint->revenue;
+            profitBits = checkpoint->profit;
+            p += checkpoint->offset;
+        }
+        const uint8_t* end = totalsBytes.data() + totalsBytes.size();
+        int64_t at = clock.time;
+        auto getNext = [&p](uint64_t& value) { p = getVarint(p, value); return true; };
+        while (p < end) {
+            clock.get(getNext);
+            if (clock.time > time) break;
+            getDouble(getNext, revenueBits);
+            getDouble(getNext, profitBits);
+            at = clock.time;
+        }
+        return {at, doubleOf(revenueBits), doubleOf(profitBits)};
+    }
+
+    size_t productCount() const { return series.size(); }
+    size_t changeCount() const { return changes; }
+
+    // Encoded bytes, products and totals.
+    size_t encodedBytes() const {
+        size_t bytes = totalsBytes.size();
+        for (const auto& entry : series) bytes += entry.second.bytes.size();
+        return bytes;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = totalsBytes.capacity() + totalsCheckpoints.capacity() * sizeof(TotalsCheckpoint)
+            + staged.capacity() + queued.capacity() * sizeof(Change) + series.bucket_count() * sizeof(void*);
+        for (const auto& entry : series) {
+            const Series& s = entry.second;
+            // Hash node: next pointer, key, value.
+            bytes += sizeof(void*) + sizeof(pair<const int, Series>) + s.bytes.capacity()
+                + s.checkpoints.capacity() * sizeof(ProductCheckpoint);
+        }
+        return bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,1629 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <climits>
+#include "product_index.h"
+#include "csv_loader.h"
+#include "csv_merge.h"
+#include "inventory_diff.h"
+#include "snapshot.h"
+#include "wal.h"
+#include "category_index.h"
+#include "string_pool.h"
+#include "product_columns.h"
+#include "product_query.h"
+#include "order_index.h"
+#include "name_index.h"
+#include "reorder_index.h"
+#include "exporter.h"
+#include "stats.h"
+#include "autosave.h"
+#include "history.h"
+
+using namespace std;
+
+// Units received (delta > 0) or sold (delta < 0) of one product.
+struct StockMovement {
+    int id;
+    int delta;
+};
+
+// Whether quantity + delta stays in the int range. Changes that would not
+// are rejected rather than wrapped, as the CSV merge does.
+inline bool quantityFits(int quantity, long long delta) {
+    long long total = quantity + delta;
+    return total >= INT_MIN && total <= INT_MAX;
+}
+
+// Stable LSD radix sort by id, a byte per pass. Passes where every id has
+// the same byte are skipped, so ids below 2^16 take two passes.
+inline void sortMovements(vector<StockMovement>& movements) {
+    if (movements.size() < 256) {
+        stable_sort(movements.begin(), movements.end(),
+                    [](const StockMovement& a, const StockMovement& b) { return a.id < b.id; });
+        return;
+    }
+    // Flipping the sign bit makes unsigned byte order match int order.
+    auto key = [](const StockMovement& m) { return uint32_t(m.id) ^ 0x80000000u; };
+    size_t counts[4][256] = {};
+    for (const StockMovement& m : movements) {
+        uint32_t k = key(m);
+        for (int pass = 0; pass < 4; pass++) counts[pass][(k >> (8 * pass)) & 0xFF]++;
+    }
+    vector<StockMovement> scratch(movements.size());
+    for (int pass = 0; pass < 4; pass++) {
+        size_t* count = counts[pass];
+        if (count[(key(movements[0]) >> (8 * pass)) & 0xFF] == movements.size()) continue;
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t c = count[digit];
+            count[digit] = offset;
+            offset += c;
+        }
+        for (const StockMovement& m : movements) scratch[count[(key(m) >> (8 * pass)) & 0xFF]++] = m;
+        movements.swap(scratch);
+    }
+}
+
+// A point-in-time, read-only copy of an Inventory: every product and the
+// totals that go with them. Inventory::view() makes one in O(1) and it never
+// changes afterwards, so it can be printed or exported from another thread
+// while the inventory's own thread keeps updating.
+class InventoryView {
+private:
+    SlotStore::View slots;
+    // Keep alive the bytes the products' names and categories point into.
+    shared_ptr<const StringArena> names;
+    shared_ptr<const CategoryDictionary> dictionary;
+    size_t count = 0;
+    double totalRevenue = 0;
+    double totalProfit = 0;
+
+public:
+    InventoryView() {}
+    InventoryView(SlotStore::View slots, shared_ptr<const StringArena> names,
+                  shared_ptr<const CategoryDictionary> dictionary, size_t count,
+                  double totalRevenue, double totalProfit)
+        : slots(move(slots)), names(move(names)), dictionary(move(dictionary)), count(count),
+          totalRevenue(totalRevenue), totalProfit(totalProfit) {}
+
+    size_t size() const { return count; }
+    double getTotalRevenue() const { return totalRevenue; }
+    double getTotalProfit() const { return totalProfit; }
+
+    // Visits every product in storage order, the cheapest way through.
+    template <typename Visitor>
+    void forEachProduct(Visitor visit) const { slots.forEach(visit); }
+
+    // Visits every product in ascending id order, as Inventory does.
+    template <typename Visitor>
+    void forEachProductById(Visitor visit) const {
+        vector<const Product*> sorted;
+        sorted.reserve(count);
+        slots.forEach([&sorted](const Product& product) { sorted.push_back(&product); });
+        sort(sorted.begin(), sorted.end(),
+             [](const Product* a, const Product* b) { return a->getId() < b->getId(); });
+        for (const Product* product : sorted) visit(*product);
+    }
+
+    // Writes every product in id order; see Inventory::exportProducts.
+    bool exportProducts(ostream& out, ExportFormat format) const {
+        ProductExporter exporter(out, format);
+        forEachProductById([&exporter](const Product& product) { exporter.add(product); });
+        return exporter.finish();
+    }
+
+    void printProducts(ostream& out) const {
+        if (count == 0) {
+            out << "No products in inventory.\n";
+        } else {
+            exportProducts(out, ExportFormat::Text);
+        }
+        out << "Total Inventory Value: Rs." << totalRevenue << '\n';
+        out << "Estimated Profit: Rs." << totalProfit << '\n';
+    }
+
+    // Same format as Inventory::saveInventoryToFile.
+    bool saveInventoryToFile(const string& filename) const {
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) return false;
+        bool ok = exportProducts(file, ExportFormat::Csv);
+        file.close();
+        return ok && bool(file);
+    }
+};
+
+class Inventory {
+private:
+    ProductIndex products;
+    double totalRevenue = 0;
+    double totalProfit = 0;
+    // Quiet inventories only report errors; used when driven as a library.
+    bool quiet = false;
+    // Where messages and printProducts output go.
+    ostream* out = &cout;
+
+    // Snapshot rows not copied into products yet. A row is copied on first
+    // touch and marked taken; once every row is taken the mapping is dropped.
+    unique_ptr<SnapshotReader> base;
+    vector<bool> baseTaken;
+    size_t baseRemaining = 0;
+
+    // Mutation log; when open, every successful add/update/remove is appended
+    // and the log is folded into logSnapshotFile once it grows too large.
+    unique_ptr<WriteAheadLog> log;
+    string logSnapshotFile;
+
+    // Background saves (startAutosave); changes are counted and handed over
+    // as an InventoryView once autosaveOptions says they are due.
+    unique_ptr<Autosaver> autosaver;
+    AutosaveOptions autosaveOptions;
+    size_t unsavedChanges = 0;
+    Autosaver::Clock::time_point oldestUnsaved;
+    uint64_t reportedAutosaveFailures = 0;
+
+    // Price/quantity/margin history (openHistory); every change is recorded
+    // with the wall-clock time.
+    unique_ptr<HistoryStore> history;
+
+    // Built on first use (enableCategoryIndex), then kept in sync.
+    unique_ptr<CategoryIndex> categories;
+
+    // Price/quantity/margin by slot; built on first use like categories.
+    unique_ptr<ProductColumns> columns;
+
+    // Products by price and by stock value (price x quantity); built on
+    // first use like categories.
+    unique_ptr<OrderedIndex> byPrice;
+    unique_ptr<OrderedIndex> byValue;
+
+    // Name search; built on first use like categories. Only touched when a
+    // name comes or goes, so price/quantity updates never pay for it.
+    unique_ptr<NameIndex> byName;
+
+    // Reorder thresholds and the products below them; made when the first
+    // threshold is set, then kept in sync. Crossings go to reorderListener,
+    // or are printed on out without one. A bulk load refiles every product,
+    // so each one it leaves low is reported again.
+    unique_ptr<ReorderIndex> reorder;
+    ReorderListener reorderListener;
+
+    static double stockValue(const Product& product) { return product.getPrice() * product.getQuantity(); }
+
+    static uint64_t fileSize(const string& filename) {
+        struct stat st;
+        return stat(filename.c_str(), &st) == 0 ? uint64_t(st.st_size) : 0;
+    }
+
+    bool hasSecondaryIndexes() const { return categories || columns || byPrice || byValue || byName || reorder; }
+
+    void clearSecondaryIndexes() {
+        if (categories) categories->clear();
+        if (columns) columns->clear();
+        if (byPrice) byPrice->clear();
+        if (byValue) byValue->clear();
+        if (byName) byName->clear();
+        if (reorder) reorder->clearLow();
+    }
+
+    // Product names live in names; categories are interned once each in
+    // dictionary. Products view both, so neither may move or shrink while
+    // products (or an InventoryView) reference them.
+    shared_ptr<StringArena> names = make_shared<StringArena>();
+    shared_ptr<CategoryDictionary> dictionary = make_shared<CategoryDictionary>();
+
+    // Copies product's strings into inventory-owned storage.
+    void own(Product& product) {
+        product.setName(names->store(product.getName()));
+        uint32_t code = dictionary->intern(product.getCategory());
+        product.setCategory(dictionary->name(code), code);
+    }
+
+    // Drops every product and the name bytes they referenced.
+    void clearProducts() {
+        products.clear();
+        clearSecondaryIndexes();
+        names = make_shared<StringArena>();
+    }
+
+    // Every add/remove/update goes through these, so totals and secondary
+    // indexes move together. update = removed(old values) + added(new).
+    void added(const Product& product) {
+        double revenue = product.getPrice() * product.getQuantity();
+        totalRevenue += revenue;
+        totalProfit += revenue * (product.getMargin() / 100);
+        if (categories) categories->add(product);
+        if (columns) columns->set(products.slotOf(product.getId()), product);
+        if (byPrice) byPrice->add(product.getPrice(), product.getId());
+        if (byValue) byValue->add(stockValue(product), product.getId());
+        if (reorder) refile(product);
+    }
+
+    void removed(const Product& product) {
+        double revenue = product.getPrice() * product.getQuantity();
+        totalRevenue -= revenue;
+        totalProfit -= revenue * (product.getMargin() / 100);
+        if (categories) categories->remove(product);
+        if (columns) columns->erase(products.slotOf(product.getId()));
+        if (byPrice) byPrice->remove(product.getPrice(), product.getId());
+        if (byValue) byValue->remove(stockValue(product), product.getId());
+    }
+
+    // The price/quantity/margin of the product in slot changed in place;
+    // its name and category did not. Moves totals and indexes by the
+    // difference, without the membership churn of removed + added.
+    void revalued(uint32_t slot, const Product& before, const Product& after) {
+        double revenueBefore = before.getPrice() * before.getQuantity();
+        double revenueAfter = after.getPrice() * after.getQuantity();
+        double revenue = revenueAfter - revenueBefore;
+        double profit = revenueAfter * (after.getMargin() / 100) - revenueBefore * (before.getMargin() / 100);
+        totalRevenue += revenue;
+        totalProfit += profit;
+        if (categories) {
+            categories->adjust(after.getCategoryCode(), revenue, profit,
+                               (long long)after.getQuantity() - before.getQuantity());
+        }
+        if (columns) columns->set(slot, after);
+        if (byPrice && after.getPrice() != before.getPrice()) {
+            byPrice->remove(before.getPrice(), after.getId());
+            byPrice->add(after.getPrice(), after.getId());
+        }
+        if (byValue && stockValue(after) != stockValue(before)) {
+            byValue->remove(stockValue(before), after.getId());
+            byValue->add(stockValue(after), after.getId());
+        }
+        if (reorder && after.getQuantity() != before.getQuantity()) {
+            ReorderChange change = reorder->quantityChanged(after, before.getQuantity());
+            if (change != ReorderChange::None) reportCrossing(after, change);
+        }
+    }
+
+    // Files product in the low-stock set afresh and reports a crossing.
+    void refile(const Product& product) {
+        ReorderChange change = reorder->update(product);
+        if (change != ReorderChange::None) reportCrossing(product, change);
+    }
+
+    // Out of line: crossings are rare, and the printing would otherwise be
+    // inlined into every update.
+    __attribute__((noinline)) void reportCrossing(const Product& product, ReorderChange change) {
+        Stats::count(StatCounter::ReorderAlerts);
+        ReorderAlert alert{product.getId(), product.getName(), product.getQuantity(), reorder->threshold(product),
+                           change == ReorderChange::Low};
+        if (reorderListener) {
+            reorderListener(alert);
+        } else if (alert.low) {
+            *out << "Reorder: product " << alert.id << " (" << alert.name << ") is down to " << alert.quantity
+                 << ", below its threshold of " << alert.threshold << ".\n";
+        } else if (alert.threshold == ReorderIndex::noThreshold) {
+            *out << "Restocked: product " << alert.id << " (" << alert.name << ") no longer has a reorder threshold.\n";
+        } else {
+            *out << "Restocked: product " << alert.id << " (" << alert.name << ") is back to " << alert.quantity
+                 << ", at or above its threshold of " << alert.threshold << ".\n";
+        }
+    }
+
+    // Sets id's price, quantity and margin through change(Product&), which
+    // must leave the name and category alone. Returns false if id is absent.
+    template <typename Change>
+    bool changeValues(int id, Change change) {
+        uint32_t slot = products.slotOf(id);
+        if (slot == ProductIndex::npos) {
+            if (!lookup(id)) return false;
+            slot = products.slotOf(id);
+        }
+        Product& product = products.modifySlot(slot);
+        Product before = product;
+        change(product);
+        revalued(slot, before, product);
+        if (log) logged(log->logValues(product));
+        if (history) history->record(historyClock(), product);
+        changed();
+        return true;
+    }
+
+    // Reports a single-product change the way updateProduct does.
+    bool reportUpdate(OpTimer& timer, bool found) {
+        if (!found) {
+            timer.miss();
+            *out << "ID does not exist.\n";
+        } else if (!quiet) {
+            *out << "Product updated successfully.\n";
+        }
+        return found;
+    }
+
+    // One-line product summary used by the listing reports.
+    void printLine(const Product& product) const {
+        *out << product.getId() << ": " << product.getName() << ", Rs." << product.getPrice() << " x "
+             << product.getQuantity() << '\n';
+    }
+
+    // Recomputes totals and secondary indexes from scratch after a bulk load.
+    void rebuild() {
+        totalRevenue = 0;
+        totalProfit = 0;
+        clearSecondaryIndexes();
+        products.forEach([this](const Product& product) {
+            added(product);
+            if (byName) byName->add(product.getId(), product.getName());
+        });
+    }
+
+    // written is false when the group commit the record filled failed; it
+    // counts as a failed commitLog.
+    void logged(bool written) {
+        if (!written) {
+            OpTimer timer(StatOp::CommitLog);
+            timer.miss();
+            *out << "Error: Could not write log.\n";
+        }
+        if (log->needsCompaction()) compactLog();
+    }
+
+    // Every successful change ends here (a bulk replacement counts as one
+    // per row). Without a due save it costs a counter. While the last save
+    // is still going, changes pile up for the next one instead.
+    void changed(size_t count = 1) {
+        if (!autosaver) return;
+        if (unsavedChanges == 0) oldestUnsaved = Autosaver::Clock::now();
+        unsavedChanges += min(count, SIZE_MAX - unsavedChanges);
+        if (unsavedChanges >= autosaveOptions.changes && !autosaver->busy()) submitAutosave(oldestUnsaved);
+    }
+
+    void submitAutosave(Autosaver::Clock::time_point due) {
+        InventoryView snapshot = view();
+        autosaver->submit([snapshot](ostream& file) { return snapshot.exportProducts(file, ExportFormat::Csv); },
+                          unsavedChanges, oldestUnsaved, due);
+        unsavedChanges = 0;
+    }
+
+    void recordAllHistory() {
+        if (history) history->recordAll(historyClock(), [this](auto visit) { forEachProduct(visit); });
+    }
+
+    void reportAutosaveFailures(const AutosaveStatus& status) {
+        if (status.failures == reportedAutosaveFailures) return;
+        *out << "Error: autosave to " << autosaver->file() << " failed: " << status.lastError << '\n';
+        reportedAutosaveFailures = status.failures;
+    }
+
+    void detachBase() {
+        base.reset();
+        vector<bool>().swap(baseTaken);
+        baseRemaining = 0;
+    }
+
+    const Product* lookup(int id) {
+        const Product* p = products.find(id);
+        if (p || !base) return p;
+        long long row = base->findRow(id);
+        if (row < 0 || baseTaken[row]) return nullptr;
+        baseTaken[row] = true;
+        baseRemaining--;
+        Product product = base->product(id, size_t(row));
+        own(product);
+        p = products.insert(product);
+        if (baseRemaining == 0) detachBase();
+        return p;
+    }
+
+    void materializeAll() {
+        if (!base) return;
+        base->forEachRow([this](int id, size_t row) {
+            if (baseTaken[row]) return;
+            Product product = base->product(id, row);
+            own(product);
+            products.insert(product);
+        });
+        detachBase();
+    }
+
+public:
+    explicit Inventory(IndexBackend backend = IndexBackend::Auto, NodeAllocator allocator = NodeAllocator::Pool)
+        : products(backend, allocator) {}
+
+    void setQuiet(bool quiet) { this->quiet = quiet; }
+    void setOutput(ostream& stream) { out = &stream; }
+    size_t size() const { return products.size() + baseRemaining; }
+    IndexBackend backend() const { return products.backend(); }
+    NodeMemoryStats nodeStats() const { return products.nodeStats(); }
+    double getTotalRevenue() const { return totalRevenue; }
+    double getTotalProfit() const { return totalProfit; }
+
+    bool addProduct(Product product) {
+        OpTimer timer(StatOp::Add);
+        // O(1) with the dense/hash backends, O(log n) with the ordered one
+        if (lookup(product.getId())) {
+            timer.miss();
+            *out << "Id already exists.\n";
+            return false;
+        }
+        own(product);
+        products.insert(product);
+        added(product);
+        if (byName) byName->add(product.getId(), product.getName());
+        if (log) logged(log->logAdd(product));
+        if (history) history->record(historyClock(), product);
+        changed();
+        if (!quiet) *out << "Product added successfully.\n";
+        return true;
+    }
+
+    bool removeProduct(int id) {
+        OpTimer timer(StatOp::Remove);
+        const Product* p = lookup(id);
+
+        if (p) {
+            removed(*p);
+            if (byName) byName->remove(id);
+            if (reorder) reorder->remove(id);
+            names->release(p->getName());
+            products.erase(id);
+            if (log) logged(log->logRemove(id));
+            if (history) history->recordRemove(historyClock(), id);
+            changed();
+            if (!quiet) *out << "Product removed successfully.\n";
+            return true;
+        }
+        timer.miss();
+        *out << "Id does not exist.\n";
+        return false;
+    }
+
+    // Visits every product, including untouched snapshot rows, in ascending
+    // id order. Snapshot rows are passed as temporaries.
+    template <typename Visitor>
+    void forEachProduct(Visitor visit) const {
+        if (!base) {
+            products.forEach(visit);
+            return;
+        }
+        vector<const Product*> live;
+        live.reserve(products.size());
+        products.forEach([&live](const Product& product) { live.push_back(&product); });
+        size_t next = 0;
+        base->forEachRow([&](int id, size_t row) {
+            if (baseTaken[row]) return;
+            while (next < live.size() && live[next]->getId() < id) visit(*live[next++]);
+            visit(base->product(id, row));
+        });
+        while (next < live.size()) visit(*live[next++]);
+    }
+
+    // Read-only lookup: unlike findProduct it never copies a snapshot row in,
+    // so any number of readers may call it at once. Returns false if id is
+    // absent; otherwise calls visit with the product (or a temporary copy of
+    // its snapshot row).
+    template <typename Visitor>
+    bool readProduct(int id, Visitor visit) const {
+        OpTimer timer(StatOp::Read);
+        if (const Product* p = products.find(id)) {
+            visit(*p);
+            return true;
+        }
+        long long row = base ? base->findRow(id) : -1;
+        if (row < 0 || baseTaken[row]) {
+            timer.miss();
+            return false;
+        }
+        visit(base->product(id, size_t(row)));
+        return true;
+    }
+
+    // Calls visit with the product and returns false if id is absent. The
+    // Product must not escape visit: the next change to any product may
+    // move it (see ProductIndex).
+    template <typename Visitor>
+    bool findProduct(int id, Visitor visit) {
+        OpTimer timer(StatOp::Find);
+        const Product* p = lookup(id);
+        if (!p) {
+            timer.miss();
+            return false;
+        }
+        visit(*p);
+        return true;
+    }
+
+    bool updateProduct(int id, string_view name, string_view category, double price, int quantity, double margin) {
+        OpTimer timer(StatOp::Update);
+        const Product* current = lookup(id);
+        if (current && name == current->getName() && category == current->getCategory()) {
+            return reportUpdate(timer, changeValues(id, [&](Product& product) {
+                product.setPrice(price);
+                product.setQuantity(quantity);
+                product.setMargin(margin);
+            }));
+        }
+        Product* product = current ? products.modify(id) : nullptr;
+        if (product) {
+            // Take the old values out of the totals before updating
+            removed(*product);
+
+            if (name != product->getName()) {
+                names->release(product->getName());
+                product->setName(names->store(name));
+                if (byName) {
+                    byName->remove(id);
+                    byName->add(id, product->getName());
+                }
+            }
+            if (category != product->getCategory()) {
+                uint32_t code = dictionary->intern(category);
+                product->setCategory(dictionary->name(code), code);
+            }
+            product->setPrice(price);
+            product->setQuantity(quantity);
+            product->setMargin(margin);
+
+            added(*product);
+
+            if (log) logged(log->logUpdate(*product));
+            if (history) history->record(historyClock(), *product);
+            changed();
+            if (!quiet) *out << "Product updated successfully.\n";
+            return true;
+        }
+        timer.miss();
+        *out << "ID does not exist.\n";
+        return false;
+    }
+
+    // Field-level updates for the common case of stock and price changes:
+    // only the hot fields are written, the totals move by the difference,
+    // and the name and category are neither compared nor copied.
+    bool adjustQuantity(int id, int delta) {
+        OpTimer timer(StatOp::AdjustQuantity);
+        const Product* product = lookup(id);
+        if (product && !quantityFits(product->getQuantity(), delta)) {
+            timer.miss();
+            *out << "Quantity out of range.\n";
+            return false;
+        }
+        return reportUpdate(timer, product && changeValues(id, [delta](Product& product) { product.setQuantity(product.getQuantity() + delta); }));
+    }
+
+    bool setPrice(int id, double price) {
+        OpTimer timer(StatOp::SetPrice);
+        return reportUpdate(timer, changeValues(id, [price](Product& product) { product.setPrice(price); }));
+    }
+
+    bool setMargin(int id, double margin) {
+        OpTimer timer(StatOp::SetMargin);
+        return reportUpdate(timer, changeValues(id, [margin](Product& product) { product.setMargin(margin); }));
+    }
+
+    // Applies a batch of stock movements in one pass: sorted by id, so the
+    // index and the slot pages are walked in order, and each product's
+    // deltas are summed and applied (and logged) once. Movements for
+    // unknown ids, and runs that would take the quantity out of the int
+    // range, are reported and skipped. Reorders movements; returns how many
+    // were applied.
+    size_t applyMovements(vector<StockMovement>& movements) {
+        OpTimer timer(StatOp::ApplyMovements);
+        sortMovements(movements);
+        size_t applied = 0;
+        for (size_t i = 0, next; i < movements.size(); i = next) {
+            int id = movements[i].id;
+            long long delta = 0;
+            for (next = i; next < movements.size() && movements[next].id == id; next++) delta += movements[next].delta;
+            const Product* product = lookup(id);
+            if (!product) {
+                *out << "ID " << id << " does not exist.\n";
+            } else if (!quantityFits(product->getQuantity(), delta)) {
+                *out << "ID " << id << " quantity out of range.\n";
+            } else {
+                changeValues(id, [delta](Product& product) { product.setQuantity(int(product.getQuantity() + delta)); });
+                applied += next - i;
+            }
+        }
+        Stats::count(StatCounter::MovementsApplied, applied);
+        if (applied < movements.size()) {
+            timer.miss();
+            Stats::count(StatCounter::MovementsSkipped, movements.size() - applied);
+        }
+        return applied;
+    }
+
+    // Writes products [offset, offset + limit) of the id order to stream in
+    // format, formatting on several threads (see ProductExporter). Returns
+    // whether stream took all of it.
+    bool exportProducts(ostream& stream, ExportFormat format, size_t offset = 0, size_t limit = SIZE_MAX) const {
+        ProductExporter exporter(stream, format);
+        size_t index = 0;
+        forEachProduct([&](const Product& product) {
+            if (index >= offset && index - offset < limit) exporter.add(product);
+            index++;
+        });
+        return exporter.finish();
+    }
+
+    void printProducts() const {
+        OpTimer timer(StatOp::Print);
+        if (size() == 0) {
+            *out << "No products in inventory.\n";
+        } else {
+            exportProducts(*out, ExportFormat::Text);
+        }
+        *out << "Total Inventory Value: Rs." << totalRevenue << '\n';
+        *out << "Estimated Profit: Rs." << totalProfit << '\n';
+    }
+
+    // Page (counting from 0) of the printProducts listing.
+    bool printProductPage(size_t page, size_t pageSize = 20) const {
+        OpTimer timer(StatOp::Print);
+        size_t pages = (size() + pageSize - 1) / pageSize;
+        if (page >= pages) {
+            timer.miss();
+            *out << "No page " << page + 1 << " (" << pages << " pages of " << pageSize << ").\n";
+            return false;
+        }
+        exportProducts(*out, ExportFormat::Text, page * pageSize, pageSize);
+        *out << "Page " << page + 1 << " of " << pages << ".\n";
+        return true;
+    }
+
+    bool exportToFile(const string& filename, ExportFormat format) const {
+        OpTimer timer(StatOp::Export);
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            timer.miss();
+            *out << "Error opening " << filename << " for writing.\n";
+            return false;
+        }
+        bool ok = exportProducts(file, format);
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(file.tellp()))));
+        file.close();
+        if (!ok || !file) {
+            timer.miss();
+            *out << "Error writing " << filename << '\n';
+            return false;
+        }
+        if (!quiet) *out << "Exported " << size() << " products.\n";
+        return true;
+    }
+
+    bool saveInventoryToFile(string filename) {
+        OpTimer timer(StatOp::Save);
+        ofstream file(filename, ios::binary);
+        if (!file.is_open()) {
+            timer.miss();
+            *out << "Error opening file for saving.\n";
+            return false;
+        }
+
+        bool ok = exportProducts(file, ExportFormat::Csv);
+        Stats::count(StatCounter::BytesWritten, uint64_t(max(streamoff(0), streamoff(file.tellp()))));
+        file.close();
+        if (!ok || !file) {
+            timer.miss();
+            *out << "Error writing " << filename << '\n';
+            return false;
+        }
+        if (!quiet) *out << "Inventory saved to file.\n";
+        return true;
+    }
+
+    bool loadInventoryFromFile(string filename) {
+        OpTimer timer(StatOp::Load);
+        CsvLoadResult result;
+        if (!CsvLoader::load(filename, result)) {
+            timer.miss();
+            *out << "Error: Could not open file " << filename << '\n';
+            return false;
+        }
+        Stats::count(StatCounter::BytesRead, result.file ? result.file->size() : 0);
+        Stats::count(StatCounter::LoadRejects, result.rejectedLines.size());
+        for (size_t line : result.rejectedLines) {
+            *out << "Invalid data in file, skipping line " << line << ".\n";
+        }
+
+        replaceProducts(result.products);
+        if (!quiet) *out << "Inventory loaded from file.\n";
+        return true;
+    }
+
+    // Replaces the contents with the given files merged by id (see
+    // CsvMerger). Under MergePolicy::Error, or if a summed quantity
+    // overflows, the conflicting ids are listed and nothing changes.
+    bool mergeInventoryFiles(const vector<string>& filenames, MergePolicy policy) {
+        OpTimer timer(StatOp::Merge);
+        CsvMergeResult result;
+        if (!CsvMerger::merge(filenames, policy, result)) {
+            timer.miss();
+            *out << "Error: Could not open file " << filenames[result.failedFile] << '\n';
+            return false;
+        }
+        for (size_t f = 0; f < filenames.size(); f++) {
+            const CsvLoadResult& file = result.files[f];
+            Stats::count(StatCounter::BytesRead, file.file ? file.file->size() : 0);
+            Stats::count(StatCounter::LoadRejects, file.rejectedLines.size());
+            for (size_t line : file.rejectedLines) {
+                *out << "Invalid data in " << filenames[f] << ", skipping line " << line << ".\n";
+            }
+        }
+        if (result.conflictCount > 0) {
+            timer.miss();
+            for (const MergeConflict& c : result.conflicts) {
+                if (c.overflow) {
+                    *out << "Error: total quantity of product ID " << c.id << " overflows (last in "
+                         << filenames[c.secondFile] << ").\n";
+                } else {
+                    *out << "Error: product ID " << c.id << " is in both " << filenames[c.firstFile] << " and "
+                         << filenames[c.secondFile] << ".\n";
+                }
+            }
+            if (result.conflictCount > result.conflicts.size()) {
+                *out << "... and " << result.conflictCount - result.conflicts.size() << " more.\n";
+            }
+            *out << "Nothing was merged.\n";
+            return false;
+        }
+        replaceProducts(result.products);
+        if (!quiet) {
+            *out << "Merged " << filenames.size() << " files: " << size() << " products, " << result.sharedIds
+                 << " in more than one file (" << mergePolicyName(policy) << ").\n";
+        }
+        return true;
+    }
+
+    // Compares after, a saveInventoryToFile-format file, with before: another
+    // such file, or the inventory itself when before is empty. The files are
+    // streamed through a merge-join by id rather than loaded, so they may be
+    // larger than memory, but must be sorted by id as saveInventoryToFile
+    // writes them. Nothing in the inventory changes. Each added, removed and
+    // changed product goes to out, or as CSV to reportFile, then a summary.
+    bool diffInventory(const string& before, const string& after, const string& reportFile = "") {
+        OpTimer timer(StatOp::Diff);
+        unique_ptr<CsvRowReader> beforeRows;
+        if (!before.empty()) beforeRows.reset(new CsvRowReader(before));
+        CsvRowReader afterRows(after);
+        for (CsvRowReader* rows : {beforeRows.get(), &afterRows}) {
+            if (rows && !rows->open()) {
+                timer.miss();
+                *out << "Error: " << rows->error() << '\n';
+                return false;
+            }
+        }
+        ofstream report;
+        if (!reportFile.empty()) {
+            report.open(reportFile, ios::binary);
+            if (!report.is_open()) {
+                timer.miss();
+                *out << "Error: Could not open file " << reportFile << '\n';
+                return false;
+            }
+        }
+
+        InventoryDiff diff(afterRows, report.is_open() ? report : *out,
+                           report.is_open() ? DiffFormat::Csv : DiffFormat::Text);
+        if (beforeRows) {
+            DiffRow row;
+            while (beforeRows->next(row) && diff.before(row)) {}
+        } else {
+            // forEachProduct cannot stop, so once the after file fails the
+            // rest of the walk just skips.
+            bool reading = true;
+            forEachProduct([&](const Product& product) {
+                if (reading) reading = diff.before(diffRowOf(product));
+            });
+        }
+        bool ok = diff.finish();
+        for (CsvRowReader* rows : {beforeRows.get(), &afterRows}) {
+            if (!rows) continue;
+            Stats::count(StatCounter::BytesRead, rows->bytesRead());
+            Stats::count(StatCounter::LoadRejects, rows->rejectedCount());
+            for (size_t line : rows->rejectedLines()) {
+                *out << "Invalid data in " << rows->file() << ", skipping line " << line << ".\n";
+            }
+            if (rows->rejectedCount() > rows->rejectedLines().size()) {
+                *out << "... and " << rows->rejectedCount() - rows->rejectedLines().size() << " more.\n";
+            }
+            if (rows->failed()) {
+                ok = false;
+                *out << "Error: " << rows->error() << '\n';
+            }
+        }
+        if (report.is_open()) {
+            report.close();
+            if (!report) {
+                ok = false;
+                *out << "Error writing " << reportFile << '\n';
+            }
+        }
+        if (!ok) {
+            timer.miss();
+            *out << "The diff is incomplete.\n";
+            return false;
+        }
+
+        const DiffSummary& s = diff.result();
+        auto change = [this](const char* label, auto from, auto to) {
+            *out << label << from << " -> " << to << " (" << showpos << to - from << noshowpos << ")\n";
+        };
+        *out << "Compared " << after << " with " << (before.empty() ? "the inventory" : before) << ": "
+             << s.added << " added, " << s.removed << " removed, " << s.changed << " changed, " << s.unchanged
+             << " unchanged.\n";
+        change("Products: ", (long long)s.before.products, (long long)s.after.products);
+        change("Units: ", s.before.units, s.after.units);
+        change("Inventory value (Rs.): ", s.before.revenue, s.after.revenue);
+        change("Estimated profit (Rs.): ", s.before.profit, s.after.profit);
+        if (!quiet && report.is_open()) *out << "Differences written to " << reportFile << ".\n";
+        return true;
+    }
+
+    // Replaces the contents with rows (later duplicates win, as in
+    // ProductIndex::bulkLoad). The rows' strings are copied.
+    void replaceProducts(vector<Product>& rows) {
+        detachBase();
+        clearProducts();
+        for (Product& product : rows) own(product);
+        products.bulkLoad(rows);
+        rebuild();
+        // The log can't express "replace everything", so start it afresh.
+        if (log) compactLog();
+        recordAllHistory();
+        changed(size());
+    }
+
+    bool saveSnapshot(string filename) {
+        OpTimer timer(StatOp::SaveSnapshot);
+        materializeAll();
+        vector<const Product*> rows;
+        rows.reserve(products.size());
+        products.forEach([&rows](const Product& product) { rows.push_back(&product); });
+        if (!writeSnapshot(filename, rows, totalRevenue, totalProfit)) {
+            timer.miss();
+            *out << "Error writing snapshot " << filename << '\n';
+            return false;
+        }
+        Stats::count(StatCounter::BytesWritten, fileSize(filename));
+        if (!quiet) *out << "Snapshot saved to file.\n";
+        return true;
+    }
+
+    // Maps a snapshot written by saveSnapshot. Nothing is parsed up front:
+    // products are copied out of the mapping the first time they are touched.
+    bool loadSnapshot(string filename) {
+        OpTimer timer(StatOp::LoadSnapshot);
+        unique_ptr<SnapshotReader> reader(new SnapshotReader());
+        if (!reader->open(filename)) {
+            timer.miss();
+            *out << "Error: Could not open snapshot " << filename << '\n';
+            return false;
+        }
+        Stats::count(StatCounter::BytesRead, fileSize(filename));
+        clearProducts();
+        detachBase();
+        totalRevenue = reader->totalRevenue();
+        totalProfit = reader->totalProfit();
+        if (reader->size() > 0) {
+            baseTaken.assign(reader->size(), false);
+            baseRemaining = reader->size();
+            base = move(reader);
+        }
+        // Secondary indexes need every row, which defeats lazy loading;
+        // they are only built once something asks for them.
+        if (hasSecondaryIndexes()) {
+            materializeAll();
+            rebuild();
+        }
+        if (log) compactLog();
+        recordAllHistory();
+        changed(size());
+        if (!quiet) *out << "Snapshot loaded from file.\n";
+        return true;
+    }
+
+    // Restores the state saved in snapshotFile plus every mutation logged to
+    // logFile since, then keeps logging to logFile. Replay is idempotent, so
+    // a crash between writing a snapshot and truncating the log is harmless.
+    bool openLog(string snapshotFile, string logFile, LogOptions options = LogOptions()) {
+        OpTimer timer(StatOp::OpenLog);
+        closeLog();
+        clearProducts();
+        detachBase();
+        totalRevenue = 0;
+        totalProfit = 0;
+        bool wasQuiet = quiet;
+        quiet = true;
+        if (ifstream(snapshotFile).good() && !loadSnapshot(snapshotFile)) {
+            quiet = wasQuiet;
+            timer.miss();
+            return false;
+        }
+        long long replayed = WriteAheadLog::replay(logFile, [this](const LogRecord& record) {
+            const Product& p = record.product;
+            if (record.op == LogOp::Remove) {
+                if (lookup(p.getId())) removeProduct(p.getId());
+            } else if (record.op == LogOp::Values) {
+                if (lookup(p.getId())) {
+                    changeValues(p.getId(), [&p](Product& product) {
+                        product.setPrice(p.getPrice());
+                        product.setQuantity(p.getQuantity());
+                        product.setMargin(p.getMargin());
+                    });
+                }
+            } else if (lookup(p.getId())) {
+                updateProduct(p.getId(), p.getName(), p.getCategory(), p.getPrice(), p.getQuantity(), p.getMargin());
+            } else {
+                addProduct(p);
+            }
+        });
+        quiet = wasQuiet;
+        if (replayed < 0) {
+            timer.miss();
+            *out << "Error: Could not read log " << logFile << '\n';
+            return false;
+        }
+        log.reset(new WriteAheadLog());
+        Stats::count(StatCounter::LogRecordsReplayed, uint64_t(replayed));
+        if (!log->open(logFile, options)) {
+            timer.miss();
+            log.reset();
+            *out << "Error: Could not open log " << logFile << '\n';
+            return false;
+        }
+        logSnapshotFile = snapshotFile;
+        if (!quiet) *out << "Recovered " << size() << " products (" << replayed << " log records replayed).\n";
+        return true;
+    }
+
+    // O(1) read-only copy of the current state; see InventoryView. The first
+    // view after loadSnapshot copies the mapped rows in. Call this on the
+    // thread that modifies the inventory, then hand the view to readers.
+    InventoryView view() {
+        OpTimer timer(StatOp::View);
+        materializeAll();
+        return InventoryView(products.view(), names, dictionary, products.size(), totalRevenue, totalProfit);
+    }
+
+    // Builds the category index on first call; afterwards it is maintained
+    // by every mutation and this is O(1).
+    const CategoryIndex& categoryIndex() {
+        if (!categories) {
+            materializeAll();
+            categories.reset(new CategoryIndex());
+            products.forEach([this](const Product& product) { categories->add(product); });
+        }
+        return *categories;
+    }
+
+    // Builds the hot columns on first call; afterwards they are maintained by
+    // every mutation.
+    const ProductColumns& columnStore() {
+        if (!columns) {
+            materializeAll();
+            columns.reset(new ProductColumns());
+            products.forEach([this](const Product& product) {
+                columns->set(products.slotOf(product.getId()), product);
+            });
+        }
+        return *columns;
+    }
+
+    // The running totals pick up rounding error with every update. This
+    // recomputes them (and the per-category totals, if indexed) from the
+    // columns and replaces them.
+    void reconcileTotals() {
+        OpTimer timer(StatOp::Reconcile);
+        ColumnTotals exact = columnStore().totals();
+        *out << "Inventory value: Rs." << exact.revenue << " (running total was off by "
+             << totalRevenue - exact.revenue << ")\n";
+        *out << "Estimated profit: Rs." << exact.profit << " (running total was off by "
+             << totalProfit - exact.profit << ")\n";
+        totalRevenue = exact.revenue;
+        totalProfit = exact.profit;
+        if (categories) {
+            vector<ColumnTotals> split;
+            columns->totalsByCategory(split);
+            for (size_t code = 0; code < split.size(); code++) {
+                categories->setTotals(uint32_t(code), split[code].revenue, split[code].profit);
+            }
+        }
+    }
+
+    void printCategoryReport() {
+        OpTimer timer(StatOp::CategoryReport);
+        const CategoryIndex& index = categoryIndex();
+        if (index.size() == 0) {
+            timer.miss();
+            *out << "No products in inventory.\n";
+            return;
+        }
+        index.forEach([this](uint32_t code, const CategoryStats& stats) {
+            *out << dictionary->name(code) << ": " << stats.products << " products, " << stats.units
+                 << " units, value Rs." << stats.revenue << ", profit Rs." << stats.profit << '\n';
+        });
+    }
+
+    void printCategory(const string& category) {
+        OpTimer timer(StatOp::CategoryList);
+        const CategoryIndex& index = categoryIndex();
+        long long code = dictionary->find(category);
+        const CategoryStats* stats = code < 0 ? nullptr : index.find(uint32_t(code));
+        if (!stats) {
+            timer.miss();
+            *out << "No products in category " << category << ".\n";
+            return;
+        }
+        for (int id : stats->members) printLine(*products.find(id));
+        *out << category << ": " << stats->products << " products, value Rs." << stats->revenue
+             << ", profit Rs." << stats->profit << '\n';
+    }
+
+    // Build the price / stock value index on first call; afterwards they
+    // are maintained by every mutation.
+    const OrderedIndex& priceIndex() {
+        if (!byPrice) {
+            materializeAll();
+            byPrice.reset(new OrderedIndex());
+            products.forEach([this](const Product& product) { byPrice->add(product.getPrice(), product.getId()); });
+        }
+        return *byPrice;
+    }
+
+    ReorderIndex& reorderIndex() {
+        if (!reorder) {
+            materializeAll();
+            reorder.reset(new ReorderIndex());
+        }
+        return *reorder;
+    }
+
+    const OrderedIndex& valueIndex() {
+        if (!byValue) {
+            materializeAll();
+            byValue.reset(new OrderedIndex());
+            products.forEach([this](const Product& product) { byValue->add(stockValue(product), product.getId()); });
+        }
+        return *byValue;
+    }
+
+    const NameIndex& nameIndex() {
+        if (!byName) {
+            materializeAll();
+            byName.reset(new NameIndex());
+            products.forEach([this](const Product& product) { byName->add(product.getId(), product.getName()); });
+        }
+        return *byName;
+    }
+
+    // Prints page (counting from 0) of the products matching query, best
+    // match first.
+    void printNameSearch(string_view query, size_t page, size_t pageSize = 20) {
+        OpTimer timer(StatOp::NameSearch);
+        vector<NameMatch> matches;
+        bool more = nameIndex().search(query, page * pageSize, pageSize, matches);
+        if (matches.empty()) {
+            timer.miss();
+            *out << "No products match " << query << ".\n";
+            return;
+        }
+        for (const NameMatch& match : matches) printLine(*products.find(match.id));
+        *out << "Page " << page + 1 << ": " << matches.size() << " products";
+        if (more) *out << ", more on the next page";
+        *out << ".\n";
+    }
+
+    void printPriceRange(double low, double high) {
+        OpTimer timer(StatOp::PriceRange);
+        size_t found = 0;
+        priceIndex().forRange(low, high, [this, &found](double, int id) {
+            printLine(*products.find(id));
+            found++;
+        });
+        if (found == 0) timer.miss();
+        *out << found << " products priced Rs." << low << " to Rs." << high << ".\n";
+    }
+
+    void printTopByValue(size_t n) {
+        OpTimer timer(StatOp::TopByValue);
+        valueIndex().forTop(n, [this](double value, int id) {
+            const Product& product = *products.find(id);
+            *out << product.getId() << ": " << product.getName() << ", stock value Rs." << value << '\n';
+        });
+    }
+
+    void printPercentiles() {
+        OpTimer timer(StatOp::Percentiles);
+        const OrderedIndex& prices = priceIndex();
+        const OrderedIndex& values = valueIndex();
+        if (prices.size() == 0) {
+            timer.miss();
+            *out << "No products in inventory.\n";
+            return;
+        }
+        for (double p : {0.0, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0}) {
+            *out << "p" << p * 100 << ": price Rs." << prices.percentile(p)
+                 << ", stock value Rs." << values.percentile(p) << '\n';
+        }
+    }
+
+    // Runs a query (see Query) over the hot columns on several threads and
+    // prints the result as CSV under a header line, then how many products
+    // matched. Groups are listed by category name unless ordered.
+    bool runQuery(string_view queryText) {
+        OpTimer timer(StatOp::Query);
+        Query query;
+        string error;
+        if (!parseQuery(queryText, query, error)) {
+            timer.miss();
+            *out << "Invalid query: " << error << ".\n";
+            return false;
+        }
+        for (QueryCondition& condition : query.conditions) {
+            if (condition.field != QueryField::Category) continue;
+            long long code = dictionary->find(condition.category);
+            condition.code = code < 0 ? ProductColumns::freeCode : uint32_t(code);
+        }
+        const ProductColumns& table = columnStore();
+        QueryResult result;
+        QueryEngine::run(query, table, dictionary->size(), result);
+
+        TextBuffer text;
+        for (size_t i = 0; i < query.items.size(); i++) {
+            if (i > 0) text.append(',');
+            text.append(queryItemName(query.items[i]));
+        }
+        text.append('\n');
+        if (query.aggregates()) {
+            vector<QueryGroup>& groups = result.groups;
+            auto name = [this](const QueryGroup& group) {
+                return group.code == ProductColumns::freeCode ? string_view() : dictionary->name(group.code);
+            };
+            // NaN (an empty group's average) sorts last either way.
+            auto before = [&](const QueryGroup& a, const QueryGroup& b) {
+                if (!query.ordered || query.orderBy.function == QueryFunction::None) {
+                    return query.descending ? name(b) < name(a) : name(a) < name(b);
+                }
+                double x = result.value(a, query.orderBy), y = result.value(b, query.orderBy);
+                if (x != y && !(isnan(x) && isnan(y))) return isnan(y) || (!isnan(x) && (query.descending ? y < x : x < y));
+                return name(a) < name(b);
+            };
+            sort(groups.begin(), groups.end(), before);
+            if (groups.size() > query.limit) groups.resize(query.limit);
+            for (const QueryGroup& group : groups) {
+                for (size_t i = 0; i < query.items.size(); i++) {
+                    const QueryItem& item = query.items[i];
+                    if (i > 0) text.append(',');
+                    if (item.function == QueryFunction::None) {
+                        text.append(name(group));
+                    } else if (item.function == QueryFunction::Count) {
+                        text.appendInt((long long)group.count);
+                    } else {
+                        double value = result.value(group, item);
+                        if (!isnan(value)) text.appendDouble(value);
+                    }
+                }
+                text.append('\n');
+            }
+        } else {
+            vector<uint32_t>& slots = result.slots;
+            // Without an order, rows come in id order, as print lists them.
+            QueryField key = query.ordered ? query.orderBy.field : QueryField::Id;
+            bool descending = query.ordered && query.descending;
+            auto field = [key](const Product& product) {
+                double value = product.getPrice() * product.getQuantity();
+                switch (key) {
+                    case QueryField::Price: return product.getPrice();
+                    case QueryField::Quantity: return double(product.getQuantity());
+                    case QueryField::Margin: return product.getMargin();
+                    case QueryField::Value: return value;
+                    default: return value * (product.getMargin() / 100);
+                }
+            };
+            // Ties in id order either way.
+            auto before = [&](uint32_t a, uint32_t b) {
+                const Product& x = products.at(a);
+                const Product& y = products.at(b);
+                int order = 0;
+                if (key == QueryField::Name) order = x.getName().compare(y.getName());
+                else if (key == QueryField::Category) order = x.getCategory().compare(y.getCategory());
+                else if (isNumericField(key)) order = field(x) < field(y) ? -1 : field(y) < field(x) ? 1 : 0;
+                if (order != 0) return descending ? order > 0 : order < 0;
+                return key == QueryField::Id && descending ? y.getId() < x.getId() : x.getId() < y.getId();
+            };
+            size_t keep = min(query.limit, slots.size());
+            partial_sort(slots.begin(), slots.begin() + ptrdiff_t(keep), slots.end(), before);
+            slots.resize(keep);
+            for (uint32_t slot : slots) {
+                const Product& product = products.at(slot);
+                for (size_t i = 0; i < query.items.size(); i++) {
+                    if (i > 0) text.append(',');
+                    double value = product.getPrice() * product.getQuantity();
+                    switch (query.items[i].field) {
+                        case QueryField::Id: text.appendInt(product.getId()); break;
+                        case QueryField::Name: text.append(product.getName()); break;
+                        case QueryField::Category: text.append(product.getCategory()); break;
+                        case QueryField::Price: text.appendDouble(product.getPrice()); break;
+                        case QueryField::Quantity: text.appendInt(product.getQuantity()); break;
+                        case QueryField::Margin: text.appendDouble(product.getMargin()); break;
+                        case QueryField::Value: text.appendDouble(value); break;
+                        case QueryField::Profit: text.appendDouble(value * (product.getMargin() / 100)); break;
+                    }
+                }
+                text.append('\n');
+            }
+        }
+        out->write(text.data(), streamsize(text.size()));
+        *out << result.matched << " of " << size() << " products matched.\n";
+        if (result.matched == 0) timer.miss();
+        return true;
+    }
+
+    // From now on id counts as low stock while its quantity is below
+    // threshold, whatever its category's threshold. A negative threshold
+    // clears it, leaving the category's. Returns false if id is absent.
+    bool setReorderThreshold(int id, int threshold) {
+        ReorderIndex& index = reorderIndex();
+        const Product* product = lookup(id);
+        if (!product) {
+            *out << "ID does not exist.\n";
+            return false;
+        }
+        index.setProductThreshold(id, threshold);
+        refile(*product);
+        if (!quiet) *out << "Reorder threshold set.\n";
+        return true;
+    }
+
+    // The threshold for every product in category without one of its own.
+    // Visits every product once to refile the category's.
+    void setCategoryReorderThreshold(const string& category, int threshold) {
+        uint32_t code = dictionary->intern(category);
+        reorderIndex().setCategoryThreshold(code, threshold);
+        products.forEach([this, code](const Product& product) {
+            if (product.getCategoryCode() == code) refile(product);
+        });
+        if (!quiet) *out << "Reorder threshold set for category " << category << ".\n";
+    }
+
+    // Called with every product that crosses its threshold, as it does,
+    // instead of printing them. Empty to print them again.
+    void setReorderListener(ReorderListener listener) { reorderListener = move(listener); }
+
+    size_t lowStockCount() const { return reorder ? reorder->lowCount() : 0; }
+
+    // Up to limit products below their reorder threshold, the furthest
+    // below first. O(k): the set is kept as products change.
+    void printLowStock(size_t limit = SIZE_MAX) {
+        OpTimer timer(StatOp::LowStock);
+        if (lowStockCount() == 0) {
+            timer.miss();
+            *out << "No products are below their reorder threshold.\n";
+            return;
+        }
+        reorder->forLow(limit, [this](int id, long long shortfall) {
+            const Product& product = *products.find(id);
+            *out << id << ": " << product.getName() << ", " << product.getQuantity() << " in stock, threshold "
+                 << reorder->threshold(product) << ", " << shortfall << " short\n";
+        });
+        if (limit < reorder->lowCount()) *out << "... and " << reorder->lowCount() - limit << " more.\n";
+    }
+
+    // What printMemoryUsage totals.
+    size_t memoryBytes() const {
+        return products.slotBytes() + products.indexBytes() + names->bytesReserved() + dictionary->memoryBytes()
+            + (columns ? columns->memoryBytes() : 0) + (byName ? byName->memoryBytes() : 0)
+            + (history ? history->memoryBytes() : 0);
+    }
+
+    void printMemoryUsage() const {
+        OpTimer timer(StatOp::MemoryUsage);
+        const double mb = 1024.0 * 1024.0;
+        size_t slots = products.slotBytes();
+        size_t index = products.indexBytes();
+        size_t categoryBytes = dictionary->memoryBytes();
+        *out << "Products: " << products.size() << " loaded";
+        if (base) *out << ", " << baseRemaining << " still in the snapshot mapping";
+        *out << '\n';
+        *out << "Product slots: " << slots / mb << " MB (" << sizeof(Product) << " bytes each)\n";
+        *out << "Id index (" << indexBackendName(products.backend()) << "): " << index / mb << " MB\n";
+        NodeMemoryStats nodes = products.nodeStats();
+        if (nodes.requests > 0) {
+            *out << "Id index nodes (" << nodeAllocatorName(products.nodeAllocator()) << " allocator): "
+                 << nodes.liveBlocks << " live, " << nodes.requests << " allocated in all, "
+                 << nodes.systemAllocations << " heap allocations, " << nodes.heldBytes / mb << " MB held, "
+                 << nodes.fragmentation() * 100 << "% unused\n";
+        }
+        *out << "Names: " << names->bytesUsed() / mb << " MB used, " << names->bytesReserved() / mb
+             << " MB reserved, " << names->bytesWasted() / mb << " MB overwritten\n";
+        *out << "Categories: " << dictionary->size() << " distinct, " << categoryBytes / 1024.0 << " KB\n";
+        if (columns) *out << "Hot columns: " << columns->memoryBytes() / mb << " MB\n";
+        if (byName) *out << "Name search index: " << byName->memoryBytes() / mb << " MB\n";
+        if (history) {
+            *out << "History: " << history->changeCount() << " changes to " << history->productCount()
+                 << " products, " << history->encodedBytes() / mb << " MB encoded, "
+                 << history->memoryBytes() / mb << " MB in all\n";
+        }
+        *out << "Total: " << memoryBytes() / mb << " MB\n";
+    }
+
+    // Per-operation calls and latencies since startup (every inventory in
+    // the process, every thread; see Stats for which calls are timed), then
+    // the event counters and current sizes.
+    void printStats() const {
+        StatsSnapshot stats = Stats::read();
+        *out << "Uptime: " << stats.uptimeSeconds << " s\n";
+        for (size_t i = 0; i < size_t(StatOp::Count); i++) {
+            const StatsSnapshot::Op& op = stats.ops[i];
+            if (op.calls == 0) continue;
+            auto micros = [&stats](double ticks) { return stats.nanos(ticks) / 1000; };
+            *out << statOpName(StatOp(i)) << ": " << op.calls << " calls, " << op.misses << " misses, mean "
+                 << micros(op.meanTicks()) << " us, p50 " << micros(op.percentile(0.5)) << ", p90 "
+                 << micros(op.percentile(0.9)) << ", p99 " << micros(op.percentile(0.99)) << ", p99.9 "
+                 << micros(op.percentile(0.999)) << ", max " << micros(op.maxTicks) << " us\n";
+        }
+        for (size_t i = 0; i < size_t(StatCounter::Count); i++) {
+            *out << statCounterName(StatCounter(i)) << ": " << stats.counters[i] << '\n';
+        }
+        *out << "products: " << size() << "\nmemory_bytes: " << memoryBytes() << "\nlog_bytes: "
+             << (log ? log->size() : 0) << "\nsnapshot_rows_unloaded: " << baseRemaining << '\n';
+    }
+
+    // The same as JSON, with every non-empty latency bucket as a
+    // [lower bound ns, calls] pair. Written to a temporary file and renamed
+    // into place, so a reader never sees half a dump.
+    bool writeStats(const string& filename) const {
+        StatsSnapshot stats = Stats::read();
+        TextBuffer json;
+        json.append("{\"uptime_seconds\":");
+        json.appendExactDouble(stats.uptimeSeconds);
+        json.append(",\"gauges\":{\"products\":");
+        json.appendInt((long long)size());
+        json.append(",\"memory_bytes\":");
+        json.appendInt((long long)memoryBytes());
+        json.append(",\"log_bytes\":");
+        json.appendInt((long long)(log ? log->size() : 0));
+        json.append(",\"snapshot_rows_unloaded\":");
+        json.appendInt((long long)baseRemaining);
+        json.append("},\"counters\":{");
+        for (size_t i = 0; i < size_t(StatCounter::Count); i++) {
+            if (i > 0) json.append(',');
+            appendJsonString(json, statCounterName(StatCounter(i)));
+            json.append(':');
+            json.appendInt((long long)stats.counters[i]);
+        }
+        json.append("},\"operations\":{");
+        bool first = true;
+        for (size_t i = 0; i < size_t(StatOp::Count); i++) {
+            const StatsSnapshot::Op& op = stats.ops[i];
+            if (op.calls == 0) continue;
+            if (!first) json.append(',');
+            first = false;
+            appendJsonString(json, statOpName(StatOp(i)));
+            json.append(":{\"calls\":");
+            json.appendInt((long long)op.calls);
+            json.append(",\"misses\":");
+            json.appendInt((long long)op.misses);
+            json.append(",\"timed\":");
+            json.appendInt((long long)op.timed);
+            json.append(",\"mean_ns\":");
+            json.appendExactDouble(stats.nanos(op.meanTicks()));
+            const pair<const char*, double> quantiles[] = {{"p50_ns", 0.5}, {"p90_ns", 0.9}, {"p99_ns", 0.99}, {"p999_ns", 0.999}};
+            for (const auto& q : quantiles) {
+                json.append(",\"");
+                json.append(q.first);
+                json.append("\":");
+                json.appendExactDouble(stats.nanos(op.percentile(q.second)));
+            }
+            json.append(",\"max_ns\":");
+            json.appendExactDouble(stats.nanos(op.maxTicks));
+            json.append(",\"buckets\":[");
+            bool firstBucket = true;
+            for (size_t b = 0; b < op.buckets.size(); b++) {
+                if (op.buckets[b] == 0) continue;
+                json.append(firstBucket ? "[" : ",[");
+                firstBucket = false;
+                json.appendExactDouble(stats.nanos(LatencyBuckets::lowerBound(b)));
+                json.append(',');
+                json.appendInt((long long)op.buckets[b]);
+                json.append(']');
+            }
+            json.append("]}");
+        }
+        json.append("}}\n");
+
+        string temporary = filename + ".tmp";
+        ofstream file(temporary, ios::binary);
+        file.write(json.data(), streamsize(json.size()));
+        file.close();
+        if (!file || rename(temporary.c_str(), filename.c_str()) != 0) {
+            remove(temporary.c_str());
+            *out << "Error writing " << filename << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    // Group-commits whatever the log (and the history) has buffered.
+    bool commitLog() {
+        if (history) history->commit();
+        if (!log) return true;
+        OpTimer timer(StatOp::CommitLog);
+        if (log->commit()) return true;
+        timer.miss();
+        return false;
+    }
+
+    // Folds the log into a fresh snapshot and empties it, once the snapshot
+    // is safely on disk.
+    bool compactLog() {
+        if (!log) return false;
+        OpTimer timer(StatOp::CompactLog);
+        log->commit();
+        bool wasQuiet = quiet;
+        quiet = true;
+        bool saved = saveSnapshot(logSnapshotFile);
+        quiet = wasQuiet;
+        if (saved && log->truncate()) return true;
+        timer.miss();
+        return false;
+    }
+
+    void closeLog() {
+        log.reset();
+        logSnapshotFile.clear();
+    }
+
+    // Loads the history in filename (see HistoryStore) and records every
+    // change there from now on. What differs from the current contents is
+    // recorded first, so the history starts out up to date.
+    bool openHistory(const string& filename) {
+        closeHistory();
+        history.reset(new HistoryStore());
+        if (!history->open(filename)) {
+            history.reset();
+            *out << "Error: Could not open history " << filename << '\n';
+            return false;
+        }
+        recordAllHistory();
+        history->commit();
+        if (!quiet) {
+            *out << "History has " << history->changeCount() << " changes to " << history->productCount()
+                 << " products.\n";
+        }
+        return true;
+    }
+
+    void closeHistory() { history.reset(); }
+
+    // Every recorded change of id, oldest first. These return false only
+    // if the history is off.
+    bool printProductHistory(int id) {
+        OpTimer timer(StatOp::History);
+        if (!history) {
+            timer.miss();
+            *out << "History is off.\n";
+            return false;
+        }
+        vector<HistoryPoint> points = history->productHistory(id);
+        if (points.empty()) {
+            timer.miss();
+            *out << "No history for product " << id << ".\n";
+            return true;
+        }
+        *out << "History of product " << id << " (" << points.size() << " changes):\n";
+        bool existed = false;
+        for (const HistoryPoint& point : points) {
+            *out << formatHistoryTime(point.time) << "  ";
+            if (!point.exists) {
+                *out << "removed\n";
+            } else {
+                *out << (existed ? "" : "added: ") << "Rs." << point.price << " x " << point.quantity << ", margin "
+                     << point.margin << "%\n";
+            }
+            existed = point.exists;
+        }
+        return true;
+    }
+
+    // id's price, quantity and margin as of time.
+    bool printProductAsOf(int id, int64_t time) {
+        OpTimer timer(StatOp::History);
+        if (!history) {
+            timer.miss();
+            *out << "History is off.\n";
+            return false;
+        }
+        HistoryPoint point = history->productAt(id, time);
+        *out << "As of " << formatHistoryTime(time) << ", product " << id;
+        if (!point.exists) {
+            timer.miss();
+            *out << " did not exist.\n";
+            return true;
+        }
+        *out << ": Rs." << point.price << " x " << point.quantity << ", margin " << point.margin
+             << "%, stock value Rs." << point.price * point.quantity << " (since "
+             << formatHistoryTime(point.time) << ")\n";
+        return true;
+    }
+
+    bool printTotalsAsOf(int64_t time) {
+        OpTimer timer(StatOp::History);
+        if (!history) {
+            timer.miss();
+            *out << "History is off.\n";
+            return false;
+        }
+        TotalsPoint totals = history->totalsAt(time);
+        *out << "As of " << formatHistoryTime(time) << ":\n"
+             << "Total Inventory Value: Rs." << totals.totalRevenue << '\n'
+             << "Estimated Profit: Rs." << totals.totalProfit << '\n';
+        return true;
+    }
+
+    // From now on saves to filename on a background thread (see Autosaver),
+    // in saveInventoryToFile's format. Changes are handed over once
+    // options.changes of them are unsaved, or, at pollAutosave, once the
+    // oldest is options.interval old. The first hand-over after loadSnapshot
+    // copies the mapped rows in, as view() does.
+    bool startAutosave(const string& filename, AutosaveOptions options = AutosaveOptions()) {
+        stopAutosave();
+        // Fail here rather than in the background if the file can't be made.
+        string temporary = filename + ".tmp";
+        if (!ofstream(temporary, ios::binary).is_open()) {
+            *out << "Error: Could not write " << temporary << '\n';
+            return false;
+        }
+        remove(temporary.c_str());
+        autosaver.reset(new Autosaver(filename));
+        autosaveOptions = options;
+        unsavedChanges = 0;
+        reportedAutosaveFailures = 0;
+        // The file starts out saving what is here already.
+        if (size() > 0) changed();
+        if (!quiet) *out << "Autosaving to " << filename << ".\n";
+        return true;
+    }
+
+    // Hands the unsaved changes over if they are due and the last save is
+    // done. With idle set it hands them over now, to be written when due:
+    // call it so before waiting for input, as no change will come meanwhile
+    // to do it. Also reports saves that failed since the last call.
+    void pollAutosave(bool idle = false) {
+        if (!autosaver) return;
+        reportAutosaveFailures(autosaver->status());
+        if (unsavedChanges == 0) return;
+        Autosaver::Clock::time_point due = oldestUnsaved + autosaveOptions.interval;
+        if (idle || (!autosaver->busy() && Autosaver::Clock::now() >= due)) submitAutosave(due);
+    }
+
+    // Saves whatever is unsaved, waits for it, and stops autosaving. Returns
+    // false if a save failed.
+    bool stopAutosave() {
+        if (!autosaver) return true;
+        if (unsavedChanges > 0) submitAutosave(Autosaver::Clock::now());
+        autosaver->stop();
+        AutosaveStatus status = autosaver->status();
+        bool ok = status.failures == reportedAutosaveFailures;
+        reportAutosaveFailures(status);
+        autosaver.reset();
+        return ok;
+    }
+
+    void printAutosaveStatus() {
+        if (!autosaver) {
+            *out << "Autosave is off.\n";
+            return;
+        }
+        AutosaveStatus status = autosaver->status();
+        *out << "Autosaving to " << autosaver->file() << ": " << status.saves << " saves, " << status.failures
+             << " failed, " << status.superseded << " superseded before written, " << unsavedChanges + status.pendingChanges << " changes not on disk yet\n";
+        if (status.saves > 0) {
+            *out << "Last save took " << status.lastSeconds * 1000 << " ms (slowest " << status.maxSeconds * 1000
+                 << " ms)\n";
+            *out << "Last save was on disk " << status.lastLagSeconds * 1000 << " ms after its oldest change (worst "
+                 << status.maxLagSeconds * 1000 << " ms)\n";
+        }
+        if (!status.lastError.empty()) *out << "Last error: " << status.lastError << '\n';
+        reportedAutosaveFailures = status.failures;
+    }
+};
+
+#endif
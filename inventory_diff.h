@@ -0,0 +1,426 @@
+#ifndef INVENTORY_DIFF_H
+#define INVENTORY_DIFF_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include "csv_loader.h"
+#include "exporter.h"
+
+using namespace std;
+
+// One product on either side of a diff. The strings belong to whoever
+// produced the row and stay valid until it produces the next one.
+struct DiffRow {
+    int id;
+    string_view name;
+    string_view category;
+    double price;
+    int quantity;
+    double margin;
+};
+
+// The value a saveInventoryToFile line holds for value (%g, 6 significant
+// digits), so live products compare equal to what saving them would write.
+inline double savedDouble(double value) {
+    char text[32];
+    char* end = to_chars(text, text + sizeof(text), value, chars_format::general, 6).ptr;
+    double saved = value;
+    from_chars(text, end, saved);
+    return saved;
+}
+
+inline DiffRow diffRowOf(const Product& product) {
+    return {product.getId(), product.getName(), product.getCategory(), savedDouble(product.getPrice()),
+            product.getQuantity(), savedDouble(product.getMargin())};
+}
+
+// Reads a saveInventoryToFile-format file front to back through one fixed
+// buffer, so memory does not grow with the file. Rows must come in
+// ascending id order, as saveInventoryToFile writes them; of a run of lines
+// with the same id the last wins, as when loading. An id lower than the one
+// before it stops the reader with an error.
+class CsvRowReader {
+public:
+    static constexpr size_t maxRejects = 10;
+
+private:
+    struct Held {
+        DiffRow row;
+        string name;
+        string category;
+    };
+
+    string filename;
+    int fd = -1;
+    vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool atEof = false;
+    size_t lineNumber = 0;
+    uint64_t bytes = 0;
+    // The row next() returned last and the one read ahead of it.
+    Held held[2];
+    size_t current = 0;
+    bool hasAhead = false;
+    size_t rows = 0;
+    vector<size_t> rejects;
+    size_t rejectCount = 0;
+    string failure;
+
+    bool readLine(const char*& lineBegin, const char*& lineEnd) {
+        for (;;) {
+            const char* p = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(memchr(p, '\n', end - begin));
+            if (newline || (atEof && begin < end)) {
+                lineBegin = p;
+                lineEnd = newline ? newline : buffer.data() + end;
+                begin = size_t(lineEnd - buffer.data()) + (newline ? 1 : 0);
+                lineNumber++;
+                return true;
+            }
+            if (atEof) return false;
+            // Keep the partial line, and make room for one longer than the
+            // whole buffer.
+            memmove(buffer.data(), p, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+            ssize_t n = ::read(fd, buffer.data() + end, buffer.size() - end);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                failure = "could not read " + filename + ": " + strerror(errno);
+                return false;
+            }
+            if (n == 0) atEof = true;
+            end += size_t(n);
+            bytes += uint64_t(n);
+        }
+    }
+
+    // Reads the next line that parses into held slot.
+    bool readRow(size_t slot) {
+        const char* lineBegin;
+        const char* lineEnd;
+        CsvFields fields;
+        while (readLine(lineBegin, lineEnd)) {
+            if (!parseCsvLine(lineBegin, lineEnd, fields)) {
+                if (rejects.size() < maxRejects) rejects.push_back(lineNumber);
+                rejectCount++;
+                continue;
+            }
+            Held& h = held[slot];
+            h.name.assign(fields.name, fields.nameLength);
+            h.category.assign(fields.category, fields.categoryLength);
+            h.row = {fields.id, h.name, h.category, fields.price, fields.quantity, fields.margin};
+            return true;
+        }
+        return false;
+    }
+
+public:
+    explicit CsvRowReader(string filename, size_t bufferBytes = size_t(1) << 20)
+        : filename(move(filename)), buffer(bufferBytes) {}
+
+    CsvRowReader(const CsvRowReader&) = delete;
+    CsvRowReader& operator=(const CsvRowReader&) = delete;
+
+    ~CsvRowReader() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool open() {
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            failure = "could not open " + filename;
+            return false;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        hasAhead = readRow(1 - current);
+        return failure.empty();
+    }
+
+    // The next product, or false at the end of the file or on an error.
+    // row stays valid until the next call.
+    bool next(DiffRow& row) {
+        if (!hasAhead || !failure.empty()) return false;
+        current = 1 - current;
+        while ((hasAhead = readRow(1 - current))) {
+            int id = held[1 - current].row.id;
+            if (id > held[current].row.id) break;
+            if (id < held[current].row.id) {
+                failure = filename + " is not sorted by id (line " + to_string(lineNumber)
+                    + "); save it with saveInventoryToFile first";
+                return false;
+            }
+            current = 1 - current;
+        }
+        if (!failure.empty()) return false;
+        row = held[current].row;
+        rows++;
+        return true;
+    }
+
+    const string& file() const { return filename; }
+    bool failed() const { return !failure.empty(); }
+    const string& error() const { return failure; }
+    size_t rowCount() const { return rows; }
+    uint64_t bytesRead() const { return bytes; }
+    // The first maxRejects line numbers that could not be parsed, and how
+    // many there were.
+    const vector<size_t>& rejectedLines() const { return rejects; }
+    size_t rejectedCount() const { return rejectCount; }
+};
+
+struct DiffSide {
+    size_t products = 0;
+    long long units = 0;
+    double revenue = 0;
+    double profit = 0;
+
+    void add(const DiffRow& row) {
+        double value = row.price * row.quantity;
+        products++;
+        units += row.quantity;
+        revenue += value;
+        profit += value * (row.margin / 100);
+    }
+};
+
+struct DiffSummary {
+    size_t added = 0;
+    size_t removed = 0;
+    size_t changed = 0;
+    size_t unchanged = 0;
+    DiffSide before;
+    DiffSide after;
+};
+
+enum class DiffFormat {
+    Text,  // one line per product, for reading
+    Csv    // one row per product under a header, for spreadsheets
+};
+
+// Sorted merge-join of two inventories. The "before" rows are pushed in
+// ascending id order with before(); the "after" rows are pulled from a
+// CsvRowReader as the join needs them, so the before side can be a file or
+// a walk over the live Inventory. Added, removed and changed products are
+// written to out as they are found, with their field deltas and what they
+// do to stock value and profit; unchanged ones are only counted. Nothing
+// is kept but the current row of each side.
+class InventoryDiff {
+private:
+    static constexpr size_t flushBytes = size_t(1) << 16;
+
+    CsvRowReader& afterRows;
+    ostream& out;
+    DiffFormat format;
+    TextBuffer text;
+    DiffRow next;
+    bool hasNext;
+    DiffSummary summary;
+
+    static bool same(double a, double b) { return a == b || (isnan(a) && isnan(b)); }
+
+    static double profitOf(const DiffRow& row) { return row.price * row.quantity * (row.margin / 100); }
+
+    void pull() { hasNext = afterRows.next(next); }
+
+    void flush() {
+        if (text.size() == 0) return;
+        out.write(text.data(), streamsize(text.size()));
+        text.clear();
+    }
+
+    void appendSigned(double value) {
+        if (value > 0) text.append('+');
+        text.appendDouble(value);
+    }
+
+    // A CSV row: either side may be missing.
+    void csvRow(const char* status, const DiffRow* a, const DiffRow* b) {
+        const DiffRow& any = a ? *a : *b;
+        auto both = [&](auto field) {
+            if (a) field(*a);
+            text.append(',');
+            if (b) field(*b);
+            text.append(',');
+        };
+        text.append(status);
+        text.append(',');
+        text.appendInt(any.id);
+        text.append(',');
+        both([this](const DiffRow& r) { text.append(r.name); });
+        both([this](const DiffRow& r) { text.append(r.category); });
+        both([this](const DiffRow& r) { text.appendDouble(r.price); });
+        if (a && b) text.appendDouble(b->price - a->price);
+        text.append(',');
+        both([this](const DiffRow& r) { text.appendInt(r.quantity); });
+        text.appendInt((b ? (long long)b->quantity : 0) - (a ? a->quantity : 0));
+        text.append(',');
+        both([this](const DiffRow& r) { text.appendDouble(r.margin); });
+        if (a && b) text.appendDouble(b->margin - a->margin);
+        text.append(',');
+        text.appendDouble((b ? b->price * b->quantity : 0) - (a ? a->price * a->quantity : 0));
+        text.append(',');
+        text.appendDouble((b ? profitOf(*b) : 0) - (a ? profitOf(*a) : 0));
+        text.append('\n');
+    }
+
+    void textImpact(double value, double profit) {
+        text.append(" (value ");
+        appendSigned(value);
+        text.append(", profit ");
+        appendSigned(profit);
+        text.append(")\n");
+    }
+
+    void onlyIn(char mark, const DiffRow& row) {
+        if (format == DiffFormat::Csv) {
+            if (mark == '+') csvRow("added", nullptr, &row);
+            else csvRow("removed", &row, nullptr);
+            return;
+        }
+        double sign = mark == '+' ? 1 : -1;
+        text.append(mark);
+        text.append(' ');
+        text.appendInt(row.id);
+        text.append(' ');
+        text.append(row.name);
+        text.append(", ");
+        text.append(row.category);
+        text.append(": ");
+        text.appendInt(row.quantity);
+        text.append(" x Rs.");
+        text.appendDouble(row.price);
+        text.append(", margin ");
+        text.appendDouble(row.margin);
+        text.append('%');
+        textImpact(sign * row.price * row.quantity, sign * profitOf(row));
+    }
+
+    void compare(const DiffRow& a, const DiffRow& b) {
+        bool name = a.name != b.name, category = a.category != b.category;
+        bool price = !same(a.price, b.price), quantity = a.quantity != b.quantity;
+        bool margin = !same(a.margin, b.margin);
+        if (!(name || category || price || quantity || margin)) {
+            summary.unchanged++;
+            return;
+        }
+        summary.changed++;
+        if (format == DiffFormat::Csv) {
+            csvRow("changed", &a, &b);
+            return;
+        }
+        text.append("~ ");
+        text.appendInt(a.id);
+        text.append(' ');
+        text.append(b.name);
+        const char* separator = ": ";
+        auto field = [&](const char* label) {
+            text.append(separator);
+            text.append(label);
+            text.append(' ');
+            separator = ", ";
+        };
+        if (name) {
+            field("name");
+            text.append(a.name);
+            text.append(" -> ");
+            text.append(b.name);
+        }
+        if (category) {
+            field("category");
+            text.append(a.category);
+            text.append(" -> ");
+            text.append(b.category);
+        }
+        if (quantity) {
+            field("quantity");
+            text.appendInt(a.quantity);
+            text.append(" -> ");
+            text.appendInt(b.quantity);
+            text.append(" (");
+            long long delta = (long long)b.quantity - a.quantity;
+            if (delta > 0) text.append('+');
+            text.appendInt(delta);
+            text.append(')');
+        }
+        if (price) {
+            field("price");
+            text.appendDouble(a.price);
+            text.append(" -> ");
+            text.appendDouble(b.price);
+            text.append(" (");
+            appendSigned(b.price - a.price);
+            text.append(')');
+        }
+        if (margin) {
+            field("margin");
+            text.appendDouble(a.margin);
+            text.append("% -> ");
+            text.appendDouble(b.margin);
+            text.append('%');
+        }
+        textImpact(b.price * b.quantity - a.price * a.quantity, profitOf(b) - profitOf(a));
+    }
+
+public:
+    InventoryDiff(CsvRowReader& afterRows, ostream& out, DiffFormat format)
+        : afterRows(afterRows), out(out), format(format) {
+        if (format == DiffFormat::Csv) {
+            text.append("status,id,name_before,name_after,category_before,category_after,price_before,"
+                        "price_after,price_delta,quantity_before,quantity_after,quantity_delta,margin_before,"
+                        "margin_after,margin_delta,value_delta,profit_delta\n");
+        }
+        pull();
+    }
+
+    // Joins the next before row, which must have a higher id than the last.
+    // Returns false once the after side has failed.
+    bool before(const DiffRow& row) {
+        if (afterRows.failed()) return false;
+        summary.before.add(row);
+        while (hasNext && next.id < row.id) {
+            summary.added++;
+            summary.after.add(next);
+            onlyIn('+', next);
+            pull();
+        }
+        if (hasNext && next.id == row.id) {
+            summary.after.add(next);
+            compare(row, next);
+            pull();
+        } else {
+            summary.removed++;
+            onlyIn('-', row);
+        }
+        if (text.size() >= flushBytes) flush();
+        return true;
+    }
+
+    // Emits what is left of the after side. False if it failed.
+    bool finish() {
+        while (hasNext) {
+            summary.added++;
+            summary.after.add(next);
+            onlyIn('+', next);
+            if (text.size() >= flushBytes) flush();
+            pull();
+        }
+        flush();
+        return !afterRows.failed();
+    }
+
+    const DiffSummary& result() const { return summary; }
+};
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef INVENTORY_SERVER_H
+#define INVENTORY_SERVER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/tcp.h>
+#include "inventory.h"
+#include "server_protocol.h"
+
+using namespace std;
+
+struct ServerOptions {
+    // Requests run for one connection before the loop moves on to the
+    // next, so a client with thousands in flight can't hold up the rest.
+    size_t requestsPerTurn = 256;
+    // A connection with more unsent responses than this is neither read
+    // nor run until the client takes them.
+    size_t maxOutputBytes = size_t(1) << 20;
+    size_t maxConnections = 65536;
+};
+
+struct ServerStats {
+    uint64_t accepted = 0;
+    // Over maxConnections or out of descriptors: closed at once.
+    uint64_t refused = 0;
+    size_t peakConnections = 0;
+    uint64_t requests = 0;
+    uint64_t badRequests = 0;
+    // Turns of the loop that ran requests; each ran its requests under one
+    // log commit.
+    uint64_t turns = 0;
+};
+
+// Serves an Inventory to local clients over the protocol in
+// server_protocol.h, from one thread, so the Inventory needs no locks.
+// Each turn of the loop waits in epoll for ready sockets, reads whatever
+// they have sent, and runs the complete requests in order, up to
+// requestsPerTurn per connection. The log is committed once for the turn,
+// and only then are the responses sent, with one send() per connection:
+// pipelined requests and requests from many clients at once share the
+// system calls and the group commit, and none is acknowledged before it
+// is logged.
+//
+// SIGINT and SIGTERM stop the loop; blockStopSignals() must run before any
+// thread starts so they reach it.
+class InventoryServer {
+private:
+    static constexpr int idleWaitMs = 100;
+
+    struct Connection {
+        int fd = -1;
+        vector<char> input;
+        // Bytes of input already run.
+        size_t inputStart = 0;
+        vector<char> output;
+        size_t outputStart = 0;
+        // What epoll watches for.
+        uint32_t events = 0;
+        // The client has stopped sending.
+        bool eof = false;
+        // In pending or touched.
+        bool queued = false;
+        bool touched = false;
+
+        size_t unsent() const { return output.size() - outputStart; }
+
+        bool hasRequest() const {
+            size_t available = input.size() - inputStart;
+            if (available < 4) return false;
+            uint32_t length;
+            memcpy(&length, input.data() + inputStart, 4);
+            return length > maxFrameBytes || available - 4 >= length;
+        }
+    };
+
+    Inventory& inventory;
+    ServerOptions options;
+    ServerStats counts;
+    ServerAddress address;
+    int listenFd = -1;
+    int epollFd = -1;
+    int signalFd = -1;
+    // Held open so that when descriptors run out one can be freed to
+    // accept and close a connection, rather than leave it queued.
+    int spareFd = -1;
+    // By descriptor. The kernel hands out the lowest free one, so this
+    // stays about as long as the number of connections.
+    vector<unique_ptr<Connection>> connections;
+    size_t connectionCount = 0;
+    // Connections with requests left to run.
+    vector<int> pending;
+    // Connections to send to and settle at the end of the turn.
+    vector<int> touched;
+    // Every read lands here first; connections keep only what arrived.
+    vector<char> received = vector<char>(size_t(64) << 10);
+    bool stopping = false;
+    ostream* out = &cout;
+    // The Inventory's own messages are not for the clients.
+    ostream discard{nullptr};
+
+    static sigset_t stopSignals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        return signals;
+    }
+
+    Connection* connection(int fd) const {
+        return fd >= 0 && size_t(fd) < connections.size() ? connections[fd].get() : nullptr;
+    }
+
+    bool watch(Connection& c, uint32_t events) {
+        if (events == c.events) return true;
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = c.fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &event) != 0) return false;
+        c.events = events;
+        return true;
+    }
+
+    void queue(Connection& c) {
+        if (c.queued) return;
+        c.queued = true;
+        pending.push_back(c.fd);
+    }
+
+    void touch(Connection& c) {
+        if (c.touched) return;
+        c.touched = true;
+        touched.push_back(c.fd);
+    }
+
+    void closeConnection(Connection& c) {
+        int fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections[fd].reset();
+        connectionCount--;
+    }
+
+    void acceptConnections() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if ((errno == EMFILE || errno == ENFILE) && spareFd >= 0) {
+                    ::close(spareFd);
+                    fd = accept(listenFd, nullptr, nullptr);
+                    if (fd >= 0) ::close(fd);
+                    spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    counts.refused++;
+                    continue;
+                }
+                return;
+            }
+            if (connectionCount >= options.maxConnections) {
+                ::close(fd);
+                counts.refused++;
+                continue;
+            }
+            if (!address.local) {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            }
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                counts.refused++;
+                continue;
+            }
+            if (size_t(fd) >= connections.size()) connections.resize(size_t(fd) + 1);
+            connections[fd].reset(new Connection());
+            connections[fd]->fd = fd;
+            connections[fd]->events = EPOLLIN;
+            connectionCount++;
+            counts.accepted++;
+            counts.peakConnections = max(counts.peakConnections, connectionCount);
+        }
+    }
+
+    // Reads what the client has sent, up to a few blocks so one busy
+    // client can't starve the others; epoll reports the rest next turn.
+    void receive(Connection& c) {
+        if (c.inputStart > 0 && c.inputStart * 2 >= c.input.size()) {
+            c.input.erase(c.input.begin(), c.input.begin() + ptrdiff_t(c.inputStart));
+            c.inputStart = 0;
+        }
+        for (int round = 0; round < 4; round++) {
+            ssize_t n = ::recv(c.fd, received.data(), received.size(), 0);
+            if (n > 0) {
+                c.input.insert(c.input.end(), received.data(), received.data() + n);
+                continue;
+            }
+            if (n == 0) {
+                c.eof = true;
+            } else if (errno == EINTR) {
+                round--;
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closeConnection(c);
+                return;
+            }
+            break;
+        }
+        if (c.hasRequest()) queue(c);
+        touch(c);
+    }
+
+    // Runs one request and appends its response.
+    void run(const char* payload, size_t size, vector<char>& output) {
+        FrameWriter response(output);
+        response.begin();
+        ServerRequest request;
+        counts.requests++;
+        if (!decodeRequest(payload, size, request)) {
+            counts.badRequests++;
+            response.put(uint8_t(ResponseStatus::BadRequest));
+            response.end();
+            return;
+        }
+        bool ok = true;
+        size_t status = output.size();
+        response.put(uint8_t(ResponseStatus::Ok));
+        switch (request.op) {
+            case RequestOp::Add:
+                ok = inventory.addProduct(Product(request.id, request.name, request.category, request.price,
+                                                  request.quantity, request.margin));
+                break;
+            case RequestOp::Update:
+                ok = inventory.updateProduct(request.id, request.name, request.category, request.price,
+                                             request.quantity, request.margin);
+                break;
+            case RequestOp::Remove:
+                ok = inventory.removeProduct(request.id);
+                break;
+            case RequestOp::Adjust:
+                ok = inventory.adjustQuantity(request.id, request.delta);
+                break;
+            case RequestOp::Find:
+                ok = inventory.readProduct(request.id, [&response](const Product& p) {
+                    response.putProduct(p.getId(), p.getPrice(), p.getQuantity(), p.getMargin(), p.getName(),
+                                        p.getCategory());
+                });
+                break;
+            case RequestOp::Totals:
+                response.put(uint64_t(inventory.size()));
+                response.put(inventory.getTotalRevenue());
+                response.put(inventory.getTotalProfit());
+                break;
+        }
+        if (!ok) output[status] = char(ResponseStatus::Failed);
+        response.end();
+    }
+
+    // Runs up to requestsPerTurn of c's complete requests. False if c sent
+    // a frame too large to take, and was closed.
+    bool runRequests(Connection& c) {
+        for (size_t done = 0; done < options.requestsPerTurn && c.hasRequest(); done++) {
+            uint32_t length;
+            memcpy(&length, c.input.data() + c.inputStart, 4);
+            if (length > maxFrameBytes) {
+                closeConnection(c);
+                return false;
+            }
+            run(c.input.data() + c.inputStart + 4, length, c.output);
+            c.inputStart += 4 + size_t(length);
+        }
+        return true;
+    }
+
+    // Sends what it can without waiting, then decides what c waits for
+    // next, or closes it once the client is done and has every response.
+    void settle(Connection& c) {
+        while (c.unsent() > 0) {
+            ssize_t n = ::send(c.fd, c.output.data() + c.outputStart, c.unsent(), MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                closeConnection(c);
+                return;
+            }
+            c.outputStart += size_t(n);
+        }
+        if (c.unsent() == 0) {
+            c.output.clear();
+            c.outputStart = 0;
+        } else if (c.outputStart * 2 >= c.output.size()) {
+            c.output.erase(c.output.begin(), c.output.begin() + ptrdiff_t(c.outputStart));
+            c.outputStart = 0;
+        }
+        bool backlogged = c.unsent() >= options.maxOutputBytes;
+        if (!backlogged && c.hasRequest()) queue(c);
+        if (c.eof && c.unsent() == 0 && !c.queued) {
+            closeConnection(c);
+            return;
+        }
+        uint32_t events = 0;
+        if (!c.eof && !backlogged) events |= EPOLLIN;
+        if (c.unsent() > 0) events |= EPOLLOUT;
+        if (!watch(c, events)) closeConnection(c);
+    }
+
+    bool fail(const string& message) {
+        *out << "Server error: " << message << ": " << strerror(errno) << '\n';
+        return false;
+    }
+
+    bool listen(const string& addressText) {
+        string error;
+        if (!parseServerAddress(addressText, address, error)) {
+            *out << "Server error: " << error << '\n';
+            return false;
+        }
+        if (address.local) {
+            // A socket left by a server that is gone; a live one is kept.
+            struct stat st;
+            if (stat(address.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+                int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                bool live = probe >= 0 && connect(probe, address.get(), address.length) == 0;
+                if (probe >= 0) ::close(probe);
+                if (live) {
+                    *out << "Server error: a server is already listening on " << address.path << '\n';
+                    return false;
+                }
+                unlink(address.path.c_str());
+            }
+        }
+        listenFd = socket(address.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) return fail("could not create a socket");
+        int on = 1;
+        if (!address.local) setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(listenFd, address.get(), address.length) != 0) return fail("could not bind " + addressText);
+        if (::listen(listenFd, SOMAXCONN) != 0) return fail("could not listen on " + addressText);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) return fail("could not create an epoll instance");
+        sigset_t signals = stopSignals();
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signalFd < 0) return fail("could not watch for signals");
+        for (int fd : {listenFd, signalFd}) {
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) return fail("could not watch the listener");
+        }
+        spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return true;
+    }
+
+    void turn() {
+        epoll_event events[1024];
+        int n = epoll_wait(epollFd, events, 1024, pending.empty() ? idleWaitMs : 0);
+        if (n < 0 && errno != EINTR) {
+            fail("epoll_wait failed");
+            stopping = true;
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            if (fd == signalFd) {
+                signalfd_siginfo info;
+                while (::read(signalFd, &info, sizeof(info)) == ssize_t(sizeof(info))) stopping = true;
+                continue;
+            }
+            Connection* c = connection(fd);
+            if (!c) continue;
+            if (events[i].events & EPOLLERR) {
+                closeConnection(*c);
+                continue;
+            }
+            if ((events[i].events & (EPOLLIN | EPOLLHUP)) && (c->events & EPOLLIN)) {
+                receive(*c);
+            } else {
+                touch(*c);
+            }
+        }
+
+        vector<int> runNow;
+        runNow.swap(pending);
+        size_t before = counts.requests;
+        for (int fd : runNow) {
+            Connection* c = connection(fd);
+            if (!c) continue;
+            c->queued = false;
+            // Its turn comes again once the client has taken some output.
+            if (c->unsent() >= options.maxOutputBytes) continue;
+            if (!runRequests(*c)) continue;
+            touch(*c);
+        }
+        if (counts.requests > before) {
+            counts.turns++;
+            inventory.commitLog();
+        }
+        inventory.pollAutosave();
+
+        vector<int> sendNow;
+        sendNow.swap(touched);
+        for (int fd : sendNow) {
+            Connection* c = connection(fd);
+            if (!c) continue;
+            c->touched = false;
+            settle(*c);
+        }
+    }
+
+    void shutdown() {
+        for (auto& c : connections) {
+            if (!c) continue;
+            // What was run has been committed; send what goes without waiting.
+            if (c->unsent() > 0) ::send(c->fd, c->output.data() + c->outputStart, c->unsent(), MSG_NOSIGNAL);
+            closeConnection(*c);
+        }
+        for (int* fd : {&listenFd, &epollFd, &signalFd, &spareFd}) {
+            if (*fd >= 0) ::close(*fd);
+            *fd = -1;
+        }
+        if (address.local) unlink(address.path.c_str());
+        pending.clear();
+        touched.clear();
+    }
+
+public:
+    explicit InventoryServer(Inventory& inventory, ServerOptions options = ServerOptions())
+        : inventory(inventory), options(options) {}
+    InventoryServer(const InventoryServer&) = delete;
+    InventoryServer& operator=(const InventoryServer&) = delete;
+    ~InventoryServer() { shutdown(); }
+
+    // Blocks SIGINT and SIGTERM in the calling thread and the threads it
+    // starts afterwards; serve() takes them from a signalfd instead.
+    static void blockStopSignals() {
+        sigset_t signals = stopSignals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+
+    void setOutput(ostream& stream) { out = &stream; }
+
+    // Listens on addressText (see parseServerAddress) and serves until
+    // SIGINT or SIGTERM. Returns false if it could not listen.
+    bool serve(const string& addressText) {
+        stopping = false;
+        counts = ServerStats();
+        if (!listen(addressText)) {
+            shutdown();
+            return false;
+        }
+        size_t descriptors = raiseFileLimit();
+        inventory.setQuiet(true);
+        inventory.setOutput(discard);
+        *out << "Serving on " << (address.local ? address.path : "127.0.0.1:" + addressText) << " (up to "
+             << min(options.maxConnections, descriptors) << " connections)" << endl;
+        while (!stopping) turn();
+        shutdown();
+        return true;
+    }
+
+    const ServerStats& stats() const { return counts; }
+
+    void printStats() const {
+        *out << "Served " << counts.requests << " requests (" << counts.badRequests << " malformed) on "
+             << counts.accepted << " connections (at most " << counts.peakConnections << " at once, "
+             << counts.refused << " refused)\n";
+        if (counts.turns > 0) {
+            *out << "Requests per turn (and per log commit): " << double(counts.requests) / double(counts.turns)
+                 << '\n';
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,470 @@
+// Load generator for the inventory server (main_with_TC_logn --serve=ADDR).
+//
+//   g++ -std=c++17 -O2 -pthread -o loadgen loadgen.cpp
+//   ./loadgen --connect=ADDR [--clients=1000] [--pipeline=8] [--requests=1000000] [--threads=1]
+//             [--ids=100000] [--mix=find:80,adjust:10,update:8,add:1,remove:1,totals:0]
+//             [--no-preload] [--seed=42] [--out=results.jsonl]
+//
+// ADDR is a port on 127.0.0.1 or a Unix socket path. Each client is one
+// connection that keeps --pipeline requests in flight until it has had
+// answers to its share of --requests; the clients are split over --threads,
+// each running its own epoll loop. Ids are drawn uniformly from 1..--ids,
+// which are added first unless --no-preload is given. A request's latency
+// runs from when it is handed to send() to when its response has been read.
+// Results are one JSON object per line, like benchmark.cpp's: "failed"
+// counts requests the inventory refused (an add of an id that exists, a
+// remove of one that doesn't), "errors" malformed or missing responses.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "server_protocol.h"
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+struct Options {
+    string address;
+    size_t clients = 1000;
+    size_t pipeline = 8;
+    size_t requests = 1000000;
+    size_t threads = 1;
+    int ids = 100000;
+    // Weights by RequestOp, Add first.
+    vector<unsigned> mix = {1, 80, 8, 1, 10, 0};
+    bool preload = true;
+    unsigned long long seed = 42;
+    string out;
+};
+
+static const char* const opNames[] = {"add", "find", "update", "remove", "adjust", "totals"};
+
+static const char* const categories[] = {
+    "Grocery", "Stationery", "Electronics", "Hardware", "Toys", "Clothing", "Books", "Kitchen",
+};
+
+static bool parseMix(const string& value, vector<unsigned>& mix) {
+    mix.assign(6, 0);
+    stringstream ss(value);
+    string item;
+    while (getline(ss, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == string::npos) return false;
+        string name = item.substr(0, colon);
+        auto it = find_if(begin(opNames), end(opNames), [&name](const char* op) { return name == op; });
+        if (it == end(opNames)) return false;
+        mix[size_t(it - begin(opNames))] = unsigned(stoul(item.substr(colon + 1)));
+    }
+    return any_of(mix.begin(), mix.end(), [](unsigned weight) { return weight > 0; });
+}
+
+static int connectTo(const ServerAddress& address, bool nonblocking) {
+    int fd = socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, address.get(), address.length) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (!address.local) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    if (nonblocking) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// One connection and the requests it has in flight, oldest first.
+struct Client {
+    int fd = -1;
+    size_t toSend = 0;
+    size_t outstanding = 0;
+    vector<char> output;
+    size_t outputStart = 0;
+    vector<char> input;
+    size_t inputStart = 0;
+    vector<RequestOp> ops;
+    vector<Clock::time_point> sentAt;
+    // Ring positions in ops/sentAt, which hold pipeline entries.
+    size_t head = 0;
+    size_t tail = 0;
+    // Answered in full, or lost.
+    bool done = false;
+};
+
+struct Tally {
+    size_t responses = 0;
+    size_t failed = 0;
+    size_t errors = 0;
+    // Nanoseconds.
+    vector<uint32_t> latencies;
+};
+
+// Runs clients to completion on the calling thread.
+class Driver {
+private:
+    const Options& options;
+    vector<Client*> clients;
+    mt19937_64 rng;
+    discrete_distribution<int> pickOp;
+    uniform_int_distribution<int> pickId;
+    string name;
+    Tally tally;
+    int epollFd = -1;
+
+    void enqueue(Client& c, RequestOp op, int id, Clock::time_point now) {
+        ServerRequest request;
+        request.op = op;
+        request.id = id;
+        if (op == RequestOp::Add || op == RequestOp::Update) {
+            name = "Item " + to_string(id);
+            request.name = name;
+            request.category = categories[id % 8];
+            request.price = 1 + (id % 1000) * 0.25;
+            request.quantity = int(rng() % 500);
+            request.margin = 5 + id % 40;
+        } else if (op == RequestOp::Adjust) {
+            request.delta = rng() % 4 == 0 ? 10 : -1;
+        }
+        encodeRequest(c.output, request);
+        c.ops[c.tail] = op;
+        c.sentAt[c.tail] = now;
+        c.tail = (c.tail + 1) % c.ops.size();
+        c.outstanding++;
+        c.toSend--;
+    }
+
+    void fill(Client& c, Clock::time_point now) {
+        while (c.toSend > 0 && c.outstanding < options.pipeline) {
+            enqueue(c, RequestOp(pickOp(rng) + 1), pickId(rng), now);
+        }
+    }
+
+    void finish(Client& c) {
+        c.done = true;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+    }
+
+    bool flush(Client& c) {
+        while (c.outputStart < c.output.size()) {
+            ssize_t n = ::send(c.fd, c.output.data() + c.outputStart, c.output.size() - c.outputStart, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                return false;
+            }
+            c.outputStart += size_t(n);
+        }
+        if (c.outputStart == c.output.size()) {
+            c.output.clear();
+            c.outputStart = 0;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN | (c.output.empty() ? 0u : uint32_t(EPOLLOUT));
+        event.data.ptr = &c;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &event);
+        return true;
+    }
+
+    // Reads responses; false once the connection is lost.
+    bool receive(Client& c) {
+        char block[65536];
+        for (;;) {
+            ssize_t n = ::recv(c.fd, block, sizeof(block), 0);
+            if (n > 0) {
+                c.input.insert(c.input.end(), block, block + n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        Clock::time_point now = Clock::now();
+        ServerResponse response;
+        while (c.input.size() - c.inputStart >= 4 && c.outstanding > 0) {
+            uint32_t length;
+            memcpy(&length, c.input.data() + c.inputStart, 4);
+            if (c.input.size() - c.inputStart - 4 < length) break;
+            RequestOp op = c.ops[c.head];
+            uint64_t ns = uint64_t(chrono::duration_cast<chrono::nanoseconds>(now - c.sentAt[c.head]).count());
+            c.head = (c.head + 1) % c.ops.size();
+            c.outstanding--;
+            tally.responses++;
+            tally.latencies.push_back(uint32_t(min<uint64_t>(ns, UINT32_MAX)));
+            if (!decodeResponse(c.input.data() + c.inputStart + 4, length, op, response)
+                || response.status == ResponseStatus::BadRequest) {
+                tally.errors++;
+            } else if (response.status == ResponseStatus::Failed) {
+                tally.failed++;
+            }
+            c.inputStart += 4 + size_t(length);
+        }
+        if (c.inputStart == c.input.size()) {
+            c.input.clear();
+            c.inputStart = 0;
+        }
+        fill(c, now);
+        return true;
+    }
+
+public:
+    Driver(const Options& options, vector<Client*> clients, unsigned long long seed)
+        : options(options), clients(move(clients)), rng(seed), pickOp(options.mix.begin(), options.mix.end()),
+          pickId(1, max(1, options.ids)) {}
+
+    Tally run() {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        size_t active = 0;
+        size_t expected = 0;
+        for (Client* c : clients) expected += c->toSend;
+        tally.latencies.reserve(expected);
+        Clock::time_point now = Clock::now();
+        for (Client* c : clients) {
+            c->ops.resize(options.pipeline);
+            c->sentAt.resize(options.pipeline);
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.ptr = c;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, c->fd, &event);
+            fill(*c, now);
+            if (flush(*c) && c->outstanding > 0) {
+                active++;
+            } else {
+                finish(*c);
+            }
+        }
+        vector<epoll_event> events(1024);
+        while (active > 0) {
+            int n = epoll_wait(epollFd, events.data(), int(events.size()), 1000);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; i++) {
+                Client& c = *static_cast<Client*>(events[i].data.ptr);
+                if (c.done) continue;
+                bool ok = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ok = receive(c);
+                if (ok) ok = flush(c);
+                if (ok && (c.outstanding > 0 || c.toSend > 0)) continue;
+                finish(c);
+                active--;
+            }
+        }
+        for (Client* c : clients) tally.errors += c->outstanding + c->toSend;
+        ::close(epollFd);
+        return tally;
+    }
+};
+
+static double percentileUs(vector<uint32_t>& ns, double fraction) {
+    if (ns.empty()) return 0;
+    size_t k = min(ns.size() - 1, size_t(fraction * double(ns.size())));
+    nth_element(ns.begin(), ns.begin() + ptrdiff_t(k), ns.end());
+    return ns[k] / 1000.0;
+}
+
+static void report(ostream& out, const Options& options, const string& op, size_t clients, size_t threads,
+                   size_t pipeline, double seconds, Tally& tally) {
+    out << "{\"bench\":\"server\",\"address\":\"" << options.address << "\",\"op\":\"" << op
+        << "\",\"clients\":" << clients << ",\"threads\":" << threads << ",\"pipeline\":" << pipeline
+        << ",\"ops\":" << tally.responses << ",\"failed\":" << tally.failed << ",\"errors\":" << tally.errors
+        << ",\"seconds\":" << seconds << ",\"ops_per_sec\":" << (seconds > 0 ? tally.responses / seconds : 0);
+    // Percentiles last, as they reorder the latencies. Preloading doesn't
+    // time its requests.
+    if (!tally.latencies.empty()) {
+        out << ",\"p50_us\":" << percentileUs(tally.latencies, 0.5)
+            << ",\"p99_us\":" << percentileUs(tally.latencies, 0.99)
+            << ",\"p999_us\":" << percentileUs(tally.latencies, 0.999)
+            << ",\"max_us\":" << *max_element(tally.latencies.begin(), tally.latencies.end()) / 1000.0;
+    }
+    out << "}\n";
+    out.flush();
+}
+
+// Adds ids 1..options.ids over one connection, up to 1024 in flight.
+static bool preload(const Options& options, const ServerAddress& address, ostream& out) {
+    const size_t window = 1024;
+    int fd = connectTo(address, false);
+    if (fd < 0) return false;
+    Tally tally;
+    vector<char> frames;
+    vector<char> input;
+    char block[65536];
+    string name;
+    int next = 1;
+    size_t inFlight = 0;
+    auto start = Clock::now();
+    while (next <= options.ids || inFlight > 0) {
+        frames.clear();
+        for (; next <= options.ids && inFlight < window; next++, inFlight++) {
+            name = "Item " + to_string(next);
+            ServerRequest request;
+            request.op = RequestOp::Add;
+            request.id = next;
+            request.name = name;
+            request.category = categories[next % 8];
+            request.price = 1 + (next % 1000) * 0.25;
+            request.quantity = next % 500;
+            request.margin = 5 + next % 40;
+            encodeRequest(frames, request);
+        }
+        for (size_t done = 0; done < frames.size();) {
+            ssize_t n = ::send(fd, frames.data() + done, frames.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                ::close(fd);
+                return false;
+            }
+            done += size_t(n);
+        }
+        // Refill once half the window has been answered.
+        size_t target = next <= options.ids ? inFlight / 2 : 0;
+        size_t at = 0;
+        while (inFlight > target) {
+            ssize_t n = ::recv(fd, block, sizeof(block), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ::close(fd);
+                return false;
+            }
+            input.insert(input.end(), block, block + n);
+            while (input.size() - at >= 4) {
+                uint32_t length;
+                memcpy(&length, input.data() + at, 4);
+                if (input.size() - at - 4 < length) break;
+                if (length == 0) {
+                    tally.errors++;
+                } else if (input[at + 4] != char(ResponseStatus::Ok)) {
+                    tally.failed++;
+                }
+                tally.responses++;
+                at += 4 + size_t(length);
+                inFlight--;
+            }
+        }
+        input.erase(input.begin(), input.begin() + ptrdiff_t(at));
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    ::close(fd);
+    report(out, options, "preload", 1, 1, window, seconds, tally);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--connect") {
+            options.address = value;
+        } else if (key == "--clients") {
+            options.clients = max<size_t>(1, stoull(value));
+        } else if (key == "--pipeline") {
+            options.pipeline = max<size_t>(1, stoull(value));
+        } else if (key == "--requests") {
+            options.requests = stoull(value);
+        } else if (key == "--threads") {
+            options.threads = max<size_t>(1, stoull(value));
+        } else if (key == "--ids") {
+            options.ids = max(1, stoi(value));
+        } else if (key == "--mix") {
+            if (!parseMix(value, options.mix)) {
+                cerr << "Bad --mix " << value << " (expected op:weight,... with ops add, find, update, remove, "
+                     << "adjust, totals)" << endl;
+                return 1;
+            }
+        } else if (key == "--no-preload") {
+            options.preload = false;
+        } else if (key == "--seed") {
+            options.seed = stoull(value);
+        } else if (key == "--out") {
+            options.out = value;
+        } else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+    ServerAddress address;
+    string error;
+    if (options.address.empty()) {
+        cerr << "Usage: loadgen --connect=<port or socket path> [options]" << endl;
+        return 1;
+    }
+    if (!parseServerAddress(options.address, address, error)) {
+        cerr << "Bad address: " << error << endl;
+        return 1;
+    }
+
+    ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file.is_open()) {
+            cerr << "Error opening " << options.out << endl;
+            return 1;
+        }
+    }
+    ostream& out = file.is_open() ? file : cout;
+
+    size_t descriptors = raiseFileLimit();
+    if (options.clients + 16 > descriptors) {
+        cerr << "Only " << descriptors << " descriptors are allowed; raise ulimit -n for " << options.clients
+             << " clients" << endl;
+        return 1;
+    }
+    if (options.preload && !preload(options, address, out)) {
+        cerr << "Could not preload: " << strerror(errno) << endl;
+        return 1;
+    }
+
+    vector<unique_ptr<Client>> clients;
+    for (size_t i = 0; i < options.clients; i++) {
+        clients.emplace_back(new Client());
+        clients.back()->fd = connectTo(address, true);
+        if (clients.back()->fd < 0) {
+            cerr << "Could not connect client " << i << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        clients.back()->toSend = options.requests / options.clients + (i < options.requests % options.clients);
+    }
+
+    size_t threadCount = min(options.threads, options.clients);
+    vector<Tally> tallies(threadCount);
+    vector<thread> threads;
+    auto start = Clock::now();
+    for (size_t t = 0; t < threadCount; t++) {
+        vector<Client*> share;
+        for (size_t i = t; i < clients.size(); i += threadCount) share.push_back(clients[i].get());
+        threads.emplace_back([&options, &tallies, t, share] {
+            Driver driver(options, share, options.seed + t);
+            tallies[t] = driver.run();
+        });
+    }
+    for (thread& worker : threads) worker.join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    for (auto& client : clients) ::close(client->fd);
+
+    Tally total;
+    for (Tally& tally : tallies) {
+        total.responses += tally.responses;
+        total.failed += tally.failed;
+        total.errors += tally.errors;
+        total.latencies.insert(total.latencies.end(), tally.latencies.begin(), tally.latencies.end());
+    }
+    report(out, options, "mixed", options.clients, threadCount, options.pipeline, seconds, total);
+    return total.errors == 0 ? 0 : 1;
+}
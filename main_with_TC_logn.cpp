@@ -1,205 +1,368 @@
-
 #include <iostream>
-#include <vector>
 #include <string>
-#include <sstream>
-#include <fstream>
 #include <limits>
-#include <algorithm>
-#include <map> 
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <chrono>
+#include <sstream>
+#include "inventory.h"
+#include "disk_inventory.h"
+#include "batch_mode.h"
+#include "inventory_server.h"
 
 using namespace std;
 
-class Product {
-private:
-    int id;
-    string name;
-    string category;
-    double price;
-    int quantity;
-    double margin;
-
-public:
-    Product() : id(0), price(0), quantity(0), margin(0) {} // Default constructor
-    Product(int id, string name, string category, double price, int quantity, double margin)
-        : id(id), name(name), category(category), price(price), quantity(quantity), margin(margin) {}
-
-    int getId() const { return id; }
-    string getName() const { return name; }
-    string getCategory() const { return category; }
-    double getPrice() const { return price; }
-    int getQuantity() const { return quantity; }
-    double getMargin() const { return margin; }
-
-    void setName(string name) { this->name = name; }
-    void setCategory(string category) { this->category = category; }
-    void setPrice(double price) { this->price = price; }
-    void setQuantity(int quantity) { this->quantity = quantity; }
-    void setMargin(double margin) { this->margin = margin; }
-};
-
-class Inventory {
-private:
-    map<int, Product> products;
-    double totalRevenue = 0;
-    double totalProfit = 0;
-
-public:
-    void addProduct(Product product) {
-        // O(log n)
-        if (products.count(product.getId())) {
-            cout << "Id already exists." << endl;
-            return;
-        }
-        // O(log n) for insertion
-        products[product.getId()] = product;
-        double revenue = product.getPrice() * product.getQuantity();
-        totalRevenue += revenue;
-        totalProfit += revenue * (product.getMargin() / 100);
-        cout << "Product added successfully." << endl;
-    }
+void clearInput() {
+    cin.clear();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+}
 
-    void removeProduct(int id) {
-        // O(log n) for find operation
-        auto it = products.find(id);
-
-        if (it != products.end()) {
-            Product& p = it->second;
-            double revenue = p.getPrice() * p.getQuantity();
-            totalRevenue -= revenue;
-            totalProfit -= revenue * (p.getMargin() / 100);
-
-            // O(log n) for erase operation
-            products.erase(it);
-            cout << "Product removed successfully." << endl;
-        } else {
-            cout << "Id does not exist." << endl;
-        }
-    }
+// The menu for an inventory kept on disk (--disk): the operations
+// DiskInventory has, under the same keys as the main menu.
+int runDiskMenu(DiskInventory& inventory) {
+    char choice;
 
-    Product* findProduct(int id) {
-        // O(log n)for  find operation
-        auto it = products.find(id);
-        if (it != products.end()) {
-            return &it->second; // Return pointer to the product in the map
-        }
-        return nullptr;
-    }
+    cout << "-------------------------------------------" << endl;
+    cout << "khatta-Inventory Management System - Disk" << endl;
+    cout << "-------------------------------------------" << endl;
 
-    void updateProduct(int id, string name, string category, double price, int quantity, double margin) {
-        Product* product = findProduct(id);
-        if (product) {
-            // Adjust the revenue and profit before updating
-            double oldRevenue = product->getPrice() * product->getQuantity();
-            totalRevenue -= oldRevenue;
-            totalProfit -= oldRevenue * (product->getMargin() / 100);
-
-            product->setName(name);
-            product->setCategory(category);
-            product->setPrice(price);
-            product->setQuantity(quantity);
-            product->setMargin(margin);
-
-            
-            double newRevenue = price * quantity;
-            totalRevenue += newRevenue;
-            totalProfit += newRevenue * (margin / 100);
-
-            cout << "Product updated successfully." << endl;
-        } else {
-            cout << "ID does not exist." << endl;
-        }
-    }
+    do {
+        cout << "\nPlease choose an option:" << endl;
+        cout << "1. Add a product" << endl;
+        cout << "2. Remove a product" << endl;
+        cout << "3. Find a product" << endl;
+        cout << "4. Update a product" << endl;
+        cout << "5. View all products" << endl;
+        cout << "6. Save inventory to file" << endl;
+        cout << "7. Load inventory from file" << endl;
+        cout << "8. Display total revenue and profit" << endl;
+        cout << "E. Memory usage" << endl;
+        cout << "L. Export products (csv, jsonl or text)" << endl;
+        cout << "M. Receive or sell stock" << endl;
+        cout << "N. Change a product's price" << endl;
+        cout << "O. Change a product's profit margin" << endl;
+        cout << "P. Page cache statistics" << endl;
+        cout << "W. Write changes to disk" << endl;
+        cout << "Q. Quit" << endl;
+        cin >> choice;
+        clearInput();
 
-    void printProducts() const {
-        if (products.empty()) {
-            cout << "No products in inventory." << endl;
-        } else {
-                
-            for (const auto& pair : products) {
-                const Product& product = pair.second;
-                cout << "-------------------------------------------" << endl;
-                cout << "ID: " << product.getId() << endl;
-                cout << "Name: " << product.getName() << endl;
-                cout << "Category: " << product.getCategory() << endl;
-                cout << "Price: $" << product.getPrice() << endl;
-                cout << "Quantity: " << product.getQuantity() << endl;
-                cout << "Margin: " << product.getMargin() << "%" << endl;
-                cout << "-------------------------------------------" << endl;
+        switch (choice) {
+            case '1': {
+                int id, quantity;
+                string name, category;
+                double price, margin;
+                cout << "Enter ID: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter product name: ";
+                cin >> ws; getline(cin, name);
+                cout << "Enter product category: ";
+                cin >> ws; getline(cin, category);
+                cout << "Enter product price: Rs. ";
+                while (!(cin >> price)) { clearInput(); }
+                cout << "Enter product quantity: ";
+                while (!(cin >> quantity)) { clearInput(); }
+                cout << "Enter profit margin (%): ";
+                while (!(cin >> margin)) { clearInput(); }
+                inventory.addProduct(Product(id, name, category, price, quantity, margin));
+                break;
             }
-        }
-        cout << "Total Inventory Value: Rs." << totalRevenue << endl;
-        cout << "Estimated Profit: Rs." << totalProfit << endl;
-    }
 
-    void saveInventoryToFile(string filename) {
-        ofstream file(filename);
-        if (!file.is_open()) {
-            cout << "Error opening file for saving." << endl;
-            return;
+            case '2': {
+                int id;
+                cout << "Enter product id to remove: ";
+                while (!(cin >> id)) { clearInput(); }
+                inventory.removeProduct(id);
+                break;
+            }
+
+            case '3': {
+                int id;
+                cout << "Enter product id to find: ";
+                while (!(cin >> id)) { clearInput(); }
+                const Product* product = inventory.findProduct(id);
+                if (product) {
+                    cout << "--- Product Found ---" << endl;
+                    cout << "Name: " << product->getName() << endl;
+                    cout << "Category: " << product->getCategory() << endl;
+                    cout << "Price: Rs. " << product->getPrice() << endl;
+                    cout << "Quantity: " << product->getQuantity() << endl;
+                    cout << "Margin: " << product->getMargin() << "%" << endl;
+                    cout << "---------------------" << endl;
+                } else {
+                    cout << "Product not found." << endl;
+                }
+                break;
+            }
+
+            case '4': {
+                int id, quantity;
+                string name, category;
+                double price, margin;
+                cout << "Enter the product id to update: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter new product name: ";
+                cin >> ws; getline(cin, name);
+                cout << "Enter new product category: ";
+                cin >> ws; getline(cin, category);
+                cout << "Enter new product price: Rs. ";
+                while (!(cin >> price)) { clearInput(); }
+                cout << "Enter new product quantity: ";
+                while (!(cin >> quantity)) { clearInput(); }
+                cout << "Enter new profit margin (%): ";
+                while (!(cin >> margin)) { clearInput(); }
+                inventory.updateProduct(id, name, category, price, quantity, margin);
+                break;
+            }
+
+            case '5':
+                inventory.printProducts();
+                break;
+
+            case '6': {
+                string filename;
+                cout << "Enter filename to save inventory: ";
+                cin >> filename;
+                inventory.saveInventoryToFile(filename);
+                break;
+            }
+
+            case '7': {
+                string filename;
+                cout << "Enter filename to load inventory: ";
+                cin >> filename;
+                inventory.loadInventoryFromFile(filename);
+                break;
+            }
+
+            case '8':
+                cout << "Total Inventory Value: Rs." << inventory.getTotalRevenue() << endl;
+                cout << "Estimated Profit: Rs." << inventory.getTotalProfit() << endl;
+                break;
+
+            case 'e':
+            case 'E':
+                inventory.printMemoryUsage();
+                break;
+
+            case 'l':
+            case 'L': {
+                string format, filename;
+                ExportFormat parsed;
+                cout << "Format (csv, jsonl or text): ";
+                while (!(cin >> format) || !parseExportFormat(format, parsed)) { clearInput(); }
+                cout << "Enter filename to export to: ";
+                cin >> filename;
+                inventory.exportToFile(filename, parsed);
+                break;
+            }
+
+            case 'm':
+            case 'M': {
+                int id, delta;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Units received (negative for units sold): ";
+                while (!(cin >> delta)) { clearInput(); }
+                inventory.adjustQuantity(id, delta);
+                break;
+            }
+
+            case 'n':
+            case 'N': {
+                int id;
+                double price;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter new price: ";
+                while (!(cin >> price)) { clearInput(); }
+                inventory.setPrice(id, price);
+                break;
+            }
+
+            case 'o':
+            case 'O': {
+                int id;
+                double margin;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter new profit margin (%): ";
+                while (!(cin >> margin)) { clearInput(); }
+                inventory.setMargin(id, margin);
+                break;
+            }
+
+            case 'p':
+            case 'P':
+                inventory.printCacheStats();
+                break;
+
+            case 'w':
+            case 'W':
+                if (inventory.flush()) cout << "Changes written." << endl;
+                break;
+
+            case 'q':
+            case 'Q':
+                cout << "Goodbye!" << endl;
+                return inventory.close() ? 0 : 1;
+
+            default:
+                cout << "Invalid choice. Please try again." << endl;
+                break;
         }
+    } while (true);
+}
 
-        
-        for (const auto& pair : products) {
-            const Product& product = pair.second;
-            file << product.getId() << ","
-                 << product.getName() << ","
-                 << product.getCategory() << ","
-                 << product.getPrice() << ","
-                 << product.getQuantity() << ","
-                 << product.getMargin() << endl;
+int main(int argc, char* argv[]) {
+    IndexBackend backend = IndexBackend::Auto;
+    NodeAllocator allocator = NodeAllocator::Pool;
+    string snapshotFile, logFile, batchFile, statsFile, autosaveFile, historyFile, alertsFile, diskFile, serveAddress;
+    size_t cacheMb = 64;
+    bool batch = false, quiet = false;
+    LogOptions logOptions;
+    AutosaveOptions autosaveOptions;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--index=", 8) == 0) {
+            backend = parseIndexBackend(argv[i] + 8);
+        } else if (strncmp(argv[i], "--alloc=", 8) == 0) {
+            if (!parseNodeAllocator(argv[i] + 8, allocator)) {
+                cerr << "Unknown allocator " << argv[i] + 8 << " (expected pool or default)" << endl;
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--snapshot=", 11) == 0) {
+            snapshotFile = argv[i] + 11;
+        } else if (strncmp(argv[i], "--log=", 6) == 0) {
+            logFile = argv[i] + 6;
+        } else if (strncmp(argv[i], "--group-commit=", 15) == 0) {
+            logOptions.groupCommit = strtoul(argv[i] + 15, nullptr, 10);
+        } else if (strncmp(argv[i], "--sync-every=", 13) == 0) {
+            logOptions.syncEveryCommits = strtoul(argv[i] + 13, nullptr, 10);
+        } else if (strncmp(argv[i], "--sync-ms=", 10) == 0) {
+            logOptions.syncIntervalMs = strtol(argv[i] + 10, nullptr, 10);
+        } else if (strncmp(argv[i], "--compact-mb=", 13) == 0) {
+            logOptions.compactBytes = strtoul(argv[i] + 13, nullptr, 10) << 20;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strncmp(argv[i], "--batch=", 8) == 0) {
+            batch = true;
+            batchFile = argv[i] + 8;
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            statsFile = argv[i] + 8;
+        } else if (strncmp(argv[i], "--history=", 10) == 0) {
+            historyFile = argv[i] + 10;
+        } else if (strncmp(argv[i], "--autosave=", 11) == 0) {
+            autosaveFile = argv[i] + 11;
+        } else if (strncmp(argv[i], "--autosave-changes=", 19) == 0) {
+            autosaveOptions.changes = max<size_t>(1, strtoul(argv[i] + 19, nullptr, 10));
+        } else if (strncmp(argv[i], "--autosave-ms=", 14) == 0) {
+            autosaveOptions.interval = chrono::milliseconds(strtol(argv[i] + 14, nullptr, 10));
+        } else if (strncmp(argv[i], "--alerts=", 9) == 0) {
+            alertsFile = argv[i] + 9;
+        } else if (strncmp(argv[i], "--disk=", 7) == 0) {
+            diskFile = argv[i] + 7;
+        } else if (strncmp(argv[i], "--cache-mb=", 11) == 0) {
+            cacheMb = max<size_t>(1, strtoul(argv[i] + 11, nullptr, 10));
+        } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            serveAddress = argv[i] + 8;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
         }
-        file.close();
-        cout << "Inventory saved to file." << endl;
     }
-
-    void loadInventoryFromFile(string filename) {
-        ifstream file(filename);
-        if (!file.is_open()) {
-            cout << "Error: Could not open file " << filename << endl;
-            return;
+    if (!diskFile.empty()) {
+        // The disk inventory only has the menu; the other modes and files
+        // work on Inventory, so refuse them rather than ignore them.
+        if (batch || !serveAddress.empty() || !statsFile.empty() || !logFile.empty() || !snapshotFile.empty()
+            || !historyFile.empty() || !autosaveFile.empty() || !alertsFile.empty()) {
+            cerr << "Error: --disk cannot be combined with --batch, --serve, --stats, --log, --snapshot, "
+                    "--history, --autosave or --alerts" << endl;
+            return 1;
+        }
+        // Larger than memory: only cacheMb of it is ever held.
+        DiskInventory disk(cacheMb << 20);
+        disk.setQuiet(quiet);
+        if (!disk.open(diskFile)) return 1;
+        return runDiskMenu(disk);
+    }
+    // Before the autosave thread starts, so a stop signal reaches the server.
+    if (!serveAddress.empty()) InventoryServer::blockStopSignals();
+    Inventory inventory(backend, allocator);
+    // Before the log is opened, so recovery stays off quiet batch and server
+    // output.
+    inventory.setQuiet(quiet || !serveAddress.empty());
+    // Reorder alerts as JSON lines, one written as each crossing happens,
+    // for another process to follow.
+    ofstream alerts;
+    if (!alertsFile.empty()) {
+        alerts.open(alertsFile, ios::app);
+        if (!alerts.is_open()) {
+            cerr << "Error: Could not open alerts file " << alertsFile << endl;
+            return 1;
         }
+        inventory.setReorderListener([&alerts](const ReorderAlert& alert) {
+            TextBuffer line;
+            line.append("{\"time\":\"");
+            line.append(formatHistoryTime(historyClock()));
+            line.append(alert.low ? "\",\"event\":\"low\",\"id\":" : "\",\"event\":\"restocked\",\"id\":");
+            line.appendInt(alert.id);
+            line.append(",\"name\":");
+            appendJsonString(line, alert.name);
+            line.append(",\"quantity\":");
+            line.appendInt(alert.quantity);
+            line.append(",\"threshold\":");
+            line.appendInt(alert.threshold);
+            line.append("}\n");
+            alerts.write(line.data(), streamsize(line.size()));
+            alerts.flush();
+        });
+    }
+    if (!logFile.empty()) {
+        if (snapshotFile.empty()) snapshotFile = logFile + ".snap";
+        if (!inventory.openLog(snapshotFile, logFile, logOptions)) return 1;
+    } else if (!snapshotFile.empty()) {
+        inventory.loadSnapshot(snapshotFile);
+    }
+    if (!historyFile.empty() && !inventory.openHistory(historyFile)) return 1;
+    if (!autosaveFile.empty() && !inventory.startAutosave(autosaveFile, autosaveOptions)) return 1;
+
+    if (!serveAddress.empty()) {
+        // Clients on this machine share the inventory until SIGINT/SIGTERM.
+        InventoryServer server(inventory);
+        bool served = server.serve(serveAddress);
+        if (served) server.printStats();
+        bool saved = inventory.stopAutosave();
+        inventory.closeLog();
+        inventory.closeHistory();
+        if (!statsFile.empty()) inventory.writeStats(statsFile);
+        return served && saved ? 0 : 1;
+    }
 
-        products.clear();
-        totalRevenue = 0;
-        totalProfit = 0;
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string idStr, name, category, priceStr, quantityStr, marginStr;
-            getline(ss, idStr, ',');
-            getline(ss, name, ',');
-            getline(ss, category, ',');
-            getline(ss, priceStr, ',');
-            getline(ss, quantityStr, ',');
-            getline(ss, marginStr, ',');
-
-            try {
-                int id = stoi(idStr);
-                double price = stod(priceStr);
-                int quantity = stoi(quantityStr);
-                double margin = stod(marginStr);
-
-                // Add to map
-                products[id] = Product(id, name, category, price, quantity, margin);
-                totalRevenue += price * quantity;
-                totalProfit += price * quantity * (margin / 100);
-            } catch (const invalid_argument& e) {
-                cout << "Invalid data in file, skipping line." << endl;
+    if (batch) {
+        // Commands from a file or stdin, results through one large buffer.
+        ios::sync_with_stdio(false);
+        ifstream file;
+        if (!batchFile.empty() && batchFile != "-") {
+            file.open(batchFile);
+            if (!file.is_open()) {
+                cerr << "Error: Could not open batch file " << batchFile << endl;
+                return 1;
             }
         }
-        file.close();
-        cout << "Inventory loaded from file." << endl;
+        OutputBuffer buffer(STDOUT_FILENO);
+        ostream out(&buffer);
+        BatchRunner runner(inventory, out, quiet);
+        auto start = chrono::steady_clock::now();
+        runner.run(file.is_open() ? file : cin);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        inventory.stopAutosave();
+        inventory.closeLog();
+        inventory.closeHistory();
+        if (!statsFile.empty()) inventory.writeStats(statsFile);
+        cerr << "Processed " << runner.commandCount() << " commands (" << runner.failureCount()
+             << " failed) in " << seconds << "s" << endl;
+        return runner.failureCount() == 0 ? 0 : 1;
     }
-};
-
-void clearInput() {
-    cin.clear();
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-}
-
-int main() {
-    Inventory inventory;
     char choice;
 
     cout << "-------------------------------------------" << endl;
@@ -216,7 +379,33 @@ int main() {
         cout << "6. Save inventory to file" << endl;
         cout << "7. Load inventory from file" << endl;
         cout << "8. Display total revenue and profit" << endl;
+        cout << "9. Save binary snapshot" << endl;
+        cout << "A. Load binary snapshot" << endl;
+        cout << "B. Compact log into snapshot" << endl;
+        cout << "C. Category report" << endl;
+        cout << "D. List products in a category" << endl;
+        cout << "E. Memory usage" << endl;
+        cout << "F. Reconcile totals" << endl;
+        cout << "G. Products in a price range" << endl;
+        cout << "H. Top products by stock value" << endl;
+        cout << "I. Price and stock value percentiles" << endl;
+        cout << "J. Search products by name" << endl;
+        cout << "K. View products page by page" << endl;
+        cout << "L. Export products (csv, jsonl or text)" << endl;
+        cout << "M. Receive or sell stock" << endl;
+        cout << "N. Change a product's price" << endl;
+        cout << "O. Change a product's profit margin" << endl;
+        cout << "P. Operation statistics" << endl;
+        cout << "R. Merge store inventory files" << endl;
+        cout << "S. Autosave (status, or start it)" << endl;
+        cout << "T. Stock history and values as of a date" << endl;
+        cout << "U. Compare a stock count file with the inventory or another file" << endl;
+        cout << "V. Reorder thresholds and low stock" << endl;
+        cout << "W. Query products (filters, group by category, order, limit)" << endl;
         cout << "Q. Quit" << endl;
+        // Nothing changes while waiting for a choice, so hand over what is
+        // unsaved now; it is written when due.
+        inventory.pollAutosave(true);
         cin >> choice;
         clearInput();
 
@@ -261,19 +450,16 @@ int main() {
                 int id;
                 cout << "Enter product id to find: ";
                 while (!(cin >> id)) { clearInput(); }
-                Product* product = inventory.findProduct(id);
-                if (product) {
+                bool found = inventory.findProduct(id, [](const Product& product) {
                     cout << "--- Product Found ---" << endl;
-                    cout << "Name: " << product->getName() << endl;
-                    cout << "Category: " << product->getCategory() << endl;
-                    cout << "Price: Rs. " << product->getPrice() << endl;
-                    cout << "Quantity: " << product->getQuantity() << endl;
-                    cout << "Margin: " << product->getMargin() << "%" << endl;
+                    cout << "Name: " << product.getName() << endl;
+                    cout << "Category: " << product.getCategory() << endl;
+                    cout << "Price: Rs. " << product.getPrice() << endl;
+                    cout << "Quantity: " << product.getQuantity() << endl;
+                    cout << "Margin: " << product.getMargin() << "%" << endl;
                     cout << "---------------------" << endl;
-
-                } else {
-                    cout << "Product not found." << endl;
-                }
+                });
+                if (!found) cout << "Product not found." << endl;
                 break;
             }
 
@@ -329,8 +515,256 @@ int main() {
                 inventory.printProducts();
                 break;
 
+            case '9': {
+                string filename;
+                cout << "Enter filename to save snapshot: ";
+                cin >> filename;
+                inventory.saveSnapshot(filename);
+                break;
+            }
+
+            case 'a':
+            case 'A': {
+                string filename;
+                cout << "Enter filename to load snapshot: ";
+                cin >> filename;
+                inventory.loadSnapshot(filename);
+                break;
+            }
+
+            case 'b':
+            case 'B':
+                if (inventory.compactLog()) {
+                    cout << "Log compacted." << endl;
+                } else {
+                    cout << "No log is open (start with --log=<file>)." << endl;
+                }
+                break;
+
+            case 'c':
+            case 'C':
+                inventory.printCategoryReport();
+                break;
+
+            case 'd':
+            case 'D': {
+                string category;
+                cout << "Enter category: ";
+                cin >> ws; getline(cin, category);
+                inventory.printCategory(category);
+                break;
+            }
+
+            case 'e':
+            case 'E':
+                inventory.printMemoryUsage();
+                break;
+
+            case 'f':
+            case 'F':
+                inventory.reconcileTotals();
+                break;
+
+            case 'g':
+            case 'G': {
+                double low, high;
+                cout << "Enter lowest price: ";
+                while (!(cin >> low)) { clearInput(); }
+                cout << "Enter highest price: ";
+                while (!(cin >> high)) { clearInput(); }
+                inventory.printPriceRange(low, high);
+                break;
+            }
+
+            case 'h':
+            case 'H': {
+                int n;
+                cout << "How many products: ";
+                while (!(cin >> n) || n < 0) { clearInput(); }
+                inventory.printTopByValue(size_t(n));
+                break;
+            }
+
+            case 'i':
+            case 'I':
+                inventory.printPercentiles();
+                break;
+
+            case 'j':
+            case 'J': {
+                string query;
+                int page;
+                cout << "Enter name or part of it: ";
+                cin >> ws; getline(cin, query);
+                cout << "Page (1 for the best matches): ";
+                while (!(cin >> page) || page < 1) { clearInput(); }
+                inventory.printNameSearch(query, size_t(page - 1));
+                break;
+            }
+
+            case 'k':
+            case 'K': {
+                int page;
+                cout << "Page (from 1): ";
+                while (!(cin >> page) || page < 1) { clearInput(); }
+                inventory.printProductPage(size_t(page - 1));
+                break;
+            }
+
+            case 'l':
+            case 'L': {
+                string format, filename;
+                ExportFormat parsed;
+                cout << "Format (csv, jsonl or text): ";
+                while (!(cin >> format) || !parseExportFormat(format, parsed)) { clearInput(); }
+                cout << "Enter filename to export to: ";
+                cin >> filename;
+                inventory.exportToFile(filename, parsed);
+                break;
+            }
+
+            case 'm':
+            case 'M': {
+                int id, delta;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Units received (negative for units sold): ";
+                while (!(cin >> delta)) { clearInput(); }
+                inventory.adjustQuantity(id, delta);
+                break;
+            }
+
+            case 'n':
+            case 'N': {
+                int id;
+                double price;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter new price: ";
+                while (!(cin >> price)) { clearInput(); }
+                inventory.setPrice(id, price);
+                break;
+            }
+
+            case 'o':
+            case 'O': {
+                int id;
+                double margin;
+                cout << "Enter product id: ";
+                while (!(cin >> id)) { clearInput(); }
+                cout << "Enter new profit margin (%): ";
+                while (!(cin >> margin)) { clearInput(); }
+                inventory.setMargin(id, margin);
+                break;
+            }
+
+            case 'p':
+            case 'P':
+                inventory.printStats();
+                break;
+
+            case 'r':
+            case 'R': {
+                string policyName, line, filename;
+                MergePolicy policy;
+                cout << "When a product is in several files (sum, last or error): ";
+                while (!(cin >> policyName) || !parseMergePolicy(policyName, policy)) { clearInput(); }
+                cout << "Enter the file names, separated by spaces: ";
+                cin >> ws; getline(cin, line);
+                vector<string> filenames;
+                istringstream names(line);
+                while (names >> filename) filenames.push_back(filename);
+                inventory.mergeInventoryFiles(filenames, policy);
+                break;
+            }
+
+            case 's':
+            case 'S': {
+                if (!autosaveFile.empty()) {
+                    inventory.printAutosaveStatus();
+                    break;
+                }
+                cout << "Enter the file to autosave to: ";
+                cin >> ws; getline(cin, autosaveFile);
+                if (!inventory.startAutosave(autosaveFile, autosaveOptions)) autosaveFile.clear();
+                break;
+            }
+
+            case 't':
+            case 'T': {
+                string who, when;
+                int64_t time;
+                cout << "Enter a product ID, or * for the inventory totals: ";
+                cin >> who;
+                clearInput();
+                cout << "As of (YYYY-MM-DD [HH:MM[:SS]]; blank for a product's every change): ";
+                getline(cin, when);
+                int id = 0;
+                if (who != "*" && !parseIntField(who.data(), who.data() + who.size(), id)) {
+                    cout << "Invalid product ID." << endl;
+                } else if (when.empty() && who != "*") {
+                    inventory.printProductHistory(id);
+                } else if (!parseHistoryTime(when.empty() ? "now" : when, time)) {
+                    cout << "Invalid date." << endl;
+                } else if (who == "*") {
+                    inventory.printTotalsAsOf(time);
+                } else {
+                    inventory.printProductAsOf(id, time);
+                }
+                break;
+            }
+
+            case 'u':
+            case 'U': {
+                string after, before, report;
+                cout << "Enter the file to check (e.g. the stock count): ";
+                cin >> ws; getline(cin, after);
+                cout << "Compare it with which file (blank for the current inventory): ";
+                getline(cin, before);
+                cout << "Write the differences as CSV to (blank to list them here): ";
+                getline(cin, report);
+                inventory.diffInventory(before, after, report);
+                break;
+            }
+
+            case 'v':
+            case 'V': {
+                string target;
+                cout << "Enter a product ID or category to set its reorder threshold (blank to list low stock): ";
+                getline(cin, target);
+                if (target.empty()) {
+                    inventory.printLowStock();
+                    break;
+                }
+                int threshold;
+                cout << "Enter the threshold (-1 to clear): ";
+                while (!(cin >> threshold)) { clearInput(); }
+                int id;
+                if (parseIntField(target.data(), target.data() + target.size(), id)) {
+                    inventory.setReorderThreshold(id, threshold);
+                } else {
+                    inventory.setCategoryReorderThreshold(target, threshold);
+                }
+                break;
+            }
+
+            case 'w':
+            case 'W': {
+                string text;
+                cout << "Enter a query, e.g. select category, count, sum(value) where price > 100 group by category" << endl;
+                cout << "  or: where category = Grocery and quantity < 10 order by quantity limit 20" << endl;
+                cout << "Query: ";
+                getline(cin, text);
+                inventory.runQuery(text);
+                break;
+            }
+
             case 'q':
             case 'Q':
+                inventory.stopAutosave();
+                inventory.closeLog();
+                inventory.closeHistory();
+                if (!statsFile.empty()) inventory.writeStats(statsFile);
                 cout << "Goodbye!" << endl;
                 return 0;
 
@@ -338,6 +772,8 @@ int main() {
                 cout << "Invalid choice. Please try again." << endl;
                 break;
         }
+        // Each menu action is one group commit.
+        inventory.commitLog();
     } while (true);
 
     return 0;
@@ -0,0 +1,419 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include "string_pool.h"
+
+using namespace std;
+
+struct NameMatch {
+    int id;
+    // Higher is better: 3 for the whole name, 2 for other prefix matches,
+    // 1..2 for substring matches (earlier is better) and 0..1 for fuzzy
+    // matches (trigram similarity).
+    double score;
+};
+
+// Product names, searchable by prefix, substring, and approximately.
+// Matching ignores ASCII case.
+//
+//   prefix:    radix trie (path-compressed, 32-byte nodes whose labels view
+//              the index's own copies of the names); each node counts the
+//              names below it so pages are found without walking the
+//              skipped results
+//   substring: trigram -> entries inverted index; the query's lists are
+//              intersected, rarest first, and the survivors checked
+//              against the name (queries of 3+ characters)
+//   fuzzy:     names sharing at least a third of the query's trigrams,
+//              ranked by Dice similarity; catches typos in queries of 3+
+//              characters. Skipped when the query's trigrams are all so
+//              common that scoring them would take more than a few ms.
+//
+// Results are ranked prefix > substring > fuzzy and paged.
+//
+// Every add gets a new entry number, so posting lists are appended in
+// increasing order and stay sorted: intersections and shared-trigram counts
+// are merges over the lists and only the winners' names are read. Removing
+// a name only marks its entry dead; queries skip dead entries, and once
+// half of the entries are dead the index is rebuilt from the live ones.
+class NameIndex {
+private:
+    // Posting entries the fuzzy pass may read per query.
+    static constexpr size_t fuzzyScanLimit = 100000;
+    // Dead entries tolerated before a rebuild, however small the index.
+    static constexpr size_t minRebuildDead = 4096;
+
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Node {
+        string_view label;
+        // Children are a list sorted by the first byte of their labels.
+        uint32_t firstChild = none;
+        uint32_t nextSibling = none;
+        // Names ending here or below.
+        uint32_t count = 0;
+        // Entries of the names ending here, linked through Entry::next.
+        uint32_t ids = none;
+    };
+
+    struct Entry {
+        string_view name;
+        int id;
+        // Distinct trigrams in name.
+        uint32_t grams;
+        // Next entry with the same name.
+        uint32_t next;
+        bool live;
+    };
+
+    unique_ptr<StringArena> arena{new StringArena()};
+    vector<Node> nodes;
+    vector<uint32_t> freeNodes;
+    vector<Entry> entries;
+    size_t dead = 0;
+    // id -> its entry.
+    unordered_map<int, uint32_t> entryOf;
+    // trigram -> entries containing it, ascending.
+    unordered_map<uint32_t, vector<uint32_t>> postings;
+
+    static string lower(string_view name) {
+        string folded(name);
+        for (char& c : folded) {
+            if (c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+        }
+        return folded;
+    }
+
+    static uint32_t trigramAt(string_view text, size_t i) {
+        return uint32_t(uint8_t(text[i])) << 16 | uint32_t(uint8_t(text[i + 1])) << 8 | uint8_t(text[i + 2]);
+    }
+
+    // Distinct trigrams of text, sorted.
+    static void trigrams(string_view text, vector<uint32_t>& grams) {
+        grams.clear();
+        for (size_t i = 0; i + 3 <= text.size(); i++) grams.push_back(trigramAt(text, i));
+        sort(grams.begin(), grams.end());
+        grams.erase(unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    uint32_t newNode(string_view label) {
+        uint32_t index;
+        if (!freeNodes.empty()) {
+            index = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[index] = Node();
+        } else {
+            index = uint32_t(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[index].label = label;
+        return index;
+    }
+
+    // The child of node whose label starts with c (none if there is none),
+    // and the child before it or its place in the list (none: first).
+    uint32_t findChild(uint32_t node, char c, uint32_t& before) const {
+        before = none;
+        for (uint32_t child = nodes[node].firstChild; child != none; child = nodes[child].nextSibling) {
+            uint8_t first = uint8_t(nodes[child].label[0]);
+            if (first == uint8_t(c)) return child;
+            if (first > uint8_t(c)) break;
+            before = child;
+        }
+        return none;
+    }
+
+    uint32_t& childLink(uint32_t node, uint32_t before) {
+        return before == none ? nodes[node].firstChild : nodes[before].nextSibling;
+    }
+
+    void trieInsert(string_view name, uint32_t entry) {
+        uint32_t node = 0;
+        nodes[0].count++;
+        size_t pos = 0;
+        while (pos < name.size()) {
+            uint32_t before;
+            uint32_t child = findChild(node, name[pos], before);
+            if (child == none) {
+                child = newNode(name.substr(pos));
+                nodes[child].nextSibling = childLink(node, before);
+                childLink(node, before) = child;
+                node = child;
+                nodes[node].count++;
+                break;
+            }
+            string_view label = nodes[child].label;
+            size_t common = 0;
+            while (common < label.size() && pos + common < name.size() && label[common] == name[pos + common]) common++;
+            if (common < label.size()) {
+                // Split the edge: node -> middle (shared part) -> child (rest).
+                uint32_t middle = newNode(label.substr(0, common));
+                nodes[middle].count = nodes[child].count;
+                nodes[middle].firstChild = child;
+                nodes[middle].nextSibling = nodes[child].nextSibling;
+                nodes[child].nextSibling = none;
+                nodes[child].label = label.substr(common);
+                childLink(node, before) = middle;
+                child = middle;
+            }
+            node = child;
+            nodes[node].count++;
+            pos += common;
+        }
+        entries[entry].next = nodes[node].ids;
+        nodes[node].ids = entry;
+    }
+
+    void trieErase(string_view name, uint32_t entry) {
+        vector<pair<uint32_t, uint32_t>> path;  // (node, the child before the next step)
+        uint32_t node = 0;
+        size_t pos = 0;
+        while (pos < name.size()) {
+            uint32_t before;
+            uint32_t child = findChild(node, name[pos], before);
+            path.emplace_back(node, before);
+            node = child;
+            pos += nodes[node].label.size();
+        }
+        uint32_t* link = &nodes[node].ids;
+        while (*link != entry) link = &entries[*link].next;
+        *link = entries[entry].next;
+        nodes[node].count--;
+        for (const auto& step : path) nodes[step.first].count--;
+
+        // Drop nodes left with nothing below them.
+        while (!path.empty() && nodes[node].count == 0) {
+            childLink(path.back().first, path.back().second) = nodes[node].nextSibling;
+            nodes[node] = Node();
+            freeNodes.push_back(node);
+            node = path.back().first;
+            path.pop_back();
+        }
+    }
+
+    // Appends up to want ids below node, in name order, after skipping skip.
+    void collect(uint32_t node, size_t& skip, size_t& want, vector<NameMatch>& out, double score) const {
+        const Node& n = nodes[node];
+        if (skip >= n.count) {
+            skip -= n.count;
+            return;
+        }
+        for (uint32_t e = n.ids; e != none && want > 0; e = entries[e].next) {
+            if (skip > 0) {
+                skip--;
+                continue;
+            }
+            out.push_back({entries[e].id, score});
+            want--;
+        }
+        // Below the exact match, names only share the prefix.
+        for (uint32_t child = n.firstChild; child != none && want > 0; child = nodes[child].nextSibling) {
+            collect(child, skip, want, out, min(score, 2.0));
+        }
+    }
+
+    // Node under which every name starts with prefix (none if there is none),
+    // and whether prefix ends exactly at that node's label.
+    uint32_t findPrefix(string_view prefix, bool& exact) const {
+        uint32_t node = 0;
+        size_t pos = 0;
+        exact = true;
+        while (pos < prefix.size()) {
+            uint32_t before;
+            node = findChild(node, prefix[pos], before);
+            if (node == none) return none;
+            string_view label = nodes[node].label;
+            size_t n = min(label.size(), prefix.size() - pos);
+            if (label.compare(0, n, prefix, pos, n) != 0) return none;
+            exact = n == label.size();
+            pos += n;
+        }
+        return node;
+    }
+
+    // First position at or after from holding a value >= value. Galloping,
+    // so walking a long list with ascending values costs O(log gap) a step.
+    static size_t gallop(const vector<uint32_t>& list, size_t from, uint32_t value) {
+        size_t hi = from;
+        for (size_t step = 1; hi < list.size() && list[hi] < value; step *= 2) {
+            from = hi + 1;
+            hi += step;
+        }
+        return size_t(lower_bound(list.begin() + long(from), list.begin() + long(min(hi, list.size())), value) - list.begin());
+    }
+
+    // Appends ranked[skip, skip + want) to page, best first.
+    static void take(vector<pair<double, int>>& ranked, size_t& skip, size_t& want, vector<NameMatch>& page) {
+        size_t k = min(ranked.size(), skip + want);
+        partial_sort(ranked.begin(), ranked.begin() + long(k), ranked.end(),
+            [](const pair<double, int>& a, const pair<double, int>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+        for (size_t i = 0; i < k; i++) {
+            if (skip > 0) {
+                skip--;
+                continue;
+            }
+            page.push_back({ranked[i].second, ranked[i].first});
+            want--;
+        }
+    }
+
+    // Drops the dead entries by re-adding the live names to a fresh index.
+    void rebuild() {
+        vector<pair<int, string>> live;
+        live.reserve(entryOf.size());
+        for (const Entry& entry : entries) {
+            if (entry.live) live.emplace_back(entry.id, string(entry.name));
+        }
+        clear();
+        for (const auto& name : live) add(name.first, name.second);
+    }
+
+public:
+    NameIndex() { nodes.emplace_back(); }
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+
+    size_t size() const { return entryOf.size(); }
+
+    void add(int id, string_view name) {
+        remove(id);
+        string_view stored = arena->store(lower(name));
+        vector<uint32_t> grams;
+        trigrams(stored, grams);
+        uint32_t entry = uint32_t(entries.size());
+        entries.push_back({stored, id, uint32_t(grams.size()), none, true});
+        entryOf[id] = entry;
+        trieInsert(stored, entry);
+        for (uint32_t gram : grams) postings[gram].push_back(entry);
+    }
+
+    void remove(int id) {
+        auto it = entryOf.find(id);
+        if (it == entryOf.end()) return;
+        Entry& entry = entries[it->second];
+        trieErase(entry.name, it->second);
+        entryOf.erase(it);
+        arena->release(entry.name);
+        entry.live = false;
+        if (++dead >= minRebuildDead && dead * 2 > entries.size()) rebuild();
+    }
+
+    void clear() {
+        nodes.assign(1, Node());
+        freeNodes.clear();
+        entries.clear();
+        dead = 0;
+        entryOf.clear();
+        postings.clear();
+        arena.reset(new StringArena());
+    }
+
+    // Matches ranked [offset, offset + limit) into page; returns whether
+    // more follow. Prefix matches are in name order, substring matches by
+    // where the query occurs, fuzzy matches by similarity.
+    bool search(string_view query, size_t offset, size_t limit, vector<NameMatch>& page) const {
+        page.clear();
+        string q = lower(query);
+        size_t skip = offset;
+        // One extra result tells us whether there is another page.
+        size_t want = limit + 1;
+        bool exact = true;
+        uint32_t prefixNode = q.empty() ? 0 : findPrefix(q, exact);
+        if (prefixNode != none) collect(prefixNode, skip, want, page, exact ? 3.0 : 2.0);
+
+        if (want > 0 && q.size() >= 3) {
+            vector<uint32_t> grams;
+            trigrams(q, grams);
+            static const vector<uint32_t> none;
+            vector<const vector<uint32_t>*> lists;
+            for (uint32_t gram : grams) {
+                auto it = postings.find(gram);
+                lists.push_back(it == postings.end() ? &none : &it->second);
+            }
+            sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) {
+                return a->size() < b->size();
+            });
+
+            // Substring matches contain every query trigram.
+            vector<uint32_t> common(*lists[0]);
+            for (size_t i = 1; i < lists.size() && !common.empty(); i++) {
+                size_t kept = 0, pos = 0;
+                for (uint32_t entry : common) {
+                    pos = gallop(*lists[i], pos, entry);
+                    if (pos < lists[i]->size() && (*lists[i])[pos] == entry) common[kept++] = entry;
+                }
+                common.resize(kept);
+            }
+            vector<pair<double, int>> ranked;
+            for (uint32_t e : common) {
+                const Entry& entry = entries[e];
+                if (!entry.live) continue;
+                size_t at = entry.name.find(q);
+                // Position 0 was already listed as a prefix match.
+                if (at == string_view::npos || at == 0) continue;
+                ranked.emplace_back(1.0 + 1.0 / double(at + 1), entry.id);
+            }
+            take(ranked, skip, want, page);
+
+            // A name sharing at least `needed` of the query's n trigrams must
+            // be in one of the (n - needed + 1) rarest lists: count how many
+            // of those each entry is in, then look the rest of the lists up.
+            size_t needed = (grams.size() + 2) / 3;
+            size_t scanLists = grams.size() - needed + 1;
+            size_t scan = 0;
+            for (size_t i = 0; i < scanLists; i++) scan += lists[i]->size();
+            if (want > 0 && scan <= fuzzyScanLimit) {
+                vector<pair<uint32_t, uint32_t>> counts, merged;  // (entry, trigrams shared)
+                for (size_t i = 0; i < scanLists; i++) {
+                    const vector<uint32_t>& list = *lists[i];
+                    merged.clear();
+                    size_t a = 0, b = 0;
+                    while (a < counts.size() || b < list.size()) {
+                        if (b == list.size() || (a < counts.size() && counts[a].first < list[b])) {
+                            merged.push_back(counts[a++]);
+                        } else if (a == counts.size() || list[b] < counts[a].first) {
+                            merged.emplace_back(list[b++], 1);
+                        } else {
+                            merged.emplace_back(list[b++], counts[a++].second + 1);
+                        }
+                    }
+                    counts.swap(merged);
+                }
+                vector<size_t> pos(lists.size(), 0);
+                ranked.clear();
+                for (auto& count : counts) {
+                    for (size_t i = scanLists; i < lists.size(); i++) {
+                        pos[i] = gallop(*lists[i], pos[i], count.first);
+                        if (pos[i] < lists[i]->size() && (*lists[i])[pos[i]] == count.first) count.second++;
+                    }
+                    const Entry& entry = entries[count.first];
+                    if (count.second < needed || !entry.live) continue;
+                    // Prefix and substring matches were listed already.
+                    if (count.second == grams.size() && entry.name.find(q) != string_view::npos) continue;
+                    ranked.emplace_back(2.0 * count.second / double(grams.size() + entry.grams), entry.id);
+                }
+                take(ranked, skip, want, page);
+            }
+        }
+        bool more = page.size() > limit;
+        page.resize(min(page.size(), limit));
+        return more;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = arena->bytesReserved() + nodes.capacity() * sizeof(Node) + entries.capacity() * sizeof(Entry)
+            + entryOf.size() * (sizeof(int) + sizeof(uint32_t) + 2 * sizeof(void*));
+        for (const auto& list : postings) bytes += sizeof(list) + 2 * sizeof(void*) + list.second.capacity() * 4;
+        return bytes;
+    }
+};
+
+#endif
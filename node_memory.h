@@ -0,0 +1,232 @@
+#ifndef NODE_MEMORY_H
+#define NODE_MEMORY_H
+
+#include <string>
+#include <vector>
+#include <memory_resource>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Passes allocations through to upstream and counts them. heapBytes
+// estimates what the allocations really occupy in a malloc heap: each
+// block carries an 8-byte header and is rounded up to 16 bytes, 32 at
+// least (glibc on 64-bit).
+class CountingResource : public pmr::memory_resource {
+private:
+    pmr::memory_resource* upstream;
+    size_t allocations = 0;
+    size_t liveBlocks = 0;
+    size_t liveBytes = 0;
+    size_t liveHeapBytes = 0;
+
+    static size_t heapBytesOf(size_t bytes) { return max<size_t>(32, (bytes + sizeof(size_t) + 15) & ~size_t(15)); }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* p = upstream->allocate(bytes, alignment);
+        allocations++;
+        liveBlocks++;
+        liveBytes += bytes;
+        liveHeapBytes += heapBytesOf(bytes);
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+        liveBlocks--;
+        liveBytes -= bytes;
+        liveHeapBytes -= heapBytesOf(bytes);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    explicit CountingResource(pmr::memory_resource* upstream = pmr::new_delete_resource()) : upstream(upstream) {}
+
+    // Drops the live counts after the blocks were freed wholesale upstream
+    // instead of one by one.
+    void forgetLive() {
+        liveBlocks = 0;
+        liveBytes = 0;
+        liveHeapBytes = 0;
+    }
+
+    size_t allocationCount() const { return allocations; }
+    size_t liveBlockCount() const { return liveBlocks; }
+    size_t bytesLive() const { return liveBytes; }
+    size_t heapBytes() const { return liveHeapBytes; }
+};
+
+// Slab allocator for small fixed-size nodes. Blocks are carved off large
+// slabs with a bump pointer; freed blocks go onto a free list for their
+// size (rounded up to 8 bytes) and are handed out again first. Nothing is
+// returned upstream until release(), which drops every slab at once.
+//
+// Slabs double from 64 KiB up to 4 MiB, so at most one slab's tail is
+// unused; reserve() makes the next slab exactly as large as a bulk load
+// needs. Over-aligned or oversized blocks are bump-allocated and not
+// reused before release().
+class SlabResource : public pmr::memory_resource {
+private:
+    static constexpr size_t granule = 8;
+    static constexpr size_t maxPooled = 256;
+    static constexpr size_t minSlab = size_t(64) << 10;
+    static constexpr size_t maxSlab = size_t(4) << 20;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Slab {
+        char* bytes;
+        size_t size;
+    };
+
+    pmr::memory_resource* upstream;
+    FreeBlock* freeLists[maxPooled / granule + 1] = {};
+    vector<Slab> slabs;
+    char* cursor = nullptr;
+    size_t left = 0;
+    size_t nextSlab = minSlab;
+
+    char* bump(size_t bytes, size_t alignment) {
+        size_t pad = size_t(-reinterpret_cast<uintptr_t>(cursor)) & (alignment - 1);
+        if (!cursor || pad + bytes > left) {
+            size_t size = max(nextSlab, bytes + alignment);
+            cursor = static_cast<char*>(upstream->allocate(size, alignof(max_align_t)));
+            slabs.push_back({cursor, size});
+            left = size;
+            nextSlab = min(max(nextSlab, size) * 2, maxSlab);
+            pad = size_t(-reinterpret_cast<uintptr_t>(cursor)) & (alignment - 1);
+        }
+        char* p = cursor + pad;
+        cursor += pad + bytes;
+        left -= pad + bytes;
+        return p;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        size_t rounded = (max<size_t>(bytes, 1) + granule - 1) & ~(granule - 1);
+        if (rounded > maxPooled || alignment > granule) return bump(bytes, alignment);
+        FreeBlock*& head = freeLists[rounded / granule];
+        if (head) {
+            FreeBlock* block = head;
+            head = block->next;
+            return block;
+        }
+        return bump(rounded, granule);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        size_t rounded = (max<size_t>(bytes, 1) + granule - 1) & ~(granule - 1);
+        if (rounded > maxPooled || alignment > granule) return;
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = freeLists[rounded / granule];
+        freeLists[rounded / granule] = block;
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    explicit SlabResource(pmr::memory_resource* upstream = pmr::new_delete_resource()) : upstream(upstream) {}
+    SlabResource(const SlabResource&) = delete;
+    SlabResource& operator=(const SlabResource&) = delete;
+    ~SlabResource() { release(); }
+
+    // The next slab will hold at least bytes.
+    void reserve(size_t bytes) {
+        if (bytes > left) nextSlab = max(nextSlab, bytes);
+    }
+
+    // Frees every block at once, whether or not it was deallocated.
+    void release() {
+        for (const Slab& slab : slabs) upstream->deallocate(slab.bytes, slab.size, alignof(max_align_t));
+        slabs.clear();
+        fill(begin(freeLists), end(freeLists), nullptr);
+        cursor = nullptr;
+        left = 0;
+        nextSlab = minSlab;
+    }
+};
+
+// How an index gets memory for its nodes.
+//   Default: every node is its own heap allocation (operator new)
+//   Pool:    nodes come from a SlabResource; the whole slab set is handed
+//            back at once on reload
+enum class NodeAllocator { Default, Pool };
+
+inline bool parseNodeAllocator(const string& name, NodeAllocator& allocator) {
+    if (name == "default" || name == "malloc") allocator = NodeAllocator::Default;
+    else if (name == "pool") allocator = NodeAllocator::Pool;
+    else return false;
+    return true;
+}
+
+inline const char* nodeAllocatorName(NodeAllocator allocator) {
+    return allocator == NodeAllocator::Pool ? "pool" : "default";
+}
+
+struct NodeMemoryStats {
+    size_t requests = 0;           // node allocations the index asked for, ever
+    size_t liveBlocks = 0;         // nodes currently allocated
+    size_t liveBytes = 0;          // bytes those nodes use
+    size_t systemAllocations = 0;  // allocations that reached the heap, ever
+    size_t heldBytes = 0;          // heap bytes held now, headers included
+
+    // Share of the held bytes not holding a live node: malloc headers and
+    // rounding for Default; free blocks and the open slab's tail for Pool.
+    double fragmentation() const { return heldBytes ? 1 - double(liveBytes) / double(heldBytes) : 0; }
+};
+
+// The memory resource behind an index's node containers, with the counts
+// to compare allocators. Containers allocate from resource(); that
+// pointer stays the same across release().
+class NodeMemory {
+private:
+    NodeAllocator kind;
+    // What reaches the heap.
+    CountingResource system;
+    SlabResource slabs;
+    // What the containers ask for.
+    CountingResource requests;
+
+public:
+    explicit NodeMemory(NodeAllocator kind = NodeAllocator::Pool,
+                        pmr::memory_resource* upstream = pmr::new_delete_resource())
+        : kind(kind), system(upstream), slabs(&system),
+          requests(kind == NodeAllocator::Pool ? static_cast<pmr::memory_resource*>(&slabs) : &system) {}
+
+    NodeMemory(const NodeMemory&) = delete;
+    NodeMemory& operator=(const NodeMemory&) = delete;
+
+    NodeAllocator allocator() const { return kind; }
+    bool pooled() const { return kind == NodeAllocator::Pool; }
+    pmr::memory_resource* resource() { return &requests; }
+
+    // Pool only: hands the slabs back in O(slabs). Containers holding
+    // nodes must be emptied first (see ProductIndex::clearOrdered).
+    // expectedBytes sizes the next slab, so a bulk load of known size takes
+    // one heap allocation.
+    void release(size_t expectedBytes = 0) {
+        if (!pooled()) return;
+        slabs.release();
+        slabs.reserve(expectedBytes);
+        requests.forgetLive();
+    }
+
+    NodeMemoryStats stats() const {
+        NodeMemoryStats s;
+        s.requests = requests.allocationCount();
+        s.liveBlocks = requests.liveBlockCount();
+        s.liveBytes = requests.bytesLive();
+        s.systemAllocations = system.allocationCount();
+        s.heldBytes = system.heapBytes();
+        return s;
+    }
+};
+
+#endif
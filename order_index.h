@@ -0,0 +1,62 @@
+#ifndef ORDER_INDEX_H
+#define ORDER_INDEX_H
+
+#include <utility>
+#include <climits>
+#include <functional>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+
+using namespace std;
+
+// Products ordered by a numeric key (price, stock value, ...), as an
+// order-statistics tree: every node knows its subtree size, so besides
+// ordered iteration it answers "how many keys are below x" and "which key
+// has rank r" in O(log n). Entries are (key, id) so equal keys coexist and
+// ties come out in id order.
+class OrderedIndex {
+private:
+    typedef pair<double, int> Entry;
+    typedef __gnu_pbds::tree<Entry, __gnu_pbds::null_type, less<Entry>, __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update> Tree;
+
+    Tree tree;
+
+public:
+    void add(double key, int id) { tree.insert(Entry(key, id)); }
+    // key must be the one id was added with.
+    void remove(double key, int id) { tree.erase(Entry(key, id)); }
+    void clear() { tree.clear(); }
+    size_t size() const { return tree.size(); }
+
+    // Visits (key, id) for every key in [low, high], ascending. O(log n + k).
+    template <typename Visitor>
+    void forRange(double low, double high, Visitor visit) const {
+        for (auto it = tree.lower_bound(Entry(low, INT_MIN)); it != tree.end() && it->first <= high; ++it) {
+            visit(it->first, it->second);
+        }
+    }
+
+    // Visits (key, id) for the n largest keys, largest first. O(log n + n).
+    template <typename Visitor>
+    void forTop(size_t n, Visitor visit) const {
+        auto it = tree.end();
+        for (size_t i = 0; i < n && it != tree.begin(); i++) {
+            --it;
+            visit(it->first, it->second);
+        }
+    }
+
+    // Number of keys strictly below key.
+    size_t rank(double key) const { return tree.order_of_key(Entry(key, INT_MIN)); }
+
+    // Key at fraction p (0..1) of the way through the order: 0 is the
+    // smallest key, 1 the largest, 0.5 the median. Requires size() > 0.
+    double percentile(double p) const {
+        if (p < 0) p = 0;
+        if (p > 1) p = 1;
+        return tree.find_by_order(size_t(p * double(tree.size() - 1) + 0.5))->first;
+    }
+};
+
+#endif
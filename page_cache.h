@@ -0,0 +1,274 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct PageCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    // Dirty pages written out, on eviction or flush.
+    uint64_t writebacks = 0;
+
+    double hitRate() const { return hits + misses == 0 ? 0 : double(hits) / double(hits + misses); }
+};
+
+// Fixed-size pages of one file, cached in a fixed number of frames, so
+// memory stays the same however large the file grows. A miss takes a frame
+// by CLOCK (the hand skips pages referenced since it last passed, clearing
+// their bit, and pinned ones) and reads the page in; a dirty victim is
+// written back first. Nothing reaches the file until then or flush().
+//
+// fetch() and allocate() return a Ref, which pins the page while it lives;
+// the data it points at is only valid until the Ref goes. Callers must hold
+// fewer Refs than there are frames.
+class PageCache {
+public:
+    static constexpr size_t pageSize = 4096;
+    static constexpr uint32_t noPage = UINT32_MAX;
+
+private:
+    struct Frame {
+        uint32_t page = noPage;
+        uint32_t pins = 0;
+        bool referenced = false;
+        bool dirty = false;
+    };
+
+    int fd = -1;
+    vector<Frame> frames;
+    unique_ptr<char[]> memory;
+    // page -> frame for the resident pages.
+    unordered_map<uint32_t, uint32_t> table;
+    size_t hand = 0;
+    uint32_t pageCount = 0;
+    PageCacheStats counts;
+    string failure;
+
+    char* frameData(uint32_t frame) const { return memory.get() + size_t(frame) * pageSize; }
+
+    void fail(const string& message) {
+        if (failure.empty()) failure = message + ": " + strerror(errno);
+    }
+
+    void writeFrame(uint32_t frame) {
+        Frame& f = frames[frame];
+        const char* p = frameData(frame);
+        off_t offset = off_t(f.page) * off_t(pageSize);
+        for (size_t done = 0; done < pageSize;) {
+            ssize_t n = ::pwrite(fd, p + done, pageSize - done, offset + off_t(done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail("could not write page " + to_string(f.page));
+                break;
+            }
+            done += size_t(n);
+        }
+        f.dirty = false;
+        counts.writebacks++;
+    }
+
+    void readFrame(uint32_t frame, uint32_t page) {
+        char* p = frameData(frame);
+        off_t offset = off_t(page) * off_t(pageSize);
+        size_t done = 0;
+        while (done < pageSize) {
+            ssize_t n = ::pread(fd, p + done, pageSize - done, offset + off_t(done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail("could not read page " + to_string(page));
+                break;
+            }
+            if (n == 0) break;
+            done += size_t(n);
+        }
+        memset(p + done, 0, pageSize - done);
+    }
+
+    // A frame to hold a new page, emptied of whatever it held.
+    uint32_t takeFrame() {
+        for (size_t step = 0;; step++) {
+            uint32_t frame = uint32_t(hand);
+            hand = hand + 1 == frames.size() ? 0 : hand + 1;
+            Frame& f = frames[frame];
+            if (f.pins > 0) {
+                // Two full turns without a candidate: everything is pinned.
+                if (step > 2 * frames.size()) abort();
+                continue;
+            }
+            if (f.page != noPage && f.referenced) {
+                f.referenced = false;
+                continue;
+            }
+            if (f.page != noPage) {
+                if (f.dirty) writeFrame(frame);
+                table.erase(f.page);
+                counts.evictions++;
+            }
+            return frame;
+        }
+    }
+
+    uint32_t install(uint32_t frame, uint32_t page) {
+        Frame& f = frames[frame];
+        f.page = page;
+        f.pins = 1;
+        f.referenced = true;
+        f.dirty = false;
+        table.emplace(page, frame);
+        return frame;
+    }
+
+public:
+    class Ref {
+    private:
+        PageCache* cache = nullptr;
+        uint32_t frame = 0;
+
+    public:
+        Ref() {}
+        Ref(PageCache* cache, uint32_t frame) : cache(cache), frame(frame) {}
+        Ref(Ref&& other) : cache(other.cache), frame(other.frame) { other.cache = nullptr; }
+        Ref& operator=(Ref&& other) {
+            if (this != &other) {
+                release();
+                cache = other.cache;
+                frame = other.frame;
+                other.cache = nullptr;
+            }
+            return *this;
+        }
+        Ref(const Ref&) = delete;
+        Ref& operator=(const Ref&) = delete;
+        ~Ref() { release(); }
+
+        void release() {
+            if (cache) cache->frames[frame].pins--;
+            cache = nullptr;
+        }
+
+        uint32_t page() const { return cache->frames[frame].page; }
+        const char* data() const { return cache->frameData(frame); }
+        // For writing: marks the page to be written back.
+        char* edit() {
+            cache->frames[frame].dirty = true;
+            return cache->frameData(frame);
+        }
+    };
+
+    PageCache() {}
+    PageCache(const PageCache&) = delete;
+    PageCache& operator=(const PageCache&) = delete;
+    ~PageCache() { close(); }
+
+    // Opens (or creates) path with room for frameCount pages in memory.
+    bool open(const string& path, size_t frameCount) {
+        close();
+        failure.clear();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            fail("could not open " + path);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size % off_t(pageSize) != 0) {
+            if (failure.empty()) failure = path + " is not a page file";
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        pageCount = uint32_t(st.st_size / off_t(pageSize));
+        frames.assign(max<size_t>(frameCount, 16), Frame());
+        memory.reset(new char[frames.size() * pageSize]);
+        table.clear();
+        table.reserve(frames.size());
+        hand = 0;
+        counts = PageCacheStats();
+        return true;
+    }
+
+    // Drops the cached pages without writing them; see flush().
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        table.clear();
+        frames.clear();
+        memory.reset();
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    Ref fetch(uint32_t page) {
+        auto it = table.find(page);
+        if (it != table.end()) {
+            Frame& f = frames[it->second];
+            f.pins++;
+            f.referenced = true;
+            counts.hits++;
+            return Ref(this, it->second);
+        }
+        counts.misses++;
+        uint32_t frame = takeFrame();
+        readFrame(frame, page);
+        return Ref(this, install(frame, page));
+    }
+
+    // A new zeroed page at the end of the file.
+    Ref allocate() {
+        uint32_t frame = takeFrame();
+        memset(frameData(frame), 0, pageSize);
+        Ref ref(this, install(frame, pageCount++));
+        ref.edit();
+        return ref;
+    }
+
+    // Writes every dirty page, in page order, and syncs the file.
+    bool flush() {
+        vector<pair<uint32_t, uint32_t>> dirty;
+        for (uint32_t frame = 0; frame < frames.size(); frame++) {
+            if (frames[frame].dirty) dirty.emplace_back(frames[frame].page, frame);
+        }
+        sort(dirty.begin(), dirty.end());
+        for (const auto& entry : dirty) writeFrame(entry.second);
+        if (fd >= 0 && ::fdatasync(fd) != 0) fail("could not sync");
+        return failure.empty();
+    }
+
+    // Empties the file. No Ref may be held.
+    bool truncate() {
+        for (Frame& f : frames) f = Frame();
+        table.clear();
+        pageCount = 0;
+        if (::ftruncate(fd, 0) != 0) fail("could not truncate");
+        return failure.empty();
+    }
+
+    uint32_t pages() const { return pageCount; }
+    size_t frameCount() const { return frames.size(); }
+    size_t residentPages() const { return table.size(); }
+    size_t dirtyPages() const {
+        return size_t(count_if(frames.begin(), frames.end(), [](const Frame& f) { return f.dirty; }));
+    }
+    const PageCacheStats& stats() const { return counts; }
+    bool failed() const { return !failure.empty(); }
+    const string& error() const { return failure; }
+
+    size_t memoryBytes() const {
+        return frames.size() * (pageSize + sizeof(Frame)) + table.bucket_count() * sizeof(void*)
+            + table.size() * (sizeof(pair<uint32_t, uint32_t>) + 2 * sizeof(void*));
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef PRODUCT_H
+#define PRODUCT_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+using namespace std;
+
+// name and category are non-owning views. A Product built by a caller views
+// the caller's strings; Inventory copies them into its own arena and
+// category dictionary when the product is added, so the caller's strings
+// only have to live until addProduct/updateProduct returns. Products inside
+// an Inventory should be renamed through updateProduct, not the setters.
+class Product {
+private:
+    int id;
+    string_view name;
+    string_view category;
+    double price;
+    int quantity;
+    // Dictionary code of category; only meaningful inside an Inventory.
+    uint32_t categoryCode;
+    double margin;
+
+public:
+    Product() : id(0), price(0), quantity(0), categoryCode(0), margin(0) {} // Default constructor
+    Product(int id, string_view name, string_view category, double price, int quantity, double margin)
+        : id(id), name(name), category(category), price(price), quantity(quantity), categoryCode(0), margin(margin) {}
+
+    int getId() const { return id; }
+    string_view getName() const { return name; }
+    string_view getCategory() const { return category; }
+    uint32_t getCategoryCode() const { return categoryCode; }
+    double getPrice() const { return price; }
+    int getQuantity() const { return quantity; }
+    double getMargin() const { return margin; }
+
+    void setName(string_view name) { this->name = name; }
+    void setCategory(string_view category) { this->category = category; }
+    void setCategory(string_view category, uint32_t code) {
+        this->category = category;
+        categoryCode = code;
+    }
+    void setPrice(double price) { this->price = price; }
+    void setQuantity(int quantity) { this->quantity = quantity; }
+    void setMargin(double margin) { this->margin = margin; }
+};
+
+#endif
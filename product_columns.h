@@ -0,0 +1,160 @@
+#ifndef PRODUCT_COLUMNS_H
+#define PRODUCT_COLUMNS_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "product.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define PRODUCT_COLUMNS_AVX2 1
+#endif
+
+using namespace std;
+
+struct ColumnTotals {
+    double revenue = 0;
+    double profit = 0;
+};
+
+// The numeric fields of every product as parallel arrays indexed by
+// ProductIndex slot, so aggregates stream through 20 bytes per product
+// instead of whole 64-byte Products. Free slots hold zeros, so add nothing,
+// and freeCode for their category.
+class ProductColumns {
+public:
+    static constexpr uint32_t freeCode = UINT32_MAX;
+
+private:
+    // Rows summed per partial result; keeps rounding error from growing
+    // with the row count.
+    static constexpr size_t blockRows = 4096;
+
+    vector<double> prices;
+    vector<int32_t> quantities;
+    vector<double> margins;
+    vector<uint32_t> codes;
+
+    // revenue = sum(price * quantity); profit is sum(revenue * margin) and
+    // still needs dividing by 100.
+    static ColumnTotals sumScalar(const double* price, const int32_t* quantity, const double* margin,
+                                  size_t begin, size_t end) {
+        ColumnTotals sum;
+        for (size_t i = begin; i < end; i++) {
+            double revenue = price[i] * quantity[i];
+            sum.revenue += revenue;
+            sum.profit += revenue * margin[i];
+        }
+        return sum;
+    }
+
+#ifdef PRODUCT_COLUMNS_AVX2
+    // Eight rows per iteration in two independent accumulator pairs. Built
+    // for AVX2 regardless of -march and only called when the CPU has it.
+    __attribute__((target("avx2")))
+    static ColumnTotals sumAvx2(const double* price, const int32_t* quantity, const double* margin,
+                                size_t begin, size_t end) {
+        __m256d revenue0 = _mm256_setzero_pd(), revenue1 = _mm256_setzero_pd();
+        __m256d profit0 = _mm256_setzero_pd(), profit1 = _mm256_setzero_pd();
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256d q0 = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantity + i)));
+            __m256d q1 = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantity + i + 4)));
+            __m256d r0 = _mm256_mul_pd(_mm256_loadu_pd(price + i), q0);
+            __m256d r1 = _mm256_mul_pd(_mm256_loadu_pd(price + i + 4), q1);
+            revenue0 = _mm256_add_pd(revenue0, r0);
+            revenue1 = _mm256_add_pd(revenue1, r1);
+            profit0 = _mm256_add_pd(profit0, _mm256_mul_pd(r0, _mm256_loadu_pd(margin + i)));
+            profit1 = _mm256_add_pd(profit1, _mm256_mul_pd(r1, _mm256_loadu_pd(margin + i + 4)));
+        }
+        alignas(32) double lanes[4];
+        ColumnTotals sum = sumScalar(price, quantity, margin, i, end);
+        _mm256_store_pd(lanes, _mm256_add_pd(revenue0, revenue1));
+        sum.revenue += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        _mm256_store_pd(lanes, _mm256_add_pd(profit0, profit1));
+        sum.profit += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        return sum;
+    }
+#endif
+
+public:
+    // Mirrors product into slot.
+    void set(uint32_t slot, const Product& product) {
+        if (slot >= prices.size()) {
+            prices.resize(slot + 1);
+            quantities.resize(slot + 1);
+            margins.resize(slot + 1);
+            codes.resize(slot + 1, freeCode);
+        }
+        prices[slot] = product.getPrice();
+        quantities[slot] = product.getQuantity();
+        margins[slot] = product.getMargin();
+        codes[slot] = product.getCategoryCode();
+    }
+
+    void erase(uint32_t slot) {
+        prices[slot] = 0;
+        quantities[slot] = 0;
+        margins[slot] = 0;
+        codes[slot] = freeCode;
+    }
+
+    void clear() {
+        prices.clear();
+        quantities.clear();
+        margins.clear();
+        codes.clear();
+    }
+
+    // Slots covered; rows past the last product's slot are not stored.
+    size_t rowCount() const { return prices.size(); }
+    const double* priceColumn() const { return prices.data(); }
+    const int32_t* quantityColumn() const { return quantities.data(); }
+    const double* marginColumn() const { return margins.data(); }
+    const uint32_t* codeColumn() const { return codes.data(); }
+
+    size_t memoryBytes() const {
+        return prices.capacity() * sizeof(double) + quantities.capacity() * sizeof(int32_t)
+            + margins.capacity() * sizeof(double) + codes.capacity() * sizeof(uint32_t);
+    }
+
+    // Exact (up to double rounding) revenue and profit over every product.
+    ColumnTotals totals() const {
+#ifdef PRODUCT_COLUMNS_AVX2
+        bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        ColumnTotals total;
+        size_t n = prices.size();
+        for (size_t begin = 0; begin < n; begin += blockRows) {
+            size_t end = min(begin + blockRows, n);
+            ColumnTotals block;
+#ifdef PRODUCT_COLUMNS_AVX2
+            block = avx2 ? sumAvx2(prices.data(), quantities.data(), margins.data(), begin, end)
+                         : sumScalar(prices.data(), quantities.data(), margins.data(), begin, end);
+#else
+            block = sumScalar(prices.data(), quantities.data(), margins.data(), begin, end);
+#endif
+            total.revenue += block.revenue;
+            total.profit += block.profit;
+        }
+        total.profit /= 100;
+        return total;
+    }
+
+    // Revenue and profit per category code; split[code] for every code seen.
+    // Scattering by code doesn't vectorize, so this is a plain loop.
+    void totalsByCategory(vector<ColumnTotals>& split) const {
+        split.clear();
+        for (size_t i = 0; i < prices.size(); i++) {
+            if (codes[i] == freeCode) continue;
+            if (codes[i] >= split.size()) split.resize(codes[i] + 1);
+            double revenue = prices[i] * quantities[i];
+            split[codes[i]].revenue += revenue;
+            split[codes[i]].profit += revenue * margins[i];
+        }
+        for (ColumnTotals& totals : split) totals.profit /= 100;
+    }
+};
+
+#endif
@@ -0,0 +1,413 @@
+#ifndef PRODUCT_INDEX_H
+#define PRODUCT_INDEX_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include "product.h"
+#include "slot_store.h"
+#include "node_memory.h"
+
+using namespace std;
+
+enum class IndexBackend { Auto, Ordered, Dense, Hash };
+
+// Maps product ids to products. Products live in fixed-size pages of
+// slots; the index itself only stores (id -> slot) and can grow or rehash
+// freely. Once a view has been taken, the first write to a page copies it,
+// moving every product on it, so a Product* or Product& is only valid until
+// the next add, erase or modify of any product.
+//   Dense:   direct-addressed slot table over [base, base + size), O(1)
+//   Hash:    open addressing with linear probing, O(1) expected
+//   Ordered: std::map, O(log n); its nodes come from a NodeMemory
+//   Auto:    Dense while ids stay dense, switches to Hash once they don't
+class ProductIndex {
+public:
+    static constexpr uint32_t npos = numeric_limits<uint32_t>::max();
+
+private:
+    // Past this point a dense table would use more memory than the hash table.
+    static constexpr size_t denseFactor = 4;
+    static constexpr size_t denseSlack = size_t(1) << 16;
+    // A red-black tree node: three links and a colour, then the pair.
+    static constexpr size_t orderedNodeBytes = 4 * sizeof(void*) + sizeof(pair<const int, uint32_t>);
+
+    struct HashEntry {
+        int id;
+        uint32_t slot;
+    };
+
+    IndexBackend requested;
+    IndexBackend active;
+    size_t count = 0;
+
+    SlotStore slots;
+    vector<uint32_t> freeSlots;
+    uint32_t nextSlot = 0;
+
+    long long denseBase = 0;
+    vector<uint32_t> dense;
+
+    vector<HashEntry> table;
+    size_t hashShift = 64;
+    // Id range seen while hashing, so Auto can move back to the dense table.
+    long long minId = 0;
+    long long maxId = -1;
+
+    // Declared before ordered, which allocates from it.
+    NodeMemory nodes;
+    pmr::map<int, uint32_t> ordered;
+
+    // Pooled: the map is emptied first (its nodes only go onto the slab
+    // free lists), then the slabs are dropped at once and the next one
+    // sized for expectedNodes.
+    void clearOrdered(size_t expectedNodes = 0) {
+        if (ordered.empty() && expectedNodes == 0) return;
+        ordered.clear();
+        nodes.release(expectedNodes * orderedNodeBytes);
+    }
+
+    uint32_t allocateSlot() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if ((nextSlot >> SlotStore::pageShift) == slots.pageCount()) slots.grow();
+        return nextSlot++;
+    }
+
+    void releaseSlot(uint32_t slot) {
+        slots.release(slot);
+        freeSlots.push_back(slot);
+    }
+
+    size_t bucketOf(int id) const {
+        // Fibonacci hashing spreads sequential ids across the table.
+        return size_t((uint64_t(uint32_t(id)) * 0x9E3779B97F4A7C15ull) >> hashShift);
+    }
+
+    uint32_t hashFind(int id) const {
+        if (table.empty()) return npos;
+        size_t mask = table.size() - 1;
+        for (size_t i = bucketOf(id);; i = (i + 1) & mask) {
+            const HashEntry& e = table[i];
+            if (e.slot == npos) return npos;
+            if (e.id == id) return e.slot;
+        }
+    }
+
+    void hashPut(int id, uint32_t slot) {
+        size_t mask = table.size() - 1;
+        size_t i = bucketOf(id);
+        while (table[i].slot != npos) i = (i + 1) & mask;
+        table[i] = {id, slot};
+    }
+
+    void hashRehash(size_t capacity) {
+        vector<HashEntry> old;
+        old.swap(table);
+        table.assign(capacity, HashEntry{0, npos});
+        hashShift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) hashShift--;
+        for (const HashEntry& e : old) {
+            if (e.slot != npos) hashPut(e.id, e.slot);
+        }
+    }
+
+    void hashInsert(int id, uint32_t slot) {
+        minId = min<long long>(minId, id);
+        maxId = max<long long>(maxId, id);
+        // Keep the load factor under 0.7 so probe sequences stay short.
+        if ((count + 1) * 10 > table.size() * 7) {
+            // Shuffled dense ids look sparse at first; check again on every
+            // doubling whether they have filled in.
+            if (requested == IndexBackend::Auto && size_t(maxId - minId + 1) <= denseFactor * (count + 1)) {
+                switchToDense();
+                dense[size_t(id - denseBase)] = slot;
+                return;
+            }
+            hashRehash(max<size_t>(16, table.size() * 2));
+        }
+        hashPut(id, slot);
+    }
+
+    void hashErase(int id) {
+        size_t mask = table.size() - 1;
+        size_t i = bucketOf(id);
+        while (table[i].id != id || table[i].slot == npos) i = (i + 1) & mask;
+        // Backward-shift deletion: no tombstones, so lookups never slow down.
+        for (size_t j = (i + 1) & mask; table[j].slot != npos; j = (j + 1) & mask) {
+            size_t home = bucketOf(table[j].id);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i].slot = npos;
+    }
+
+    uint32_t denseFind(int id) const {
+        long long offset = id - denseBase;
+        if (offset < 0 || offset >= (long long)dense.size()) return npos;
+        return dense[size_t(offset)];
+    }
+
+    // Grows the dense table to cover id. Returns false when that would make
+    // the table too sparse and the caller should fall back to hashing.
+    bool denseCover(int id) {
+        if (dense.empty()) {
+            denseBase = id;
+            dense.assign(1, npos);
+            return true;
+        }
+        long long low = min<long long>(denseBase, id);
+        long long high = max<long long>(denseBase + (long long)dense.size() - 1, id);
+        size_t span = size_t(high - low + 1);
+        if (span <= dense.size()) return true;
+        if (requested == IndexBackend::Auto && span > denseFactor * (count + 1) + denseSlack) {
+            return false;
+        }
+        size_t newSize = max(span, dense.size() * 2);
+        long long newBase = id < denseBase ? high - (long long)newSize + 1 : denseBase;
+        vector<uint32_t> grown(newSize, npos);
+        copy(dense.begin(), dense.end(), grown.begin() + (denseBase - newBase));
+        dense.swap(grown);
+        denseBase = newBase;
+        return true;
+    }
+
+    void switchToHash() {
+        active = IndexBackend::Hash;
+        minId = denseBase;
+        maxId = denseBase + (long long)dense.size() - 1;
+        hashRehash(max<size_t>(16, size_t(1) << (64 - __builtin_clzll(count * 2 + 1))));
+        for (size_t i = 0; i < dense.size(); i++) {
+            if (dense[i] != npos) hashPut(int(denseBase + (long long)i), dense[i]);
+        }
+        vector<uint32_t>().swap(dense);
+    }
+
+    void switchToDense() {
+        active = IndexBackend::Dense;
+        denseBase = minId;
+        dense.assign(size_t(maxId - minId + 1), npos);
+        for (const HashEntry& e : table) {
+            if (e.slot != npos) dense[size_t(e.id - denseBase)] = e.slot;
+        }
+        vector<HashEntry>().swap(table);
+    }
+
+public:
+    explicit ProductIndex(IndexBackend backend = IndexBackend::Auto, NodeAllocator allocator = NodeAllocator::Pool,
+                          pmr::memory_resource* upstream = pmr::new_delete_resource())
+        : requested(backend), active(backend == IndexBackend::Auto ? IndexBackend::Dense : backend),
+          nodes(allocator, upstream), ordered(nodes.resource()) {}
+
+    IndexBackend backend() const { return active; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Slot holding id, or npos. A product keeps its slot until it is erased
+    // and every slot is below slotCount(), so side arrays indexed by slot can
+    // shadow the products.
+    uint32_t slotOf(int id) const {
+        switch (active) {
+            case IndexBackend::Dense:
+                return denseFind(id);
+            case IndexBackend::Hash:
+                return hashFind(id);
+            default: {
+                auto it = ordered.find(id);
+                return it == ordered.end() ? npos : it->second;
+            }
+        }
+    }
+    size_t slotCount() const { return nextSlot; }
+    // The product in slot, which must hold one.
+    const Product& at(uint32_t slot) const { return slots.at(slot); }
+
+    // Bytes held by product slots and the active index structure.
+    size_t slotBytes() const { return slots.memoryBytes(); }
+    size_t indexBytes() const {
+        return dense.capacity() * sizeof(uint32_t) + table.capacity() * sizeof(HashEntry)
+            + freeSlots.capacity() * sizeof(uint32_t) + nodes.stats().heldBytes;
+    }
+    NodeAllocator nodeAllocator() const { return nodes.allocator(); }
+    NodeMemoryStats nodeStats() const { return nodes.stats(); }
+
+    const Product* find(int id) const {
+        uint32_t slot = slotOf(id);
+        return slot == npos ? nullptr : &at(slot);
+    }
+
+    // Like find, for changing the product in place. Products must only be
+    // written through this, never through find's pointer, or views would
+    // see the change.
+    Product* modify(int id) {
+        uint32_t slot = slotOf(id);
+        return slot == npos ? nullptr : &slots.modify(slot);
+    }
+
+    // modify for a slot already looked up with slotOf.
+    Product& modifySlot(uint32_t slot) { return slots.modify(slot); }
+
+    // O(1) read-only copy of every product, see SlotStore.
+    SlotStore::View view() { return slots.view(); }
+
+    // Returns nullptr if the id is already present.
+    const Product* insert(const Product& product) {
+        int id = product.getId();
+        if (slotOf(id) != npos) return nullptr;
+
+        if (active == IndexBackend::Dense && !denseCover(id)) {
+            switchToHash();
+        }
+        uint32_t slot = allocateSlot();
+        slots.put(slot, product);
+        switch (active) {
+            case IndexBackend::Dense:
+                dense[size_t(id - denseBase)] = slot;
+                break;
+            case IndexBackend::Hash:
+                hashInsert(id, slot);
+                break;
+            default:
+                ordered.emplace(id, slot);
+                break;
+        }
+        count++;
+        return &at(slot);
+    }
+
+    bool erase(int id) {
+        uint32_t slot = slotOf(id);
+        if (slot == npos) return false;
+        switch (active) {
+            case IndexBackend::Dense:
+                dense[size_t(id - denseBase)] = npos;
+                break;
+            case IndexBackend::Hash:
+                hashErase(id);
+                break;
+            default:
+                ordered.erase(id);
+                break;
+        }
+        releaseSlot(slot);
+        count--;
+        return true;
+    }
+
+    void clear() {
+        count = 0;
+        slots.clear();
+        freeSlots.clear();
+        nextSlot = 0;
+        vector<uint32_t>().swap(dense);
+        vector<HashEntry>().swap(table);
+        clearOrdered();
+        minId = 0;
+        maxId = -1;
+        active = requested == IndexBackend::Auto ? IndexBackend::Dense : requested;
+    }
+
+    // Replaces the contents with rows. When a row id repeats, the later row
+    // wins. Ids already in ascending order (as saveInventoryToFile writes
+    // them) are built in O(n); anything else is stable-sorted first. Rows
+    // are left sorted and de-duplicated.
+    void bulkLoad(vector<Product>& rows) {
+        clear();
+        auto byId = [](const Product& a, const Product& b) { return a.getId() < b.getId(); };
+        if (!is_sorted(rows.begin(), rows.end(), byId)) {
+            stable_sort(rows.begin(), rows.end(), byId);
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (i + 1 < rows.size() && rows[i + 1].getId() == rows[i].getId()) continue;
+            if (kept != i) rows[kept] = move(rows[i]);
+            kept++;
+        }
+        rows.resize(kept);
+        if (rows.empty()) return;
+
+        minId = rows.front().getId();
+        maxId = rows.back().getId();
+        size_t span = size_t(maxId - minId + 1);
+        if (requested == IndexBackend::Auto) {
+            active = span <= denseFactor * rows.size() + denseSlack ? IndexBackend::Dense : IndexBackend::Hash;
+        }
+        if (active == IndexBackend::Dense) {
+            denseBase = minId;
+            dense.assign(span, npos);
+        } else if (active == IndexBackend::Hash) {
+            size_t capacity = 16;
+            while (capacity * 7 < rows.size() * 10) capacity *= 2;
+            hashRehash(capacity);
+        } else {
+            clearOrdered(rows.size());
+        }
+
+        for (Product& row : rows) {
+            uint32_t slot = allocateSlot();
+            int id = row.getId();
+            slots.put(slot, row);
+            if (active == IndexBackend::Dense) {
+                dense[size_t(id - denseBase)] = slot;
+            } else if (active == IndexBackend::Hash) {
+                hashPut(id, slot);
+            } else {
+                ordered.emplace_hint(ordered.end(), id, slot);
+            }
+        }
+        count = rows.size();
+    }
+
+    // Visits products in ascending id order.
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        switch (active) {
+            case IndexBackend::Dense:
+                for (uint32_t slot : dense) {
+                    if (slot != npos) visit(at(slot));
+                }
+                break;
+            case IndexBackend::Hash: {
+                vector<HashEntry> sorted;
+                sorted.reserve(count);
+                for (const HashEntry& e : table) {
+                    if (e.slot != npos) sorted.push_back(e);
+                }
+                sort(sorted.begin(), sorted.end(),
+                     [](const HashEntry& a, const HashEntry& b) { return a.id < b.id; });
+                for (const HashEntry& e : sorted) visit(at(e.slot));
+                break;
+            }
+            default:
+                for (const auto& pair : ordered) visit(at(pair.second));
+                break;
+        }
+    }
+};
+
+inline IndexBackend parseIndexBackend(const string& name) {
+    if (name == "ordered") return IndexBackend::Ordered;
+    if (name == "dense") return IndexBackend::Dense;
+    if (name == "hash") return IndexBackend::Hash;
+    return IndexBackend::Auto;
+}
+
+inline const char* indexBackendName(IndexBackend backend) {
+    switch (backend) {
+        case IndexBackend::Ordered: return "ordered";
+        case IndexBackend::Dense: return "dense";
+        case IndexBackend::Hash: return "hash";
+        default: return "auto";
+    }
+}
+
+#endif
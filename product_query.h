@@ -0,0 +1,546 @@
+#ifndef PRODUCT_QUERY_H
+#define PRODUCT_QUERY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include "product_columns.h"
+#include "csv_loader.h"
+
+using namespace std;
+
+// Value is price * quantity, profit value * margin / 100.
+enum class QueryField { Id, Name, Category, Price, Quantity, Margin, Value, Profit };
+enum class QueryFunction { None, Count, Sum, Avg, Min, Max };
+enum class QueryOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+// A result column: a field, or a function of one (count takes none).
+struct QueryItem {
+    QueryFunction function = QueryFunction::None;
+    QueryField field = QueryField::Id;
+
+    bool operator==(const QueryItem& other) const {
+        return function == other.function && (function == QueryFunction::Count || field == other.field);
+    }
+};
+
+struct QueryCondition {
+    QueryField field = QueryField::Price;
+    QueryOp op = QueryOp::Eq;
+    double number = 0;
+    string category;
+    // category's dictionary code, set by the caller before the query runs;
+    // freeCode, which no product has, if there is no such category.
+    uint32_t code = ProductColumns::freeCode;
+};
+
+//   [select <item>, ...] [where <condition> and ...] [group by category]
+//   [order by <item> [asc|desc]] [limit <n>]
+//
+// item: * | id | name | category | price | quantity | margin | value |
+//       profit | count | sum(<field>) | avg(...) | min(...) | max(...)
+// condition: category = <name> | category != <name> |
+//            <field> <op> <number>, op one of = != < <= > >=
+//
+// Names with spaces go in quotes. Without functions or a group, the query
+// lists products (select * when no select is given); otherwise it gives one
+// row per category, or one row for all, and may select category alone
+// besides functions.
+struct Query {
+    vector<QueryItem> items;
+    vector<QueryCondition> conditions;
+    bool groupByCategory = false;
+    bool ordered = false;
+    QueryItem orderBy;
+    bool descending = false;
+    size_t limit = SIZE_MAX;
+
+    bool aggregates() const {
+        if (groupByCategory) return true;
+        for (const QueryItem& item : items) {
+            if (item.function != QueryFunction::None) return true;
+        }
+        return false;
+    }
+};
+
+inline const char* queryFieldName(QueryField field) {
+    static const char* const names[] = {"id", "name", "category", "price", "quantity", "margin", "value", "profit"};
+    return names[size_t(field)];
+}
+
+inline string queryItemName(const QueryItem& item) {
+    static const char* const functions[] = {"", "count", "sum", "avg", "min", "max"};
+    if (item.function == QueryFunction::None) return queryFieldName(item.field);
+    if (item.function == QueryFunction::Count) return "count";
+    return string(functions[size_t(item.function)]) + "(" + queryFieldName(item.field) + ")";
+}
+
+inline bool isNumericField(QueryField field) { return field >= QueryField::Price; }
+
+class QueryParser {
+private:
+    vector<string> tokens;
+    // Whether each token was quoted, so it is never taken for a keyword.
+    vector<bool> quoted;
+    size_t next = 0;
+    string& error;
+
+    static bool isOperatorChar(char c) { return c == '<' || c == '>' || c == '=' || c == '!'; }
+
+    bool tokenize(string_view text) {
+        for (size_t i = 0; i < text.size();) {
+            char c = text[i];
+            if (isspace(uint8_t(c))) {
+                i++;
+            } else if (c == '"' || c == '\'') {
+                size_t close = text.find(c, i + 1);
+                if (close == string_view::npos) {
+                    error = "unterminated quote";
+                    return false;
+                }
+                tokens.emplace_back(text.substr(i + 1, close - i - 1));
+                quoted.push_back(true);
+                i = close + 1;
+            } else if (c == ',' || c == '(' || c == ')' || c == '*') {
+                tokens.emplace_back(1, c);
+                quoted.push_back(false);
+                i++;
+            } else {
+                size_t start = i;
+                bool op = isOperatorChar(c);
+                while (i < text.size() && !isspace(uint8_t(text[i])) && isOperatorChar(text[i]) == op
+                       && text[i] != ',' && text[i] != '(' && text[i] != ')' && text[i] != '"' && text[i] != '\'') {
+                    i++;
+                }
+                tokens.emplace_back(text.substr(start, i - start));
+                quoted.push_back(false);
+            }
+        }
+        return true;
+    }
+
+    bool atEnd() const { return next == tokens.size(); }
+
+    // Whether the next token is keyword (in any case); takes it if so.
+    bool accept(const char* keyword) {
+        if (atEnd() || quoted[next] || tokens[next].size() != strlen(keyword)) return false;
+        for (size_t i = 0; keyword[i]; i++) {
+            if (tolower(uint8_t(tokens[next][i])) != keyword[i]) return false;
+        }
+        next++;
+        return true;
+    }
+
+    bool expect(const char* keyword) {
+        if (accept(keyword)) return true;
+        error = string("expected ") + keyword + (atEnd() ? " at the end" : " before " + tokens[next]);
+        return false;
+    }
+
+    bool parseField(QueryField& field) {
+        static const char* const names[] = {"id", "name", "category", "price", "quantity", "margin", "value", "profit"};
+        for (size_t f = 0; f < 8; f++) {
+            if (accept(names[f])) {
+                field = QueryField(f);
+                return true;
+            }
+        }
+        error = atEnd() ? "expected a field at the end" : "unknown field " + tokens[next];
+        return false;
+    }
+
+    bool parseItem(QueryItem& item) {
+        static const char* const functions[] = {"sum", "avg", "min", "max"};
+        if (accept("count")) {
+            item.function = QueryFunction::Count;
+            if (accept("(")) {
+                accept("*");
+                return expect(")");
+            }
+            return true;
+        }
+        for (size_t f = 0; f < 4; f++) {
+            if (!accept(functions[f])) continue;
+            item.function = QueryFunction(size_t(QueryFunction::Sum) + f);
+            if (!expect("(") || !parseField(item.field) || !expect(")")) return false;
+            if (!isNumericField(item.field)) {
+                error = string(functions[f]) + " needs a number field, not " + queryFieldName(item.field);
+                return false;
+            }
+            return true;
+        }
+        item.function = QueryFunction::None;
+        return parseField(item.field);
+    }
+
+    bool parseOp(QueryOp& op) {
+        static const pair<const char*, QueryOp> ops[] = {
+            {"=", QueryOp::Eq}, {"==", QueryOp::Eq}, {"!=", QueryOp::Ne}, {"<>", QueryOp::Ne},
+            {"<", QueryOp::Lt}, {"<=", QueryOp::Le}, {">", QueryOp::Gt}, {">=", QueryOp::Ge}};
+        for (const auto& entry : ops) {
+            if (accept(entry.first)) {
+                op = entry.second;
+                return true;
+            }
+        }
+        error = atEnd() ? "expected a comparison at the end" : "expected a comparison before " + tokens[next];
+        return false;
+    }
+
+    bool parseCondition(QueryCondition& condition) {
+        if (!parseField(condition.field) || !parseOp(condition.op)) return false;
+        if (atEnd()) {
+            error = "expected a value at the end";
+            return false;
+        }
+        const string& value = tokens[next++];
+        if (condition.field == QueryField::Category) {
+            if (condition.op != QueryOp::Eq && condition.op != QueryOp::Ne) {
+                error = "category can only be compared with = or !=";
+                return false;
+            }
+            condition.category = value;
+            return true;
+        }
+        if (!isNumericField(condition.field)) {
+            error = string("can't filter on ") + queryFieldName(condition.field);
+            return false;
+        }
+        const char* end = value.data() + value.size();
+        if (!parseDoubleField(value.data(), end, condition.number)) {
+            error = "expected a number, not " + value;
+            return false;
+        }
+        return true;
+    }
+
+    static void selectAll(Query& query) {
+        for (QueryField field : {QueryField::Id, QueryField::Name, QueryField::Category, QueryField::Price,
+                                 QueryField::Quantity, QueryField::Margin}) {
+            query.items.push_back({QueryFunction::None, field});
+        }
+    }
+
+    bool parseSelect(Query& query) {
+        do {
+            if (accept("*")) {
+                selectAll(query);
+                continue;
+            }
+            QueryItem item;
+            if (!parseItem(item)) return false;
+            query.items.push_back(item);
+        } while (accept(","));
+        return true;
+    }
+
+    bool validate(Query& query) {
+        bool aggregates = query.aggregates();
+        if (query.items.empty()) {
+            if (aggregates) {
+                query.items = {{QueryFunction::None, QueryField::Category}, {QueryFunction::Count, QueryField::Id},
+                               {QueryFunction::Sum, QueryField::Quantity}, {QueryFunction::Sum, QueryField::Value},
+                               {QueryFunction::Sum, QueryField::Profit}};
+                if (!query.groupByCategory) query.items.erase(query.items.begin());
+            } else {
+                selectAll(query);
+            }
+        }
+        if (!aggregates) {
+            if (query.ordered && query.orderBy.function != QueryFunction::None) {
+                error = "can't order products by " + queryItemName(query.orderBy) + " without a group";
+                return false;
+            }
+            return true;
+        }
+        for (const QueryItem& item : query.items) {
+            if (item.function != QueryFunction::None) continue;
+            if (item.field != QueryField::Category || !query.groupByCategory) {
+                error = queryItemName(item) + " must be inside a function"
+                    + (item.field == QueryField::Category ? " or grouped by" : "");
+                return false;
+            }
+        }
+        if (query.ordered && query.orderBy.function == QueryFunction::None
+            && (query.orderBy.field != QueryField::Category || !query.groupByCategory)) {
+            error = "can't order groups by " + queryItemName(query.orderBy);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    explicit QueryParser(string& error) : error(error) {}
+
+    bool parse(string_view text, Query& query) {
+        query = Query();
+        if (!tokenize(text)) return false;
+        if (accept("select") && !parseSelect(query)) return false;
+        if (accept("where")) {
+            do {
+                QueryCondition condition;
+                if (!parseCondition(condition)) return false;
+                query.conditions.push_back(condition);
+            } while (accept("and"));
+        }
+        if (accept("group")) {
+            if (!expect("by") || !expect("category")) return false;
+            query.groupByCategory = true;
+        }
+        if (accept("order")) {
+            if (!expect("by") || !parseItem(query.orderBy)) return false;
+            query.ordered = true;
+            if (accept("desc")) query.descending = true;
+            else accept("asc");
+        }
+        if (accept("limit")) {
+            int limit;
+            if (atEnd() || !parseIntField(tokens[next].data(), tokens[next].data() + tokens[next].size(), limit)
+                || limit < 0) {
+                error = "expected a row count after limit";
+                return false;
+            }
+            next++;
+            query.limit = size_t(limit);
+        }
+        if (!atEnd()) {
+            error = "unexpected " + tokens[next];
+            return false;
+        }
+        return validate(query);
+    }
+};
+
+inline bool parseQuery(string_view text, Query& query, string& error) {
+    QueryParser parser(error);
+    return parser.parse(text, query);
+}
+
+struct QueryStats {
+    double sum = 0;
+    double min = numeric_limits<double>::infinity();
+    double max = -numeric_limits<double>::infinity();
+};
+
+struct QueryGroup {
+    // Category code; freeCode for the single group of an ungrouped query.
+    uint32_t code = ProductColumns::freeCode;
+    size_t count = 0;
+    // One per QueryResult::fields.
+    vector<QueryStats> stats;
+};
+
+struct QueryResult {
+    size_t matched = 0;
+    // The fields the functions need, in QueryGroup::stats order.
+    vector<QueryField> fields;
+    // Aggregating queries: the groups with a match, by code (an ungrouped
+    // query always has its one group).
+    vector<QueryGroup> groups;
+    // Listing queries: every matching slot, in slot order.
+    vector<uint32_t> slots;
+
+    // item's value for group; NaN where it has none (an empty group's
+    // average, minimum or maximum).
+    double value(const QueryGroup& group, const QueryItem& item) const {
+        if (item.function == QueryFunction::Count) return double(group.count);
+        size_t f = size_t(find(fields.begin(), fields.end(), item.field) - fields.begin());
+        const QueryStats& stats = group.stats[f];
+        if (item.function == QueryFunction::Sum) return stats.sum;
+        if (group.count == 0) return numeric_limits<double>::quiet_NaN();
+        if (item.function == QueryFunction::Avg) return stats.sum / double(group.count);
+        return item.function == QueryFunction::Min ? stats.min : stats.max;
+    }
+};
+
+// Runs a Query's filters and functions over ProductColumns. The rows are
+// split into one range per thread, and each range is scanned a block at a
+// time: every condition is one tight loop over a column that narrows a
+// mask for the block, which the compiler turns into vector compares, and
+// only rows still in the mask are aggregated or collected. Each thread
+// aggregates into its own per-category arrays; they are added up at the
+// end. Ordering, limits and names are the caller's.
+class QueryEngine {
+private:
+    static constexpr size_t blockRows = 4096;
+    static constexpr size_t minThreadRows = size_t(1) << 16;
+
+    struct Partial {
+        size_t matched = 0;
+        vector<size_t> counts;
+        // counts.size() x fields.size(), by group then field.
+        vector<QueryStats> stats;
+        vector<uint32_t> slots;
+    };
+
+    // Runs body(i) over a block's n rows. A full block's count is a
+    // constant, which GCC needs at -O2 to vectorize the loop.
+    template <typename Body>
+    static void each(size_t n, Body body) {
+        if (n == blockRows) {
+            for (size_t i = 0; i < blockRows; i++) body(i);
+        } else {
+            for (size_t i = 0; i < n; i++) body(i);
+        }
+    }
+
+    // keep is 1 for a row still matching and 0 for one that is not, as a
+    // double: compares of doubles only vectorize into masks of their width.
+    template <typename Get>
+    static void narrow(double* keep, size_t n, QueryOp op, double bound, Get get) {
+        switch (op) {
+            case QueryOp::Eq: each(n, [&](size_t i) { keep[i] = get(i) == bound ? keep[i] : 0.0; }); break;
+            case QueryOp::Ne: each(n, [&](size_t i) { keep[i] = get(i) != bound ? keep[i] : 0.0; }); break;
+            case QueryOp::Lt: each(n, [&](size_t i) { keep[i] = get(i) < bound ? keep[i] : 0.0; }); break;
+            case QueryOp::Le: each(n, [&](size_t i) { keep[i] = get(i) <= bound ? keep[i] : 0.0; }); break;
+            case QueryOp::Gt: each(n, [&](size_t i) { keep[i] = get(i) > bound ? keep[i] : 0.0; }); break;
+            case QueryOp::Ge: each(n, [&](size_t i) { keep[i] = get(i) >= bound ? keep[i] : 0.0; }); break;
+        }
+    }
+
+    // Calls with(get) for a getter of field over the rows from begin.
+    template <typename With>
+    static void column(const ProductColumns& columns, QueryField field, size_t begin, With with) {
+        const double* price = columns.priceColumn() + begin;
+        const int32_t* quantity = columns.quantityColumn() + begin;
+        const double* margin = columns.marginColumn() + begin;
+        switch (field) {
+            case QueryField::Price: with([price](size_t i) { return price[i]; }); break;
+            case QueryField::Quantity: with([quantity](size_t i) { return double(quantity[i]); }); break;
+            case QueryField::Margin: with([margin](size_t i) { return margin[i]; }); break;
+            case QueryField::Value: with([price, quantity](size_t i) { return price[i] * quantity[i]; }); break;
+            default:
+                with([price, quantity, margin](size_t i) { return price[i] * quantity[i] * (margin[i] / 100); });
+                break;
+        }
+    }
+
+    static void scan(const Query& query, const ProductColumns& columns, const vector<QueryField>& fields,
+                     size_t groupCount, size_t begin, size_t end, Partial& part) {
+        bool aggregates = query.aggregates();
+        size_t fieldCount = fields.size();
+        if (aggregates) {
+            part.counts.assign(groupCount, 0);
+            part.stats.assign(groupCount * fieldCount, QueryStats());
+        }
+        double keep[blockRows];
+        double values[blockRows];
+        for (size_t block = begin; block < end; block += blockRows) {
+            size_t n = min(blockRows, end - block);
+            const uint32_t* code = columns.codeColumn() + block;
+            each(n, [&](size_t i) { keep[i] = code[i] != ProductColumns::freeCode ? 1.0 : 0.0; });
+            for (const QueryCondition& condition : query.conditions) {
+                if (condition.field == QueryField::Category) {
+                    uint32_t match = condition.code;
+                    bool equal = condition.op == QueryOp::Eq;
+                    each(n, [&](size_t i) { keep[i] = (code[i] == match) == equal ? keep[i] : 0.0; });
+                    continue;
+                }
+                column(columns, condition.field, block,
+                       [&](auto get) { narrow(keep, n, condition.op, condition.number, get); });
+            }
+            if (!aggregates) {
+                for (size_t i = 0; i < n; i++) {
+                    if (!keep[i]) continue;
+                    part.matched++;
+                    part.slots.push_back(uint32_t(block + i));
+                }
+                continue;
+            }
+            for (size_t i = 0; i < n; i++) {
+                if (!keep[i]) continue;
+                part.matched++;
+                part.counts[query.groupByCategory ? code[i] : 0]++;
+            }
+            for (size_t f = 0; f < fieldCount; f++) {
+                column(columns, fields[f], block, [&](auto get) { each(n, [&](size_t i) { values[i] = get(i); }); });
+                if (!query.groupByCategory) {
+                    QueryStats& stats = part.stats[f];
+                    for (size_t i = 0; i < n; i++) {
+                        if (!keep[i]) continue;
+                        stats.sum += values[i];
+                        stats.min = min(stats.min, values[i]);
+                        stats.max = max(stats.max, values[i]);
+                    }
+                    continue;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    if (!keep[i]) continue;
+                    QueryStats& stats = part.stats[size_t(code[i]) * fieldCount + f];
+                    stats.sum += values[i];
+                    stats.min = min(stats.min, values[i]);
+                    stats.max = max(stats.max, values[i]);
+                }
+            }
+        }
+    }
+
+public:
+    // categoryCount bounds the category codes. threads 0 uses one per
+    // hardware thread.
+    static void run(const Query& query, const ProductColumns& columns, size_t categoryCount, QueryResult& result,
+                    unsigned threads = 0) {
+        result = QueryResult();
+        bool aggregates = query.aggregates();
+        if (aggregates) {
+            auto need = [&result](const QueryItem& item) {
+                if (item.function == QueryFunction::None || item.function == QueryFunction::Count) return;
+                if (find(result.fields.begin(), result.fields.end(), item.field) == result.fields.end()) {
+                    result.fields.push_back(item.field);
+                }
+            };
+            for (const QueryItem& item : query.items) need(item);
+            if (query.ordered) need(query.orderBy);
+        }
+        size_t groupCount = query.groupByCategory ? max<size_t>(categoryCount, 1) : 1;
+
+        size_t rows = columns.rowCount();
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        size_t parts = min<size_t>(threads, max<size_t>(1, rows / minThreadRows));
+        vector<Partial> partials(parts);
+        auto range = [rows, parts](size_t p) { return (rows * p / parts) / blockRows * blockRows; };
+        if (parts == 1) {
+            scan(query, columns, result.fields, groupCount, 0, rows, partials[0]);
+        } else {
+            vector<thread> workers;
+            for (size_t p = 0; p < parts; p++) {
+                size_t end = p + 1 == parts ? rows : range(p + 1);
+                workers.emplace_back([&, p, end] {
+                    scan(query, columns, result.fields, groupCount, range(p), end, partials[p]);
+                });
+            }
+            for (thread& worker : workers) worker.join();
+        }
+
+        for (Partial& part : partials) result.matched += part.matched;
+        if (!aggregates) {
+            for (Partial& part : partials) result.slots.insert(result.slots.end(), part.slots.begin(), part.slots.end());
+            return;
+        }
+        size_t fieldCount = result.fields.size();
+        for (size_t g = 0; g < groupCount; g++) {
+            QueryGroup group;
+            group.code = query.groupByCategory ? uint32_t(g) : ProductColumns::freeCode;
+            group.stats.assign(fieldCount, QueryStats());
+            for (const Partial& part : partials) {
+                group.count += part.counts[g];
+                for (size_t f = 0; f < fieldCount; f++) {
+                    const QueryStats& stats = part.stats[g * fieldCount + f];
+                    group.stats[f].sum += stats.sum;
+                    group.stats[f].min = min(group.stats[f].min, stats.min);
+                    group.stats[f].max = max(group.stats[f].max, stats.max);
+                }
+            }
+            if (group.count > 0 || !query.groupByCategory) result.groups.push_back(move(group));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef REORDER_INDEX_H
+#define REORDER_INDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <string_view>
+#include <cstdint>
+#include "product.h"
+#include "order_index.h"
+
+using namespace std;
+
+// What an update did to a product's place in the low-stock set.
+enum class ReorderChange { None, Low, Restocked };
+
+// A product crossed its reorder threshold: fell below it (low), or came
+// back up to it or lost it (threshold is then noThreshold). name is only
+// valid during the call.
+struct ReorderAlert {
+    int id;
+    string_view name;
+    int quantity;
+    int threshold;
+    bool low;
+};
+
+using ReorderListener = function<void(const ReorderAlert&)>;
+
+// Reorder thresholds, per product or per category (a product's own wins),
+// and the products whose quantity is below theirs. Inventory passes every
+// product change through here, so the low set is always current: listing
+// it is O(k), largest shortfall first, and a product crossing its
+// threshold is known as the change happens rather than found by a scan.
+//
+// Updates are random accesses into a large inventory, where a hash lookup
+// that misses the cache costs as much as the update itself. A quantity
+// change that stays on one side of the threshold touches neither the low
+// set nor, for most products, the per-product map.
+class ReorderIndex {
+private:
+    static constexpr size_t filterBits = size_t(1) << 16;
+
+    // By category dictionary code; noThreshold where unset.
+    vector<int> categoryThresholds;
+    unordered_map<int, int> productThresholds;
+    // Bit (id mod filterBits) is set for every id ever given a threshold of
+    // its own, so other ids skip the lookup. Bits are never cleared; a
+    // stale one costs a lookup. 8 KB, small enough to stay cached.
+    vector<uint64_t> filter = vector<uint64_t>(filterBits / 64);
+    // Low products by id, with the shortfall they are filed under below.
+    unordered_map<int, long long> shortfalls;
+    OrderedIndex byShortfall;
+
+    static size_t filterBit(int id) { return size_t(uint32_t(id)) % filterBits; }
+
+public:
+    static constexpr int noThreshold = -1;
+
+    int categoryThreshold(uint32_t code) const {
+        return code < categoryThresholds.size() ? categoryThresholds[code] : noThreshold;
+    }
+
+    int threshold(const Product& product) const {
+        size_t bit = filterBit(product.getId());
+        if (filter[bit / 64] >> (bit % 64) & 1) {
+            auto it = productThresholds.find(product.getId());
+            if (it != productThresholds.end()) return it->second;
+        }
+        return categoryThreshold(product.getCategoryCode());
+    }
+
+    // A negative threshold clears it. The caller then update()s the
+    // products it applies to.
+    void setProductThreshold(int id, int threshold) {
+        if (threshold < 0) {
+            productThresholds.erase(id);
+            return;
+        }
+        productThresholds[id] = threshold;
+        filter[filterBit(id) / 64] |= uint64_t(1) << (filterBit(id) % 64);
+    }
+
+    void setCategoryThreshold(uint32_t code, int threshold) {
+        if (code >= categoryThresholds.size()) categoryThresholds.resize(code + 1, noThreshold);
+        categoryThresholds[code] = threshold < 0 ? noThreshold : threshold;
+    }
+
+    // Files product under its current quantity and threshold.
+    ReorderChange update(const Product& product) {
+        int limit = threshold(product);
+        long long shortfall = (long long)limit - product.getQuantity();
+        bool low = limit != noThreshold && shortfall > 0;
+        auto it = shortfalls.empty() ? shortfalls.end() : shortfalls.find(product.getId());
+        if (it == shortfalls.end()) {
+            if (!low) return ReorderChange::None;
+            shortfalls.emplace(product.getId(), shortfall);
+            byShortfall.add(double(shortfall), product.getId());
+            return ReorderChange::Low;
+        }
+        if (it->second != shortfall) byShortfall.remove(double(it->second), product.getId());
+        if (!low) {
+            shortfalls.erase(it);
+            return ReorderChange::Restocked;
+        }
+        if (it->second != shortfall) {
+            byShortfall.add(double(shortfall), product.getId());
+            it->second = shortfall;
+        }
+        return ReorderChange::None;
+    }
+
+    // update() for a product whose quantity changed from quantityBefore and
+    // whose threshold did not. The low set holds exactly the products below
+    // their threshold, so if neither quantity is, there is nothing to do.
+    ReorderChange quantityChanged(const Product& product, int quantityBefore) {
+        int limit = threshold(product);
+        if (limit == noThreshold || (quantityBefore >= limit && product.getQuantity() >= limit)) {
+            return ReorderChange::None;
+        }
+        return update(product);
+    }
+
+    // The product is gone: drop it and its own threshold.
+    void remove(int id) {
+        productThresholds.erase(id);
+        auto it = shortfalls.find(id);
+        if (it == shortfalls.end()) return;
+        byShortfall.remove(double(it->second), id);
+        shortfalls.erase(it);
+    }
+
+    // Forgets which products are low, keeping the thresholds, for a rebuild
+    // that update()s every product again.
+    void clearLow() {
+        shortfalls.clear();
+        byShortfall.clear();
+    }
+
+    size_t lowCount() const { return shortfalls.size(); }
+
+    // Visits (id, shortfall) for up to n low products, largest shortfall
+    // first. O(log k + n).
+    template <typename Visitor>
+    void forLow(size_t n, Visitor visit) const {
+        byShortfall.forTop(n, [&visit](double shortfall, int id) { visit(id, (long long)shortfall); });
+    }
+};
+
+#endif
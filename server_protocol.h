@@ -0,0 +1,277 @@
+#ifndef SERVER_PROTOCOL_H
+#define SERVER_PROTOCOL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+// The inventory server's wire format. Both ends are on one machine, so
+// numbers travel in native byte order. Every message is a frame:
+//
+//   uint32 length | payload (length bytes)
+//
+// Request payloads:
+//   Add, Update:  op | i32 id | f64 price | i32 quantity | f64 margin
+//                    | u16 nameLength | name | u16 categoryLength | category
+//   Find, Remove: op | i32 id
+//   Adjust:       op | i32 id | i32 delta
+//   Totals:       op
+//
+// A client may send any number of requests without waiting. Each gets
+// exactly one response, in the order the requests were sent:
+//   status [| the product, encoded as for Add, after a Find that found it]
+//          [| u64 count | f64 revenue | f64 profit, after Totals]
+
+enum class RequestOp : uint8_t { Add = 1, Find = 2, Update = 3, Remove = 4, Adjust = 5, Totals = 6 };
+
+// Failed: the inventory refused (an id that exists for Add, or is missing
+// otherwise). BadRequest: the payload did not parse; the connection goes on.
+enum class ResponseStatus : uint8_t { Ok = 0, Failed = 1, BadRequest = 2 };
+
+// Larger frames close the connection. An Add with the longest name and
+// category fits.
+constexpr size_t maxFrameBytes = size_t(1) << 18;
+
+struct ServerRequest {
+    RequestOp op = RequestOp::Find;
+    int id = 0;
+    // Adjust only.
+    int delta = 0;
+    // Add and Update only; name and category view the frame.
+    double price = 0;
+    int quantity = 0;
+    double margin = 0;
+    string_view name;
+    string_view category;
+};
+
+struct ServerResponse {
+    ResponseStatus status = ResponseStatus::Ok;
+    // A found product; name and category view the frame.
+    bool hasProduct = false;
+    ServerRequest product;
+    // Totals only.
+    uint64_t count = 0;
+    double revenue = 0;
+    double profit = 0;
+};
+
+// Appends frames to a buffer: begin(), the put calls, then end() fills in
+// the length.
+class FrameWriter {
+private:
+    vector<char>& buffer;
+    size_t start = 0;
+
+public:
+    explicit FrameWriter(vector<char>& buffer) : buffer(buffer) {}
+
+    void begin() {
+        start = buffer.size();
+        buffer.resize(start + 4);
+    }
+
+    void end() {
+        uint32_t length = uint32_t(buffer.size() - start - 4);
+        memcpy(buffer.data() + start, &length, 4);
+    }
+
+    template <typename T>
+    void put(const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    // Truncated to 65535 bytes.
+    void putString(string_view value) {
+        if (value.size() > UINT16_MAX) value = value.substr(0, UINT16_MAX);
+        put(uint16_t(value.size()));
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    void putProduct(int id, double price, int quantity, double margin, string_view name, string_view category) {
+        put(int32_t(id));
+        put(price);
+        put(int32_t(quantity));
+        put(margin);
+        putString(name);
+        putString(category);
+    }
+};
+
+// Reads the fields of one payload; every get fails once it runs short.
+class FrameReader {
+private:
+    const char* p;
+    const char* end;
+
+public:
+    FrameReader(const char* data, size_t size) : p(data), end(data + size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (size_t(end - p) < sizeof(T)) return false;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool getString(string_view& value) {
+        uint16_t length;
+        if (!get(length) || size_t(end - p) < length) return false;
+        value = string_view(p, length);
+        p += length;
+        return true;
+    }
+
+    bool getProduct(ServerRequest& product) {
+        int32_t id, quantity;
+        if (!get(id) || !get(product.price) || !get(quantity) || !get(product.margin)) return false;
+        product.id = id;
+        product.quantity = quantity;
+        return getString(product.name) && getString(product.category);
+    }
+
+    bool done() const { return p == end; }
+};
+
+inline void encodeRequest(vector<char>& buffer, const ServerRequest& request) {
+    FrameWriter frame(buffer);
+    frame.begin();
+    frame.put(uint8_t(request.op));
+    switch (request.op) {
+        case RequestOp::Add:
+        case RequestOp::Update:
+            frame.putProduct(request.id, request.price, request.quantity, request.margin, request.name,
+                             request.category);
+            break;
+        case RequestOp::Adjust:
+            frame.put(int32_t(request.id));
+            frame.put(int32_t(request.delta));
+            break;
+        case RequestOp::Totals:
+            break;
+        default:
+            frame.put(int32_t(request.id));
+            break;
+    }
+    frame.end();
+}
+
+// Parses one request payload (without its length).
+inline bool decodeRequest(const char* data, size_t size, ServerRequest& request) {
+    FrameReader reader(data, size);
+    uint8_t op;
+    if (!reader.get(op)) return false;
+    request.op = RequestOp(op);
+    int32_t id = 0, delta = 0;
+    switch (request.op) {
+        case RequestOp::Add:
+        case RequestOp::Update:
+            if (!reader.getProduct(request)) return false;
+            break;
+        case RequestOp::Find:
+        case RequestOp::Remove:
+            if (!reader.get(id)) return false;
+            request.id = id;
+            break;
+        case RequestOp::Adjust:
+            if (!reader.get(id) || !reader.get(delta)) return false;
+            request.id = id;
+            request.delta = delta;
+            break;
+        case RequestOp::Totals:
+            break;
+        default:
+            return false;
+    }
+    return reader.done();
+}
+
+// Parses one response payload to request op.
+inline bool decodeResponse(const char* data, size_t size, RequestOp op, ServerResponse& response) {
+    FrameReader reader(data, size);
+    uint8_t status;
+    if (!reader.get(status)) return false;
+    response.status = ResponseStatus(status);
+    response.hasProduct = false;
+    if (response.status == ResponseStatus::Ok && op == RequestOp::Find) {
+        if (!reader.getProduct(response.product)) return false;
+        response.hasProduct = true;
+    } else if (response.status == ResponseStatus::Ok && op == RequestOp::Totals) {
+        if (!reader.get(response.count) || !reader.get(response.revenue) || !reader.get(response.profit)) {
+            return false;
+        }
+    }
+    return reader.done();
+}
+
+// A server address: a port number alone means that TCP port on 127.0.0.1,
+// anything else is the path of a Unix socket.
+struct ServerAddress {
+    sockaddr_storage storage;
+    socklen_t length = 0;
+    // A Unix socket at path; otherwise TCP.
+    bool local = false;
+    string path;
+
+    const sockaddr* get() const { return reinterpret_cast<const sockaddr*>(&storage); }
+    int family() const { return local ? AF_UNIX : AF_INET; }
+};
+
+inline bool parseServerAddress(const string& text, ServerAddress& address, string& error) {
+    memset(&address.storage, 0, sizeof(address.storage));
+    bool port = !text.empty() && text.find_first_not_of("0123456789") == string::npos;
+    if (port) {
+        unsigned long number = strtoul(text.c_str(), nullptr, 10);
+        if (number == 0 || number > 65535) {
+            error = "port " + text + " is out of range";
+            return false;
+        }
+        sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&address.storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(uint16_t(number));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.length = sizeof(sockaddr_in);
+        address.local = false;
+        return true;
+    }
+    sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&address.storage);
+    if (text.empty() || text.size() >= sizeof(un->sun_path)) {
+        error = "socket path must be 1 to " + to_string(sizeof(un->sun_path) - 1) + " bytes";
+        return false;
+    }
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, text.data(), text.size());
+    address.length = socklen_t(offsetof(sockaddr_un, sun_path) + text.size() + 1);
+    address.local = true;
+    address.path = text;
+    return true;
+}
+
+// Thousands of connections need more descriptors than the usual soft limit
+// of 1024: raises it to the hard limit and returns what it is now.
+inline size_t raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return 1024;
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return limit.rlim_cur == RLIM_INFINITY ? SIZE_MAX : size_t(limit.rlim_cur);
+}
+
+#endif
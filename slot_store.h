@@ -0,0 +1,175 @@
+#ifndef SLOT_STORE_H
+#define SLOT_STORE_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "product.h"
+
+using namespace std;
+
+// ProductIndex's slot array, kept as copy-on-write pages under a persistent
+// radix tree so a read-only view of every slot can be taken in O(1).
+//
+// Every page and tree node records the version it was created in. A node
+// of the current version is private to the writer and is changed in place;
+// an older one may be shared with a view, so writing to it copies it and
+// its path from the root first. Taking a view hands out the root and bumps
+// the version, which freezes everything reachable from that root. Views
+// hold shared_ptrs, so pages nobody can see any more are freed as soon as
+// the last view of them goes away.
+//
+// The writer reads through a flat table of current pages, so reads cost
+// the same as an ordinary chunked array; only the first write to a page
+// after a view has been taken pays for a copy (4 KiB plus one tree path).
+class SlotStore {
+public:
+    static constexpr size_t pageShift = 6;
+    static constexpr size_t pageSize = size_t(1) << pageShift;
+
+private:
+    static constexpr size_t fanShift = 6;
+    static constexpr size_t fanout = size_t(1) << fanShift;
+
+    struct Page {
+        uint64_t version = 0;
+        // Bit i set: products[i] holds a product.
+        uint64_t occupied = 0;
+        Product products[pageSize];
+    };
+
+    // children are Nodes, or Pages on the lowest level.
+    struct Node {
+        uint64_t version = 0;
+        shared_ptr<void> children[fanout];
+    };
+
+    shared_ptr<Node> root;
+    // Node levels above the pages; the tree holds fanout^depth pages.
+    size_t depth = 0;
+    vector<Page*> pages;
+    uint64_t version = 1;
+
+    Node* ownNode(shared_ptr<void>& slot) {
+        Node* node = static_cast<Node*>(slot.get());
+        if (!node || node->version != version) {
+            shared_ptr<Node> copy = node ? make_shared<Node>(*node) : make_shared<Node>();
+            copy->version = version;
+            node = copy.get();
+            slot = move(copy);
+        }
+        return node;
+    }
+
+    // Points the tree at page for index, copying shared nodes on the way.
+    void link(size_t index, shared_ptr<Page> page) {
+        shared_ptr<void> top = move(root);
+        Node* node = ownNode(top);
+        root = static_pointer_cast<Node>(top);
+        for (size_t level = depth - 1; level > 0; level--) {
+            node = ownNode(node->children[(index >> (fanShift * level)) & (fanout - 1)]);
+        }
+        node->children[index & (fanout - 1)] = move(page);
+    }
+
+    Page& ownPage(size_t index) {
+        Page* page = pages[index];
+        if (page->version != version) {
+            shared_ptr<Page> copy = make_shared<Page>(*page);
+            copy->version = version;
+            page = copy.get();
+            pages[index] = page;
+            link(index, move(copy));
+        }
+        return *page;
+    }
+
+public:
+    // A frozen copy of every slot; safe to read from any thread while the
+    // store keeps changing.
+    class View {
+    private:
+        shared_ptr<const Node> root;
+        size_t depth = 0;
+
+        template <typename Visitor>
+        static void walk(const Node* node, size_t level, Visitor& visit) {
+            for (const shared_ptr<void>& child : node->children) {
+                if (!child) continue;
+                if (level > 1) {
+                    walk(static_cast<const Node*>(child.get()), level - 1, visit);
+                    continue;
+                }
+                const Page* page = static_cast<const Page*>(child.get());
+                for (uint64_t bits = page->occupied; bits; bits &= bits - 1) {
+                    visit(page->products[__builtin_ctzll(bits)]);
+                }
+            }
+        }
+
+    public:
+        View() {}
+        View(shared_ptr<const Node> root, size_t depth) : root(move(root)), depth(depth) {}
+
+        // Visits the products in slot order.
+        template <typename Visitor>
+        void forEach(Visitor visit) const {
+            if (root) walk(root.get(), depth, visit);
+        }
+    };
+
+    SlotStore() {}
+    SlotStore(const SlotStore&) = delete;
+    SlotStore& operator=(const SlotStore&) = delete;
+
+    size_t pageCount() const { return pages.size(); }
+    // Pages plus the tree above them (about one node per fanout pages).
+    size_t memoryBytes() const { return pages.size() * sizeof(Page) + (pages.size() / (fanout - 1) + depth) * sizeof(Node); }
+
+    const Product& at(uint32_t slot) const { return pages[slot >> pageShift]->products[slot & (pageSize - 1)]; }
+
+    // Adds a page of free slots at the end.
+    void grow() {
+        if (!root || pages.size() == size_t(1) << (fanShift * depth)) {
+            shared_ptr<Node> top = make_shared<Node>();
+            top->version = version;
+            top->children[0] = move(root);
+            root = move(top);
+            depth++;
+        }
+        shared_ptr<Page> page = make_shared<Page>();
+        page->version = version;
+        pages.push_back(page.get());
+        link(pages.size() - 1, move(page));
+    }
+
+    void put(uint32_t slot, const Product& product) {
+        Page& page = ownPage(slot >> pageShift);
+        page.products[slot & (pageSize - 1)] = product;
+        page.occupied |= uint64_t(1) << (slot & (pageSize - 1));
+    }
+
+    void release(uint32_t slot) {
+        Page& page = ownPage(slot >> pageShift);
+        page.products[slot & (pageSize - 1)] = Product();
+        page.occupied &= ~(uint64_t(1) << (slot & (pageSize - 1)));
+    }
+
+    // The slot's product, made safe to change in place.
+    Product& modify(uint32_t slot) { return ownPage(slot >> pageShift).products[slot & (pageSize - 1)]; }
+
+    // O(1): later writes copy whatever they touch instead.
+    View view() {
+        View frozen(root, depth);
+        version++;
+        return frozen;
+    }
+
+    void clear() {
+        root.reset();
+        depth = 0;
+        pages.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "product.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Binary, columnar inventory snapshot. Layout (all offsets from file start,
+// every section 8-byte aligned):
+//
+//   SnapshotHeader
+//   SnapshotBlock[blockCount]      first id + byte offset of each id block
+//   double price[count]
+//   int32  quantity[count]
+//   double margin[count]
+//   uint64 stringOffsets[2 * count + 1]   name i starts at [2i], category at [2i + 1]
+//   ids: per block, varint (LEB128) deltas from the block's first id
+//   heap: name and category bytes, back to back
+//
+// Rows are in ascending id order, so a lookup is a binary search over the
+// block index followed by decoding at most snapshotBlockSize varints.
+
+static constexpr char snapshotMagic[8] = {'E', 'K', 'S', 'N', 'A', 'P', '\0', '\0'};
+static constexpr uint32_t snapshotVersion = 1;
+static constexpr uint32_t snapshotBlockSize = 128;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t count;
+    double totalRevenue;
+    double totalProfit;
+    uint64_t blockCount;
+    uint64_t blocksOffset;
+    uint64_t priceOffset;
+    uint64_t quantityOffset;
+    uint64_t marginOffset;
+    uint64_t stringOffsetsOffset;
+    uint64_t idsOffset;
+    uint64_t heapOffset;
+    uint64_t fileSize;
+};
+
+struct SnapshotBlock {
+    int32_t firstId;
+    uint32_t reserved;
+    uint64_t idsOffset;
+};
+
+inline void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+inline const uint8_t* getVarint(const uint8_t* p, uint64_t& value) {
+    value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return p;
+    }
+}
+
+// fsyncs path: a file, or a directory to make a rename in it durable.
+inline bool syncPath(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+inline string directoryOf(const string& path) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Writes rows (ascending ids) to filename via a temp file and rename, so a
+// crash mid-write never leaves a truncated snapshot behind. The file and
+// then the rename are synced before returning, so a caller may drop
+// whatever the snapshot replaces (the log, on compaction).
+inline bool writeSnapshot(const string& filename, const vector<const Product*>& rows,
+                          double totalRevenue, double totalProfit) {
+    uint64_t count = rows.size();
+    vector<SnapshotBlock> blocks;
+    vector<uint8_t> ids;
+    for (uint64_t i = 0; i < count; i++) {
+        int id = rows[i]->getId();
+        if (i % snapshotBlockSize == 0) {
+            blocks.push_back({id, 0, ids.size()});
+        } else {
+            putVarint(ids, uint64_t(int64_t(id) - rows[i - 1]->getId()));
+        }
+    }
+
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.blockSize = snapshotBlockSize;
+    header.count = count;
+    header.totalRevenue = totalRevenue;
+    header.totalProfit = totalProfit;
+    header.blockCount = blocks.size();
+    header.blocksOffset = align(sizeof(SnapshotHeader));
+    header.priceOffset = align(header.blocksOffset + blocks.size() * sizeof(SnapshotBlock));
+    header.quantityOffset = align(header.priceOffset + count * sizeof(double));
+    header.marginOffset = align(header.quantityOffset + count * sizeof(int32_t));
+    header.stringOffsetsOffset = align(header.marginOffset + count * sizeof(double));
+    header.idsOffset = align(header.stringOffsetsOffset + (2 * count + 1) * sizeof(uint64_t));
+    header.heapOffset = align(header.idsOffset + ids.size());
+
+    string temp = filename + ".tmp";
+    ofstream file(temp, ios::binary | ios::trunc);
+    if (!file.is_open()) return false;
+    uint64_t written = 0;
+    auto pad = [&](uint64_t offset) {
+        static const char zeros[8] = {0};
+        file.write(zeros, streamsize(offset - written));
+        written = offset;
+    };
+    auto put = [&](const void* data, uint64_t size) {
+        file.write(static_cast<const char*>(data), streamsize(size));
+        written += size;
+    };
+    // Columns are staged through a small buffer rather than written per field.
+    auto putColumn = [&](uint64_t offset, auto value) {
+        using T = decltype(value(*rows[0]));
+        pad(offset);
+        vector<T> buffer;
+        buffer.reserve(4096);
+        for (const Product* row : rows) {
+            buffer.push_back(value(*row));
+            if (buffer.size() == 4096) {
+                put(buffer.data(), buffer.size() * sizeof(T));
+                buffer.clear();
+            }
+        }
+        put(buffer.data(), buffer.size() * sizeof(T));
+    };
+
+    put(&header, sizeof(header));
+    pad(header.blocksOffset);
+    put(blocks.data(), blocks.size() * sizeof(SnapshotBlock));
+    if (count > 0) {
+        putColumn(header.priceOffset, [](const Product& p) { return p.getPrice(); });
+        putColumn(header.quantityOffset, [](const Product& p) { return int32_t(p.getQuantity()); });
+        putColumn(header.marginOffset, [](const Product& p) { return p.getMargin(); });
+    }
+
+    pad(header.stringOffsetsOffset);
+    vector<uint64_t> offsets;
+    offsets.reserve(4096);
+    uint64_t heapSize = 0;
+    for (const Product* row : rows) {
+        offsets.push_back(heapSize);
+        heapSize += row->getName().size();
+        offsets.push_back(heapSize);
+        heapSize += row->getCategory().size();
+        if (offsets.size() >= 4096) {
+            put(offsets.data(), offsets.size() * sizeof(uint64_t));
+            offsets.clear();
+        }
+    }
+    offsets.push_back(heapSize);
+    put(offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    pad(header.idsOffset);
+    put(ids.data(), ids.size());
+
+    pad(header.heapOffset);
+    for (const Product* row : rows) {
+        string_view name = row->getName();
+        string_view category = row->getCategory();
+        put(name.data(), name.size());
+        put(category.data(), category.size());
+    }
+
+    header.fileSize = written;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    if (!file || !syncPath(temp)) {
+        remove(temp.c_str());
+        return false;
+    }
+    return rename(temp.c_str(), filename.c_str()) == 0 && syncPath(directoryOf(filename));
+}
+
+// Serves reads straight from a mapped snapshot. Opening only validates the
+// header, so it costs the same for ten products or ten million; the column
+// pages a lookup touches are faulted in on demand.
+class SnapshotReader {
+private:
+    MappedFile file;
+    SnapshotHeader header;
+    const SnapshotBlock* blocks = nullptr;
+    const double* prices = nullptr;
+    const int32_t* quantities = nullptr;
+    const double* margins = nullptr;
+    const uint64_t* stringOffsets = nullptr;
+    const uint8_t* ids = nullptr;
+    const char* heap = nullptr;
+
+    bool sectionFits(uint64_t offset, uint64_t bytes) const {
+        return offset <= header.fileSize && bytes <= header.fileSize - offset;
+    }
+
+public:
+    bool open(const string& filename) {
+        if (!file.open(filename)) return false;
+        if (file.size() < sizeof(SnapshotHeader)) return false;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0) return false;
+        if (header.version != snapshotVersion || header.blockSize != snapshotBlockSize) return false;
+        if (header.fileSize != file.size()) return false;
+        uint64_t n = header.count;
+        if (header.blockCount != (n + snapshotBlockSize - 1) / snapshotBlockSize) return false;
+        if (!sectionFits(header.blocksOffset, header.blockCount * sizeof(SnapshotBlock))
+            || !sectionFits(header.priceOffset, n * sizeof(double))
+            || !sectionFits(header.quantityOffset, n * sizeof(int32_t))
+            || !sectionFits(header.marginOffset, n * sizeof(double))
+            || !sectionFits(header.stringOffsetsOffset, (2 * n + 1) * sizeof(uint64_t))
+            || !sectionFits(header.idsOffset, header.heapOffset - header.idsOffset)) {
+            return false;
+        }
+
+        const char* base = file.data();
+        blocks = reinterpret_cast<const SnapshotBlock*>(base + header.blocksOffset);
+        prices = reinterpret_cast<const double*>(base + header.priceOffset);
+        quantities = reinterpret_cast<const int32_t*>(base + header.quantityOffset);
+        margins = reinterpret_cast<const double*>(base + header.marginOffset);
+        stringOffsets = reinterpret_cast<const uint64_t*>(base + header.stringOffsetsOffset);
+        ids = reinterpret_cast<const uint8_t*>(base + header.idsOffset);
+        heap = base + header.heapOffset;
+        return sectionFits(header.heapOffset, stringOffsets[2 * n]);
+    }
+
+    size_t size() const { return size_t(header.count); }
+    double totalRevenue() const { return header.totalRevenue; }
+    double totalProfit() const { return header.totalProfit; }
+
+    // Row of id, or -1. O(log(n / blockSize) + blockSize).
+    long long findRow(int id) const {
+        if (header.count == 0) return -1;
+        const SnapshotBlock* end = blocks + header.blockCount;
+        const SnapshotBlock* block = upper_bound(blocks, end, id,
+            [](int value, const SnapshotBlock& b) { return value < b.firstId; });
+        if (block == blocks) return -1;
+        block--;
+        uint64_t row = uint64_t(block - blocks) * snapshotBlockSize;
+        uint64_t rowEnd = min<uint64_t>(row + snapshotBlockSize, header.count);
+        int64_t current = block->firstId;
+        const uint8_t* p = ids + block->idsOffset;
+        while (current < id && ++row < rowEnd) {
+            uint64_t delta;
+            p = getVarint(p, delta);
+            current += int64_t(delta);
+        }
+        return current == id && row < rowEnd ? (long long)row : -1;
+    }
+
+    // The product's name and category view the mapping.
+    Product product(int id, size_t row) const {
+        const char* name = heap + stringOffsets[2 * row];
+        const char* category = heap + stringOffsets[2 * row + 1];
+        const char* categoryEnd = heap + stringOffsets[2 * row + 2];
+        return Product(id, string_view(name, size_t(category - name)),
+                       string_view(category, size_t(categoryEnd - category)),
+                       prices[row], quantities[row], margins[row]);
+    }
+
+    // Visits (id, row) for every row in ascending id order.
+    template <typename Visitor>
+    void forEachRow(Visitor visit) const {
+        for (uint64_t b = 0; b < header.blockCount; b++) {
+            uint64_t row = b * snapshotBlockSize;
+            uint64_t rowEnd = min<uint64_t>(row + snapshotBlockSize, header.count);
+            int64_t current = blocks[b].firstId;
+            const uint8_t* p = ids + blocks[b].idsOffset;
+            visit(int(current), size_t(row));
+            while (++row < rowEnd) {
+                uint64_t delta;
+                p = getVarint(p, delta);
+                current += int64_t(delta);
+                visit(int(current), size_t(row));
+            }
+        }
+    }
+};
+
+#endif
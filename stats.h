@@ -0,0 +1,272 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// Process-wide operation statistics: per-operation call and miss counts
+// with latency histograms, plus a few event counters.
+//
+// Every thread records into its own block with plain (relaxed, single
+// writer) stores, so recording costs a handful of uncontended writes;
+// nothing is shared until someone reads. A reader sums every live thread's
+// block plus whatever exited threads left behind.
+//
+// Reading the clock is the expensive part (two reads cost more than a
+// find), so the single-product operations time one call in 16 and only
+// count the rest; everything else is timed on every call.
+
+enum class StatOp {
+    Add, Remove, Update, Find, Read, AdjustQuantity, SetPrice, SetMargin, ApplyMovements,
+    Print, Export, Save, Autosave, Load, Merge, Diff, SaveSnapshot, LoadSnapshot, OpenLog, CommitLog, CompactLog, View,
+    Reconcile, CategoryReport, CategoryList, NameSearch, PriceRange, TopByValue, Percentiles, LowStock, Query, History,
+    MemoryUsage,
+    Count
+};
+
+// Calls are timed when (call number & mask) == 0.
+inline uint64_t statSampleMask(StatOp op) {
+    return op <= StatOp::SetMargin ? 15 : 0;
+}
+
+inline const char* statOpName(StatOp op) {
+    static const char* const names[] = {
+        "add", "remove", "update", "find", "read", "adjust_quantity", "set_price", "set_margin", "apply_movements",
+        "print", "export", "save", "autosave", "load", "merge", "diff", "save_snapshot", "load_snapshot", "open_log",
+        "commit_log", "compact_log", "view", "reconcile", "category_report", "category_list", "name_search", "price_range",
+        "top_by_value", "percentiles", "low_stock", "query", "history", "memory_usage"};
+    return names[size_t(op)];
+}
+
+enum class StatCounter {
+    LoadRejects,         // CSV lines that could not be parsed
+    BytesRead,           // CSV and snapshot files loaded
+    BytesWritten,        // CSV, export and snapshot files written
+    MovementsApplied,
+    MovementsSkipped,    // stock movements for unknown ids or out-of-range quantities
+    LogRecordsReplayed,
+    ReorderAlerts,       // products crossing their reorder threshold
+    Count
+};
+
+inline const char* statCounterName(StatCounter counter) {
+    static const char* const names[] = {"load_rejects", "bytes_read", "bytes_written", "movements_applied",
+                                        "movements_skipped", "log_records_replayed", "reorder_alerts"};
+    return names[size_t(counter)];
+}
+
+// Timestamps for latency measurement: the TSC where there is one (a few ns
+// to read), steady_clock nanoseconds elsewhere.
+inline uint64_t statTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Log-linear buckets in the style of HdrHistogram: values below 16 have a
+// bucket each, and each power-of-two range above is split into 16, so a
+// bucket's lower bound is within 1/16 (6%) of every value in it.
+struct LatencyBuckets {
+    static constexpr int subBits = 4;
+    static constexpr size_t sub = size_t(1) << subBits;
+    // Up to 2^48 ticks (a day or so); larger values share the top bucket.
+    static constexpr int maxBits = 48;
+    static constexpr size_t count = size_t(maxBits - subBits + 1) * sub;
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < sub) return size_t(value);
+        int shift = 63 - __builtin_clzll(value) - subBits;
+        size_t bucket = size_t(shift + 1) * sub + ((value >> shift) & (sub - 1));
+        return bucket < count ? bucket : count - 1;
+    }
+
+    static uint64_t lowerBound(size_t bucket) {
+        if (bucket < sub) return bucket;
+        return (sub + bucket % sub) << (bucket / sub - 1);
+    }
+};
+
+// Summed statistics, as read. Latencies are in ticks; ticksPerNs converts.
+// ticks, maxTicks and the buckets cover the timed calls only.
+struct StatsSnapshot {
+    struct Op {
+        uint64_t calls = 0;
+        uint64_t misses = 0;
+        uint64_t timed = 0;
+        uint64_t ticks = 0;
+        uint64_t maxTicks = 0;
+        vector<uint64_t> buckets = vector<uint64_t>(LatencyBuckets::count);
+
+        double meanTicks() const { return timed ? double(ticks) / double(timed) : 0; }
+
+        // Ticks at fraction p (0..1) of the timed calls, to bucket precision.
+        uint64_t percentile(double p) const {
+            if (timed == 0) return 0;
+            uint64_t rank = uint64_t(p * double(timed - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t b = 0; b < buckets.size(); b++) {
+                seen += buckets[b];
+                if (seen >= rank) return min(LatencyBuckets::lowerBound(b), maxTicks);
+            }
+            return maxTicks;
+        }
+    };
+
+    Op ops[size_t(StatOp::Count)];
+    uint64_t counters[size_t(StatCounter::Count)] = {};
+    double ticksPerNs = 1;
+    double uptimeSeconds = 0;
+
+    double nanos(double ticks) const { return ticks / ticksPerNs; }
+};
+
+class Stats {
+private:
+    struct OpBlock {
+        atomic<uint64_t> calls{0};
+        atomic<uint64_t> misses{0};
+        atomic<uint64_t> timed{0};
+        atomic<uint64_t> ticks{0};
+        atomic<uint64_t> maxTicks{0};
+        atomic<uint64_t> buckets[LatencyBuckets::count] = {};
+    };
+
+    struct ThreadBlock {
+        OpBlock ops[size_t(StatOp::Count)];
+        atomic<uint64_t> counters[size_t(StatCounter::Count)] = {};
+    };
+
+    // Only the owning thread writes, so a relaxed load + store is enough
+    // and is as cheap as a plain increment.
+    static void bump(atomic<uint64_t>& value, uint64_t by) {
+        value.store(value.load(memory_order_relaxed) + by, memory_order_relaxed);
+    }
+
+    static void addInto(StatsSnapshot& into, const ThreadBlock& block) {
+        for (size_t i = 0; i < size_t(StatOp::Count); i++) {
+            const OpBlock& from = block.ops[i];
+            StatsSnapshot::Op& op = into.ops[i];
+            op.calls += from.calls.load(memory_order_relaxed);
+            op.misses += from.misses.load(memory_order_relaxed);
+            op.timed += from.timed.load(memory_order_relaxed);
+            op.ticks += from.ticks.load(memory_order_relaxed);
+            op.maxTicks = max(op.maxTicks, from.maxTicks.load(memory_order_relaxed));
+            if (from.timed.load(memory_order_relaxed) == 0) continue;
+            for (size_t b = 0; b < LatencyBuckets::count; b++) op.buckets[b] += from.buckets[b].load(memory_order_relaxed);
+        }
+        for (size_t i = 0; i < size_t(StatCounter::Count); i++) into.counters[i] += block.counters[i].load(memory_order_relaxed);
+    }
+
+    struct Registry {
+        mutex lock;
+        vector<ThreadBlock*> threads;
+        // What exited threads recorded.
+        StatsSnapshot retired;
+        // For converting ticks to ns: the clocks at startup.
+        uint64_t startTicks = statTicks();
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    };
+
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    // Registers the thread's block on first use; folds it into the retired
+    // totals when the thread exits.
+    struct ThreadHandle {
+        ThreadBlock* block;
+
+        ThreadHandle() : block(new ThreadBlock()) {
+            Registry& r = registry();
+            lock_guard<mutex> guard(r.lock);
+            r.threads.push_back(block);
+        }
+
+        ~ThreadHandle() {
+            Registry& r = registry();
+            lock_guard<mutex> guard(r.lock);
+            addInto(r.retired, *block);
+            r.threads.erase(find(r.threads.begin(), r.threads.end(), block));
+            delete block;
+        }
+    };
+
+    static ThreadBlock& local() {
+        static thread_local ThreadHandle handle;
+        return *handle.block;
+    }
+
+    static void record(OpBlock& block, bool missed) {
+        bump(block.calls, 1);
+        if (missed) bump(block.misses, 1);
+    }
+
+    static void record(OpBlock& block, bool missed, uint64_t ticks) {
+        record(block, missed);
+        bump(block.timed, 1);
+        bump(block.ticks, ticks);
+        if (ticks > block.maxTicks.load(memory_order_relaxed)) block.maxTicks.store(ticks, memory_order_relaxed);
+        bump(block.buckets[LatencyBuckets::bucketOf(ticks)], 1);
+    }
+
+    friend class OpTimer;
+
+public:
+    static void record(StatOp op, bool missed, uint64_t ticks) { record(local().ops[size_t(op)], missed, ticks); }
+
+    static void count(StatCounter counter, uint64_t by = 1) { bump(local().counters[size_t(counter)], by); }
+
+    static StatsSnapshot read() {
+        Registry& r = registry();
+        lock_guard<mutex> guard(r.lock);
+        StatsSnapshot snapshot = r.retired;
+        for (const ThreadBlock* block : r.threads) addInto(snapshot, *block);
+        auto elapsed = chrono::steady_clock::now() - r.startTime;
+        snapshot.uptimeSeconds = chrono::duration<double>(elapsed).count();
+#if defined(__x86_64__) || defined(__i386__)
+        double nanos = double(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+        if (nanos > 0) snapshot.ticksPerNs = double(statTicks() - r.startTicks) / nanos;
+#endif
+        return snapshot;
+    }
+};
+
+// Counts one operation and, when sampled, times it from construction to
+// destruction. Call miss() on the paths where it finds nothing or fails.
+class OpTimer {
+private:
+    Stats::OpBlock& block;
+    bool timed;
+    bool missed = false;
+    uint64_t start;
+
+public:
+    explicit OpTimer(StatOp op)
+        : block(Stats::local().ops[size_t(op)]),
+          timed((block.calls.load(memory_order_relaxed) & statSampleMask(op)) == 0),
+          start(timed ? statTicks() : 0) {}
+    OpTimer(const OpTimer&) = delete;
+    OpTimer& operator=(const OpTimer&) = delete;
+
+    ~OpTimer() {
+        if (timed) Stats::record(block, missed, statTicks() - start);
+        else Stats::record(block, missed);
+    }
+
+    void miss() { missed = true; }
+};
+
+#endif
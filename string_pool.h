@@ -0,0 +1,101 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Bump allocator for string bytes. Strings are appended to large chunks and
+// never move or get freed individually, so a string_view into the arena stays
+// valid for the arena's lifetime. Overwritten strings are only counted as
+// waste; the space comes back when the arena is dropped (on a full reload).
+class StringArena {
+private:
+    size_t chunkBytes;
+    vector<unique_ptr<char[]>> chunks;
+    char* cursor = nullptr;
+    size_t left = 0;
+    size_t reserved = 0;
+    size_t used = 0;
+    size_t wasted = 0;
+
+public:
+    explicit StringArena(size_t chunkBytes = size_t(1) << 20) : chunkBytes(chunkBytes) {}
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    string_view store(string_view value) {
+        if (value.empty()) return string_view();
+        if (value.size() > left) {
+            // Oversized strings get a chunk of their own; the current chunk
+            // stays open for the small ones.
+            size_t size = value.size() > chunkBytes / 4 ? value.size() : chunkBytes;
+            chunks.emplace_back(new char[size]);
+            reserved += size;
+            if (size == chunkBytes) {
+                cursor = chunks.back().get();
+                left = size;
+            } else {
+                memcpy(chunks.back().get(), value.data(), value.size());
+                used += value.size();
+                return string_view(chunks.back().get(), value.size());
+            }
+        }
+        memcpy(cursor, value.data(), value.size());
+        string_view stored(cursor, value.size());
+        cursor += value.size();
+        left -= value.size();
+        used += value.size();
+        return stored;
+    }
+
+    // Records that a stored string is no longer referenced.
+    void release(string_view value) { wasted += value.size(); }
+
+    size_t bytesReserved() const { return reserved; }
+    size_t bytesUsed() const { return used; }
+    size_t bytesWasted() const { return wasted; }
+};
+
+// Interns category names: each distinct name is stored once and gets a small
+// dense code, so products carry a 4-byte code plus a view of the shared copy.
+class CategoryDictionary {
+private:
+    // Category names are few and short.
+    StringArena arena{4096};
+    vector<string_view> names;
+    unordered_map<string_view, uint32_t> codes;
+
+public:
+    uint32_t intern(string_view name) {
+        auto it = codes.find(name);
+        if (it != codes.end()) return it->second;
+        uint32_t code = uint32_t(names.size());
+        string_view stored = arena.store(name);
+        names.push_back(stored);
+        codes.emplace(stored, code);
+        return code;
+    }
+
+    // Code of name, or -1 if it has never been interned.
+    long long find(string_view name) const {
+        auto it = codes.find(name);
+        return it == codes.end() ? -1 : (long long)it->second;
+    }
+
+    string_view name(uint32_t code) const { return names[code]; }
+    size_t size() const { return names.size(); }
+
+    size_t memoryBytes() const {
+        return arena.bytesReserved() + names.capacity() * sizeof(string_view)
+            + codes.size() * (sizeof(string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+    }
+};
+
+#endif
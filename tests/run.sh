@@ -0,0 +1,31 @@
+#!/bin/sh
+# Runs each tests/*.batch through batch mode (--quiet) and compares what it
+# writes to stdout with the .expected file next to it.
+#
+#   tests/run.sh [inventory binary]
+#
+# Without a binary, main_with_TC_logn.cpp is built into a temporary one.
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+bin=$1
+case $bin in
+    "" | /*) ;;
+    *) bin=$PWD/$bin ;;
+esac
+if [ -z "$bin" ]; then
+    bin=$work/inventory
+    g++ -std=c++17 -O2 -pthread "$here/../main_with_TC_logn.cpp" -o "$bin" || exit 1
+fi
+failed=0
+for script in "$here"/*.batch; do
+    name=$(basename "$script" .batch)
+    (cd "$work" && "$bin" --batch="$script" --quiet > "$work/$name.out" 2> /dev/null)
+    if diff -u "$here/$name.expected" "$work/$name.out"; then
+        echo "ok $name"
+    else
+        echo "FAILED $name"
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,276 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "product.h"
+#include "mapped_file.h"
+
+using namespace std;
+
+// Append-only log of Inventory mutations. Each record is
+//
+//   uint32 payloadLength | uint32 crc32(payload) | payload
+//   payload = op | int32 id [| f64 price | i32 quantity | f64 margin
+//                            [| u32 nameLength | name | u32 categoryLength | category]]
+//
+// Remove records stop after the id and Values records (price/quantity/
+// margin changes) after the margin. Every record holds absolute values, so
+// replaying one twice is harmless.
+//
+// Records are staged in memory and written with one write() per group
+// commit; fsync is batched separately, so durability and throughput can be
+// traded off independently.
+
+enum class LogOp : uint8_t { Add = 1, Update = 2, Remove = 3, Values = 4 };
+
+struct LogRecord {
+    LogOp op;
+    // Only the id is meaningful for Remove, and name and category are empty
+    // for Values. Name and category view the mapped log and are only valid
+    // during the replay callback.
+    Product product;
+};
+
+struct LogOptions {
+    // Records buffered before they are written out. 1 writes every record.
+    size_t groupCommit = 64;
+    // fsync after this many group commits (0: leave it to the OS)...
+    size_t syncEveryCommits = 1;
+    // ...or once this long has passed since the last fsync (0: off).
+    long syncIntervalMs = 0;
+    // Fold the log into a snapshot once it grows past this size (0: never).
+    size_t compactBytes = size_t(64) << 20;
+};
+
+// The table is a function-local static, so the first calls may come from
+// several threads at once.
+inline uint32_t crc32(const uint8_t* data, size_t size) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+class WriteAheadLog {
+private:
+    int fd = -1;
+    LogOptions options;
+    vector<uint8_t> buffer;
+    size_t buffered = 0;
+    size_t commitsSinceSync = 0;
+    size_t fileBytes = 0;
+    chrono::steady_clock::time_point lastSync;
+
+    template <typename T>
+    void putRaw(const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putString(string_view value) {
+        putRaw(uint32_t(value.size()));
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    // Stages a record, committing the group once it is full. Returns false
+    // if that commit failed.
+    bool append(LogOp op, const Product& product) {
+        size_t start = buffer.size();
+        buffer.resize(start + 8);
+        buffer.push_back(uint8_t(op));
+        putRaw(int32_t(product.getId()));
+        if (op != LogOp::Remove) {
+            putRaw(product.getPrice());
+            putRaw(int32_t(product.getQuantity()));
+            putRaw(product.getMargin());
+        }
+        if (op == LogOp::Add || op == LogOp::Update) {
+            putString(product.getName());
+            putString(product.getCategory());
+        }
+        uint32_t length = uint32_t(buffer.size() - start - 8);
+        uint32_t crc = crc32(buffer.data() + start + 8, length);
+        memcpy(buffer.data() + start, &length, 4);
+        memcpy(buffer.data() + start + 4, &crc, 4);
+        if (++buffered >= options.groupCommit) return commit();
+        return true;
+    }
+
+    template <typename T>
+    static bool getRaw(const uint8_t*& p, const uint8_t* end, T& value) {
+        if (size_t(end - p) < sizeof(T)) return false;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    static bool getString(const uint8_t*& p, const uint8_t* end, string_view& value) {
+        uint32_t length;
+        if (!getRaw(p, end, length) || size_t(end - p) < length) return false;
+        value = string_view(reinterpret_cast<const char*>(p), length);
+        p += length;
+        return true;
+    }
+
+    static bool decode(const uint8_t* p, const uint8_t* end, LogRecord& record) {
+        uint8_t op;
+        int32_t id;
+        if (!getRaw(p, end, op) || !getRaw(p, end, id)) return false;
+        record.op = LogOp(op);
+        if (record.op == LogOp::Remove) {
+            record.product = Product(id, "", "", 0, 0, 0);
+            return p == end;
+        }
+        if (record.op != LogOp::Add && record.op != LogOp::Update && record.op != LogOp::Values) return false;
+        double price, margin;
+        int32_t quantity;
+        string_view name, category;
+        if (!getRaw(p, end, price) || !getRaw(p, end, quantity) || !getRaw(p, end, margin)) return false;
+        if (record.op != LogOp::Values && (!getString(p, end, name) || !getString(p, end, category))) return false;
+        record.product = Product(id, name, category, price, quantity, margin);
+        return p == end;
+    }
+
+public:
+    WriteAheadLog() {}
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    ~WriteAheadLog() { close(); }
+
+    bool open(const string& path, const LogOptions& options) {
+        close();
+        this->options = options;
+        if (this->options.groupCommit == 0) this->options.groupCommit = 1;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        fileBytes = fstat(fd, &st) == 0 ? size_t(st.st_size) : 0;
+        lastSync = chrono::steady_clock::now();
+        return true;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+    // Bytes in the file plus bytes still waiting for the next group commit.
+    size_t size() const { return fileBytes + buffer.size(); }
+
+    bool logAdd(const Product& product) { return append(LogOp::Add, product); }
+    bool logUpdate(const Product& product) { return append(LogOp::Update, product); }
+    // Price, quantity and margin only, for changes that leave the strings be.
+    bool logValues(const Product& product) { return append(LogOp::Values, product); }
+    bool logRemove(int id) { return append(LogOp::Remove, Product(id, "", "", 0, 0, 0)); }
+
+    // Writes out everything buffered, then fsyncs if the batching policy
+    // says it is time. Returns false on I/O errors, keeping only the bytes
+    // that did not reach the file, so a retry carries on where the write
+    // stopped instead of repeating a prefix.
+    bool commit() {
+        if (fd < 0) return false;
+        const uint8_t* p = buffer.data();
+        size_t left = buffer.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                size_t written = buffer.size() - left;
+                buffer.erase(buffer.begin(), buffer.begin() + ptrdiff_t(written));
+                fileBytes += written;
+                return false;
+            }
+            p += n;
+            left -= size_t(n);
+        }
+        fileBytes += buffer.size();
+        bool wrote = !buffer.empty();
+        buffer.clear();
+        buffered = 0;
+        if (!wrote) return true;
+
+        commitsSinceSync++;
+        auto now = chrono::steady_clock::now();
+        bool byCount = options.syncEveryCommits > 0 && commitsSinceSync >= options.syncEveryCommits;
+        bool byTime = options.syncIntervalMs > 0
+            && chrono::duration_cast<chrono::milliseconds>(now - lastSync).count() >= options.syncIntervalMs;
+        if (byCount || byTime) return sync();
+        return true;
+    }
+
+    bool sync() {
+        if (fd < 0) return false;
+        commitsSinceSync = 0;
+        lastSync = chrono::steady_clock::now();
+        return fdatasync(fd) == 0;
+    }
+
+    bool needsCompaction() const {
+        return options.compactBytes > 0 && size() >= options.compactBytes;
+    }
+
+    // Empties the log once its contents are safely in a snapshot.
+    bool truncate() {
+        if (fd < 0) return false;
+        buffer.clear();
+        buffered = 0;
+        if (ftruncate(fd, 0) != 0) return false;
+        fileBytes = 0;
+        return sync();
+    }
+
+    void close() {
+        if (fd < 0) return;
+        commit();
+        sync();
+        ::close(fd);
+        fd = -1;
+    }
+
+    // Calls apply for every intact record in path, in order. Replay stops at
+    // the first torn or corrupt record (a crash mid-write) and the file is
+    // cut back to the last good record so new appends follow valid data.
+    // Returns the number of records applied, or -1 if the file can't be read.
+    template <typename Apply>
+    static long long replay(const string& path, Apply apply) {
+        MappedFile file;
+        if (!file.open(path, true)) return errno == ENOENT ? 0 : -1;
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(file.data());
+        const uint8_t* end = begin + file.size();
+        const uint8_t* p = begin;
+        long long applied = 0;
+        LogRecord record;
+        while (size_t(end - p) >= 8) {
+            uint32_t length, crc;
+            memcpy(&length, p, 4);
+            memcpy(&crc, p + 4, 4);
+            if (size_t(end - p - 8) < length) break;
+            const uint8_t* payload = p + 8;
+            if (crc32(payload, length) != crc || !decode(payload, payload + length, record)) break;
+            apply(record);
+            applied++;
+            p = payload + length;
+        }
+        if (p != end) {
+            size_t good = size_t(p - begin);
+            file.close();
+            if (::truncate(path.c_str(), off_t(good)) != 0) return -1;
+        }
+        return applied;
+    }
+};
+
+#endif